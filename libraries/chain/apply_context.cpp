@@ -97,11 +97,7 @@ apply_context::has_authorized(const domain_name& domain, const domain_key& key)
 
 uint64_t
 apply_context::next_global_sequence() {
-    const auto& p = control.get_dynamic_global_properties();
-    db.modify(p, [&](auto& dgp) {
-        ++dgp.global_action_sequence;
-    });
-    return p.global_action_sequence;
+    return trx_context.next_global_sequence();
 }
 
 }}  // namespace jmzk::chain
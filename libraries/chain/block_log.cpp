@@ -4,8 +4,14 @@
  */
 #include <jmzk/chain/block_log.hpp>
 #include <jmzk/chain/exceptions.hpp>
+#include <atomic>
+#include <deque>
 #include <fstream>
+#include <memory>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <fc/io/raw.hpp>
+#include <jmzk/utilities/spinlock.hpp>
 
 #define LOG_READ  (std::ios::in | std::ios::binary)
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
@@ -24,6 +30,38 @@ const uint32_t block_log::min_supported_version = 1;
 const uint32_t block_log::max_supported_version = 2;
 
 namespace detail {
+
+namespace bip = boost::interprocess;
+
+/**
+ * Read-only mapping of one file. It's reserved larger than the file so that
+ * appended content can be read without remapping each time.
+ */
+struct file_map {
+public:
+    file_map(const fc::path& path, uint64_t capacity)
+        : file(path.generic_string().c_str(), bip::read_only)
+        , region(file, bip::read_only, 0, capacity) {}
+
+public:
+    const char* data() const { return (const char*)region.get_address(); }
+    uint64_t capacity() const { return region.get_size(); }
+
+public:
+    bip::file_mapping  file;
+    bip::mapped_region region;
+};
+
+/**
+ * Blocks appended but not flushed yet, they're invisible in mapped files
+ */
+struct unflushed_block {
+    uint32_t         num;
+    uint64_t         pos;
+    uint64_t         end;  // position of next block
+    signed_block_ptr block;
+};
+
 class block_log_impl {
 public:
     signed_block_ptr head;
@@ -37,6 +75,24 @@ public:
     bool             genesis_written_to_block_log = false;
     uint32_t         version                      = 0;
     uint32_t         first_block_num              = 0;
+    uint32_t         flush_interval               = 1;
+
+    // ends of files written by streams, so sizes are known without checking files
+    uint64_t         block_end                    = 0;
+    uint64_t         index_end                    = 0;
+
+    // states below are shared with readers on other threads
+    std::atomic<uint32_t>        head_num   = {0};
+    std::atomic<uint64_t>        block_size = {0};  // flushed size of block file
+    std::atomic<uint64_t>        index_size = {0};  // flushed size of index file
+
+    // loaded and stored atomically, readers hold the map they loaded so it's released after they're done,
+    // even if files are remapped or closed in the meantime
+    std::shared_ptr<const file_map> block_map;
+    std::shared_ptr<const file_map> index_map;
+
+    std::deque<unflushed_block> unflushed;
+    utilities::spinlock         unflushed_lock;
 
     inline void
     check_open_files() {
@@ -45,6 +101,8 @@ public:
         }
     }
     void reopen();
+    void commit();
+    void remap(std::shared_ptr<const file_map>& map, const fc::path& path, uint64_t size);
 
     void
     close() {
@@ -55,9 +113,19 @@ public:
             index_stream.close();
         }
         open_files = false;
+
+        std::atomic_store(&block_map, std::shared_ptr<const file_map>());
+        std::atomic_store(&index_map, std::shared_ptr<const file_map>());
+        block_size = 0;
+        index_size = 0;
+        block_end  = 0;
+        index_end  = 0;
+        unflushed.clear();
     }
-};
 
+    std::pair<signed_block_ptr, uint64_t> read_mapped_block(uint64_t pos, uint64_t size) const;
+    uint64_t read_mapped_pos(uint64_t offset) const;
+};
 
 void
 block_log_impl::reopen() {
@@ -74,12 +142,69 @@ block_log_impl::reopen() {
     index_stream.open(index_file.generic_string().c_str(), LOG_RW);
 
     open_files = true;
+    block_end  = fc::file_size(block_file);
+    index_end  = fc::file_size(index_file);
+    commit();
+}
+
+void
+block_log_impl::remap(std::shared_ptr<const file_map>& map, const fc::path& path, uint64_t size) {
+    const uint64_t kMinMapSize = 64 * 1024 * 1024;
+
+    auto m = std::atomic_load_explicit(&map, std::memory_order_relaxed);
+    if(size == 0 || (m != nullptr && m->capacity() >= size)) {
+        return;
+    }
+    std::atomic_store_explicit(&map, std::shared_ptr<const file_map>(std::make_shared<file_map>(path, std::max(size * 2, kMinMapSize))),
+        std::memory_order_release);
+}
+
+// makes flushed content visible to readers, should be called after streams are flushed
+void
+block_log_impl::commit() {
+    auto bsize = block_end;
+    auto isize = index_end;
+
+    // maps are updated before sizes, readers which see the new size will see the new map as well
+    remap(block_map, block_file, bsize);
+    remap(index_map, index_file, isize);
+
+    auto lock = utilities::spinlock_guard(unflushed_lock);
+    block_size.store(bsize, std::memory_order_release);
+    index_size.store(isize, std::memory_order_release);
+    unflushed.clear();
+}
+
+std::pair<signed_block_ptr, uint64_t>
+block_log_impl::read_mapped_block(uint64_t pos, uint64_t size) const {
+    auto map = std::atomic_load_explicit(&block_map, std::memory_order_acquire);
+    jmzk_ASSERT(map != nullptr && size <= map->capacity(), block_log_exception, "Block log is closed or reset while reading");
+
+    auto ds = fc::datastream<const char*>(map->data() + pos, size - pos);
+
+    std::pair<signed_block_ptr, uint64_t> result;
+    result.first = std::make_shared<signed_block>();
+    fc::raw::unpack(ds, *result.first);
+    result.second = pos + ds.tellp() + sizeof(uint64_t);
+    return result;
+}
+
+uint64_t
+block_log_impl::read_mapped_pos(uint64_t offset) const {
+    auto map = std::atomic_load_explicit(&index_map, std::memory_order_acquire);
+    jmzk_ASSERT(map != nullptr && offset + sizeof(uint64_t) <= map->capacity(), block_log_exception, "Block log is closed or reset while reading");
+
+    uint64_t pos;
+    memcpy(&pos, map->data() + offset, sizeof(pos));
+    return pos;
 }
 
 }  // namespace detail
 
-block_log::block_log(const fc::path& data_dir)
+block_log::block_log(const fc::path& data_dir, uint32_t flush_interval)
     : my(new detail::block_log_impl()) {
+    jmzk_ASSERT(flush_interval > 0, block_log_exception, "Flush interval of block log should be greater than 0");
+    my->flush_interval = flush_interval;
     my->block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
     my->index_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
     open(data_dir);
@@ -157,6 +282,7 @@ block_log::open(const fc::path& data_dir) {
         else {
             my->head_id = {};
         }
+        my->head_num = my->head ? my->head->block_num() : 0;
 
         if(index_size) {
             ilog("Index is nonempty");
@@ -211,7 +337,19 @@ block_log::append(const signed_block_ptr& b) {
         my->head    = b;
         my->head_id = b->id();
 
-        flush();
+        my->block_end = pos + data.size() + sizeof(pos);
+        my->index_end = sizeof(uint64_t) * (b->block_num() - my->first_block_num + 1);
+
+        {
+            auto lock = utilities::spinlock_guard(my->unflushed_lock);
+            my->unflushed.emplace_back(detail::unflushed_block{b->block_num(), pos, pos + data.size() + sizeof(pos), b});
+        }
+        my->head_num.store(b->block_num(), std::memory_order_release);
+
+        // group commit: flush once every `flush_interval` blocks
+        if(my->unflushed.size() >= my->flush_interval) {
+            flush();
+        }
 
         return pos;
     }
@@ -222,6 +360,9 @@ void
 block_log::flush() {
     my->block_stream.flush();
     my->index_stream.flush();
+    if(my->open_files) {
+        my->commit();
+    }
 }
 
 void
@@ -233,6 +374,7 @@ block_log::reset(const genesis_state& gs, const signed_block_ptr& first_block, u
 
     my->reopen();
 
+    my->head_num        = 0;
     auto data           = fc::raw::pack(gs);
     my->version         = 0;  // version of 0 is invalid; it indicates that the genesis was not properly written to the block log
     my->first_block_num = first_block_num;
@@ -245,6 +387,7 @@ block_log::reset(const genesis_state& gs, const signed_block_ptr& first_block, u
     // append a totem to indicate the division between blocks and header
     auto totem = npos;
     my->block_stream.write((char*)&totem, sizeof(totem));
+    my->block_end = my->block_stream.tellp();
 
     if(first_block) {
         append(first_block);
@@ -262,14 +405,25 @@ block_log::reset(const genesis_state& gs, const signed_block_ptr& first_block, u
 
 std::pair<signed_block_ptr, uint64_t>
 block_log::read_block(uint64_t pos) const {
-    my->check_open_files();
+    auto size = my->block_size.load(std::memory_order_acquire);
+    if(pos < size) {
+        return my->read_mapped_block(pos, size);
+    }
 
-    my->block_stream.seekg(pos);
-    std::pair<signed_block_ptr, uint64_t> result;
-    result.first = std::make_shared<signed_block>();
-    fc::raw::unpack(my->block_stream, *result.first);
-    result.second = uint64_t(my->block_stream.tellg()) + 8;
-    return result;
+    {
+        auto lock = utilities::spinlock_guard(my->unflushed_lock);
+        size = my->block_size.load(std::memory_order_relaxed);
+        if(pos >= size) {
+            for(auto& b : my->unflushed) {
+                if(b.pos == pos) {
+                    return std::make_pair(b.block, b.end);
+                }
+            }
+            jmzk_THROW(block_log_exception, "Cannot find block at position: ${pos} in block log", ("pos", pos));
+        }
+    }
+    // flushed in the meantime
+    return my->read_mapped_block(pos, size);
 }
 
 signed_block_ptr
@@ -289,13 +443,28 @@ block_log::read_block_by_num(uint32_t block_num) const {
 
 uint64_t
 block_log::get_block_pos(uint32_t block_num) const {
-    my->check_open_files();
-    if(!(my->head && block_num <= block_header::num_from_id(my->head_id) && block_num >= my->first_block_num))
+    if(!(block_num <= my->head_num.load(std::memory_order_acquire) && block_num >= my->first_block_num)) {
         return npos;
-    my->index_stream.seekg(sizeof(uint64_t) * (block_num - my->first_block_num));
-    uint64_t pos;
-    my->index_stream.read((char*)&pos, sizeof(pos));
-    return pos;
+    }
+
+    auto offset = sizeof(uint64_t) * (block_num - my->first_block_num);
+    if(offset + sizeof(uint64_t) <= my->index_size.load(std::memory_order_acquire)) {
+        return my->read_mapped_pos(offset);
+    }
+
+    {
+        auto lock = utilities::spinlock_guard(my->unflushed_lock);
+        if(offset + sizeof(uint64_t) > my->index_size.load(std::memory_order_relaxed)) {
+            for(auto& b : my->unflushed) {
+                if(b.num == block_num) {
+                    return b.pos;
+                }
+            }
+            return npos;
+        }
+    }
+    // flushed in the meantime
+    return my->read_mapped_pos(offset);
 }
 
 signed_block_ptr
@@ -377,6 +546,8 @@ block_log::construct_index() {
         }
         my->index_stream.write((char*)&pos, sizeof(pos));
     }
+    my->index_end = my->index_stream.tellp();
+    flush();
 }  // construct_index
 
 fc::path
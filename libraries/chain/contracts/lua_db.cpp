@@ -1,9 +1,10 @@
 #include <jmzk/chain/contracts/lua_db.hpp>
 
-#include <fc/io/json.hpp>
+#include <fc/reflect/variant.hpp>
 #include <jmzk/chain/exceptions.hpp>
 #include <jmzk/chain/token_database_cache.hpp>
 #include <jmzk/chain/contracts/lua_engine.hpp>
+#include <jmzk/chain/contracts/lua_variant.hpp>
 #include <jmzk/chain/contracts/types.hpp>
 
 using namespace jmzk::chain;
@@ -40,17 +41,8 @@ readtoken(lua_State* L) {
     auto token =  make_empty_cache_ptr<token_def>();
     READ_DB_TOKEN(token_type::token, domain, name, token, unknown_token_exception,"Cannot find token '{}' in '{}'", name, domain);
 
-    auto json = fc::json::to_string(fc::variant(*token));
-    lua_getglobal(L, "json");
-    lua_getfield(L, -1, "deserialize");
-    lua_pushstring(L, json.c_str());
-    
-    auto r = lua_pcall(L, 1, 1, 0);
-    if(r == LUA_OK) {
-        return 1;
-    }
-
-    return lua_error(L);
+    lua_pushvariant(L, fc::variant(*token));
+    return 1;
 }
 
 static int
@@ -72,17 +64,8 @@ readdomain(lua_State* L) {
     auto domain =  make_empty_cache_ptr<domain_def>();
     READ_DB_TOKEN(token_type::domain, std::nullopt, dname, domain, unknown_domain_exception,"Cannot find domain '{}'", dname);
 
-    auto json = fc::json::to_string(fc::variant(*domain));
-    lua_getglobal(L, "json");
-    lua_getfield(L, -1, "deserialize");
-    lua_pushstring(L, json.c_str());
-    
-    auto r = lua_pcall(L, 1, 1, 0);
-    if(r == LUA_OK) {
-        return 1;
-    }
-
-    return lua_error(L);
+    lua_pushvariant(L, fc::variant(*domain));
+    return 1;
 }
 
 static int
@@ -4,6 +4,11 @@
  */
 #include <jmzk/chain/contracts/lua_engine.hpp>
 
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
 #include <lua.hpp>
 
 #include <fc/time.hpp>
@@ -17,6 +22,7 @@
 #include <jmzk/chain/token_database_cache.hpp>
 #include <jmzk/chain/contracts/lua_db.hpp>
 #include <jmzk/chain/contracts/lua_json.hpp>
+#include <jmzk/chain/contracts/lua_variant.hpp>
 #include <jmzk/chain/contracts/types.hpp>
 #include <jmzk/chain/contracts/abi_serializer.hpp>
 
@@ -61,6 +67,104 @@ traceback(lua_State* L) {
     return 1;
 }
 
+/**
+ *  Compiled bytecode of scripts in LRU order, keyed by script name.
+ *  Each entry keeps the source it was compiled from and is dropped once the content
+ *  of script differs, so updated or rolled back scripts are always recompiled.
+ */
+class script_cache : boost::noncopyable {
+private:
+    struct entry {
+        std::string content;
+        std::string bytecode;
+    };
+    using lru_list = std::list<std::pair<script_name, entry>>;
+
+public:
+    explicit script_cache(size_t capacity) : capacity_(capacity) {}
+
+public:
+    const std::string*
+    lookup(const script_name& name, const std::string& content) {
+        auto it = map_.find(name);
+        if(it == map_.end()) {
+            return nullptr;
+        }
+
+        auto& e = it->second->second;
+        if(e.content != content) {
+            lru_.erase(it->second);
+            map_.erase(it);
+            return nullptr;
+        }
+
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return &e.bytecode;
+    }
+
+    void
+    insert(const script_name& name, const std::string& content, std::string&& bytecode) {
+        auto it = map_.find(name);
+        if(it != map_.end()) {
+            lru_.erase(it->second);
+            map_.erase(it);
+        }
+
+        lru_.emplace_front(name, entry { content, std::move(bytecode) });
+        map_.emplace(name, lru_.begin());
+
+        if(lru_.size() > capacity_) {
+            map_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+    }
+
+private:
+    size_t                                              capacity_;
+    lru_list                                            lru_;
+    std::unordered_map<script_name, lru_list::iterator> map_;
+};
+
+static script_cache&
+get_script_cache() {
+    static thread_local script_cache cache(config::default_lua_script_cache_size);
+    return cache;
+}
+
+static int
+dump_writer(lua_State* L, const void* p, size_t sz, void* ud) {
+    ((std::string*)ud)->append((const char*)p, sz);
+    return 0;
+}
+
+// load script as function onto the top of stack, use cached bytecode if script is not changed
+static int
+load_script(lua_State* L, const script_name& name, const std::string& content) {
+    auto& cache = get_script_cache();
+    if(auto bc = cache.lookup(name, content); bc != nullptr) {
+        return luaL_loadbuffer(L, bc->data(), bc->size(), content.c_str());
+    }
+
+    auto r = luaL_loadstring(L, content.c_str());
+    if(r != LUA_OK) {
+        return r;
+    }
+
+    auto bytecode = std::string();
+    lua_dump(L, dump_writer, &bytecode);
+    cache.insert(name, content, std::move(bytecode));
+
+    return LUA_OK;
+}
+
+// set the environment of current invocation to the function on the top of stack
+static void
+set_script_env(lua_State* L) {
+    lua_getfield(L, LUA_REGISTRYINDEX, config::lua_script_env_key);
+    FC_ASSERT(lua_istable(L, -1));
+    lua_setfenv(L, -2);
+}
+
 static int
 requirex(lua_State* L) {
     if(lua_gettop(L) > 1) {
@@ -79,8 +183,9 @@ requirex(lua_State* L) {
     auto script = make_empty_cache_ptr<script_def>();
     READ_DB_TOKEN(token_type::script, std::nullopt, module, script, unknown_script_exception, "Cannot find module script: {}", module);
 
-    auto r = luaL_loadstring(L, script->content.c_str());
+    auto r = load_script(L, module, script->content);
     jmzk_ASSERT2(r == LUA_OK, script_load_exceptoin, "Load module '{}' script failed: {}", module, lua_tostring(L, -1));
+    set_script_env(L);
 
     auto r2 = lua_pcall(L, 0, 1, 0);
     if(lua_type(L, -1) != LUA_TTABLE) {
@@ -90,8 +195,69 @@ requirex(lua_State* L) {
     return 1;
 }
 
+/**
+ *  Builds the function which restores shared state of lua state to the one just after it's created.
+ *  Scripts only write globals into their own environment, but they can still change the shared ones through it,
+ *  like the fields of library tables, `_G`, `package.loaded`, the metatable of strings or the seed of `math.random`.
+ *  Tables reachable from `_G` within two levels are recorded with their fields and metatables,
+ *  the seed is reset to 0, which is the same as the one of new state.
+ */
+static const char* reset_state_script = R"===(
+    local G = _G
+    local pairs, type, rawset = pairs, type, rawset
+    local getmetatable, setmetatable = debug.getmetatable, debug.setmetatable
+    local randomseed, setfenv = math.randomseed, setfenv
+
+    local snapshots = {}
+    local function snap(t)
+        if snapshots[t] then
+            return false
+        end
+        local fields = {}
+        for k, v in pairs(t) do
+            fields[k] = v
+        end
+        snapshots[t] = { fields = fields, mt = getmetatable(t) }
+        return true
+    end
+
+    snap(G)
+    for _, v in pairs(G) do
+        if type(v) == "table" and snap(v) then
+            for _, v2 in pairs(v) do
+                if type(v2) == "table" then
+                    snap(v2)
+                end
+            end
+        end
+    end
+
+    local strmt = getmetatable("")
+    snap(strmt)
+
+    return function()
+        for t, s in pairs(snapshots) do
+            local fields = s.fields
+            for k in pairs(t) do
+                if fields[k] == nil then
+                    rawset(t, k, nil)
+                end
+            end
+            for k, v in pairs(fields) do
+                rawset(t, k, v)
+            end
+            setmetatable(t, s.mt)
+        end
+        setmetatable("", strmt)
+        setfenv(0, G)
+        randomseed(0)
+    end
+)===";
+
+// create one new lua state with libraries opened, it doesn't bind to any database
+// so can be reused by later invocations
 static lua_State*
-setup_luastate(token_database_cache& tokendb_cache, int checks) {
+new_luastate() {
     auto L = luaL_newstate();
     FC_ASSERT(L != nullptr);
 
@@ -107,6 +273,105 @@ setup_luastate(token_database_cache& tokendb_cache, int checks) {
     lua_pushboolean(L, 1);
     lua_setfield(L, LUA_REGISTRYINDEX, "LUA_NOENV");
 
+    // open libs and set jit off and add hook function
+    luaL_openlibs(L);
+    luaJIT_setmode(L, 0, LUAJIT_MODE_ENGINE | LUAJIT_MODE_OFF);
+    lua_sethook(L, lua_hook, LUA_MASKCALL | LUA_MASKCOUNT, config::default_lua_checkcount);
+
+    // open db and json libraries
+    luaopen_db(L);
+    lua_setglobal(L, "db");
+
+    luaopen_json(L);
+    lua_setglobal(L, "json");
+
+    // add requirex function
+    lua_pushcfunction(L, requirex);
+    lua_setglobal(L, "requirex");
+
+    // record pristine state, it's restored before the state is reused
+    auto r = luaL_loadstring(L, reset_state_script);
+    FC_ASSERT(r == LUA_OK, "Load reset script failed: ${e}", ("e", lua_tostring(L, -1)));
+    auto r2 = lua_pcall(L, 0, 1, 0);
+    FC_ASSERT(r2 == LUA_OK, "Run reset script failed: ${e}", ("e", lua_tostring(L, -1)));
+    lua_setfield(L, LUA_REGISTRYINDEX, config::lua_reset_state_key);
+
+    rev.cancel();
+    return L;
+}
+
+/**
+ *  Per-thread pool of initialized lua states.
+ *  Only states of successful invocations are returned back to the pool,
+ *  failed ones are closed since they may be left in any state.
+ *  Shared state changed by scripts is restored before a state goes back to the pool,
+ *  so results of scripts never depend on the invocations made before on the same thread.
+ */
+class luastate_pool : boost::noncopyable {
+public:
+    ~luastate_pool() {
+        for(auto L : states_) {
+            lua_close(L);
+        }
+    }
+
+public:
+    lua_State*
+    acquire() {
+        if(states_.empty()) {
+            return new_luastate();
+        }
+
+        auto L = states_.back();
+        states_.pop_back();
+        return L;
+    }
+
+    void
+    release(lua_State* L) {
+        lua_settop(L, 0);
+        if(states_.size() >= config::default_lua_state_pool_size || !reset(L)) {
+            lua_close(L);
+            return;
+        }
+
+        // gc is stopped when scripts are running, collect garbage between invocations once it grows
+        if(lua_gc(L, LUA_GCCOUNT, 0) > config::default_lua_gc_threshold_kb) {
+            lua_gc(L, LUA_GCCOLLECT, 0);
+            lua_gc(L, LUA_GCSTOP, 0);
+        }
+        states_.push_back(L);
+    }
+
+private:
+    static bool
+    reset(lua_State* L) {
+        // no time limit for restoring, it's not a part of the script
+        lua_pushinteger(L, 0);
+        lua_setfield(L, LUA_REGISTRYINDEX, config::lua_start_timestamp_key);
+
+        lua_getfield(L, LUA_REGISTRYINDEX, config::lua_reset_state_key);
+        if(!lua_isfunction(L, -1) || lua_pcall(L, 0, 0, 0) != LUA_OK) {
+            lua_settop(L, 0);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::vector<lua_State*> states_;
+};
+
+static luastate_pool&
+get_luastate_pool() {
+    static thread_local luastate_pool pool;
+    return pool;
+}
+
+static void
+setup_luastate(lua_State* L, token_database_cache& tokendb_cache, int checks) {
+    assert(lua_gettop(L) == 0);
+
     // set tokendb_cache as register value
     lua_pushlightuserdata(L, (void*)&tokendb_cache);
     lua_setfield(L, LUA_REGISTRYINDEX, config::lua_token_database_key);
@@ -123,21 +388,14 @@ setup_luastate(token_database_cache& tokendb_cache, int checks) {
 
     lua_setfield(L, LUA_REGISTRYINDEX, config::lua_start_timestamp_key);
 
-    // open libs and set jit off and add hook function
-    luaL_openlibs(L);
-    luaJIT_setmode(L, 0, LUAJIT_MODE_ENGINE | LUAJIT_MODE_OFF);
-    lua_sethook(L, lua_hook, LUA_MASKCALL | LUA_MASKCOUNT, config::default_lua_checkcount);
-
-    // open db and json libraries
-    luaopen_db(L);
-    lua_setglobal(L, "db");
-
-    luaopen_json(L);
-    lua_setglobal(L, "json");
-
-    // add requirex function
-    lua_pushcfunction(L, requirex);
-    lua_setglobal(L, "requirex");
+    // create fresh environment for this invocation which falls back to the globals,
+    // so globals written by scripts are not leaked into later invocations of this state
+    lua_newtable(L);
+    lua_newtable(L);
+    lua_pushvalue(L, LUA_GLOBALSINDEX);
+    lua_setfield(L, -2, "__index");
+    lua_setmetatable(L, -2);
+    lua_setfield(L, LUA_REGISTRYINDEX, config::lua_script_env_key);
 
     // push traceback function to provide custom error message
     lua_pushcfunction(L, traceback);
@@ -147,11 +405,9 @@ setup_luastate(token_database_cache& tokendb_cache, int checks) {
     auto script = make_empty_cache_ptr<script_def>();
     READ_DB_TOKEN(token_type::script, std::nullopt, N128(.loader), script, unknown_script_exception, "Cannot find loader script");
 
-    auto r = luaL_loadstring(L, script->content.c_str());
+    auto r = load_script(L, N128(.loader), script->content);
     jmzk_ASSERT2(r == LUA_OK, script_load_exceptoin, "Load loader script failed: {}", lua_tostring(L, -1));
-
-    rev.cancel();
-    return L;
+    set_script_env(L);
 }
 
 }  // namespace internal
@@ -167,17 +423,21 @@ lua_engine::invoke_filter(const controller& control, const action& act, const sc
     auto ss = make_empty_cache_ptr<script_def>();
     READ_DB_TOKEN(token_type::script, std::nullopt, script, ss, unknown_script_exception,"Cannot find script: {}", script);
 
-    auto L = internal::setup_luastate(tokendb_cache, !control.skip_trx_checks());
-    assert(lua_gettop(L) == 2); // traceback, loader
+    auto& pool = get_luastate_pool();
+    auto  L    = pool.acquire();
 
     auto rev = fc::make_scoped_exit([L]() mutable {
         lua_close(L);
         L = nullptr;
     });
 
+    setup_luastate(L, tokendb_cache, !control.skip_trx_checks());
+    assert(lua_gettop(L) == 2); // traceback, loader
+
     // load filter script
-    auto r = luaL_loadstring(L, ss->content.c_str());
+    auto r = load_script(L, script, ss->content);
     jmzk_ASSERT2(r == LUA_OK, script_load_exceptoin, "Load '{}' script failed: {}", script, lua_tostring(L, -1));
+    set_script_env(L);
     assert(lua_gettop(L) == 3); // traceback, loader, filter
 
     // push action
@@ -185,17 +445,7 @@ lua_engine::invoke_filter(const controller& control, const action& act, const sc
     auto  var = fc::variant();
     abi.to_variant(act, var, control.get_execution_context());
 
-    auto json = fc::json::to_string(var);
-    lua_getglobal(L, "json");
-    lua_getfield(L, -1, "deserialize");
-    lua_pushstring(L, json.c_str());
-    
-    auto r2 = lua_pcall(L, 1, 1, 1);
-    jmzk_ASSERT2(r2 == LUA_OK, script_execution_exceptoin, "Convert action to json failed: {}", lua_tostring(L, -1));
-    
-    // remove json object from stack
-    lua_copy(L, -1, -2);
-    lua_pop(L, 1);
+    lua_pushvariant(L, var);
     assert(lua_gettop(L) == 4); // traceback, loader, filter, act
 
     // call filter
@@ -205,7 +455,13 @@ lua_engine::invoke_filter(const controller& control, const action& act, const sc
     jmzk_ASSERT2(lua_gettop(L) >= 2, script_invalid_result_exceptoin, "No result is returned from script, should at least be one");
     jmzk_ASSERT2(lua_isboolean(L, -1), script_invalid_result_exceptoin, "Result returned from lua filter should be boolean value");      
 
-    return lua_toboolean(L, -1);
+    auto result = lua_toboolean(L, -1);
+
+    // put state back to pool for later invocations
+    rev.cancel();
+    pool.release(L);
+
+    return result;
 }
 
 }}}  // namespac jmzk::chain::contracts
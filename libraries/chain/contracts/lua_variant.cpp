@@ -0,0 +1,96 @@
+/**
+ *  @file
+ *  @copyright defined in jmzk/LICENSE.txt
+ */
+#include <jmzk/chain/contracts/lua_variant.hpp>
+
+#include <fc/variant_object.hpp>
+
+namespace jmzk { namespace chain { namespace contracts {
+
+namespace internal {
+
+static void
+push_object(lua_State* L, const fc::variant_object& obj) {
+    lua_createtable(L, 0, obj.size());
+    for(auto& kv : obj) {
+        if(kv.value().is_null()) {
+            // setting nil value to table is the same as not set
+            continue;
+        }
+        lua_pushlstring(L, kv.key().data(), kv.key().size());
+        lua_pushvariant(L, kv.value());
+        lua_rawset(L, -3);
+    }
+}
+
+static void
+push_array(lua_State* L, const fc::variants& arr) {
+    lua_createtable(L, arr.size(), 0);
+
+    auto n = 0;
+    for(auto& v : arr) {
+        if(v.is_null()) {
+            // json parser appends values by the length of array, nil is skipped there
+            continue;
+        }
+        lua_pushvariant(L, v);
+        lua_rawseti(L, -2, ++n);
+    }
+}
+
+}  // namespace internal
+
+void
+lua_pushvariant(lua_State* L, const fc::variant& v) {
+    using namespace internal;
+
+    luaL_checkstack(L, 3, "variant is too deep");
+
+    switch(v.get_type()) {
+    case fc::variant::null_type: {
+        lua_pushnil(L);
+        break;
+    }
+    case fc::variant::int64_type: {
+        lua_pushinteger(L, (lua_Integer)v.as_int64());
+        break;
+    }
+    case fc::variant::uint64_type: {
+        lua_pushinteger(L, (lua_Integer)v.as_uint64());
+        break;
+    }
+    case fc::variant::double_type: {
+        lua_pushnumber(L, v.as_double());
+        break;
+    }
+    case fc::variant::bool_type: {
+        lua_pushboolean(L, v.as_bool());
+        break;
+    }
+    case fc::variant::string_type: {
+        auto& str = v.get_string();
+        lua_pushlstring(L, str.data(), str.size());
+        break;
+    }
+    case fc::variant::blob_type: {
+        // json writer puts raw bytes of blob into string
+        auto& blob = v.get_blob();
+        lua_pushlstring(L, blob.data.data(), blob.data.size());
+        break;
+    }
+    case fc::variant::array_type: {
+        push_array(L, v.get_array());
+        break;
+    }
+    case fc::variant::object_type: {
+        push_object(L, v.get_object());
+        break;
+    }
+    default: {
+        FC_THROW_EXCEPTION(fc::invalid_arg_exception, "Unsupported variant type: ${t}", ("t", (int)v.get_type()));
+    }
+    }  // switch
+}
+
+}}}  // namespace jmzk::chain::contracts
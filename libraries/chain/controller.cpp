@@ -18,10 +18,12 @@
 #include <jmzk/chain/execution_context_impl.hpp>
 #include <jmzk/chain/fork_database.hpp>
 #include <jmzk/chain/snapshot.hpp>
+#include <jmzk/chain/thread_utils.hpp>
 #include <jmzk/chain/token_database.hpp>
 #include <jmzk/chain/token_database_cache.hpp>
 #include <jmzk/chain/token_database_snapshot.hpp>
 #include <jmzk/chain/transaction_context.hpp>
+#include <jmzk/chain/transaction_metadata_cache.hpp>
 #include <jmzk/chain/contracts/abi_serializer.hpp>
 #include <jmzk/chain/contracts/jmzk_contract_abi.hpp>
 #include <jmzk/chain/contracts/jmzk_org.hpp>
@@ -154,6 +156,9 @@ struct controller_impl {
     uint32_t                 snapshot_head_block = 0;
     abi_serializer           system_api;
 
+    optional<boost::asio::thread_pool> thread_pool;  ///< used to prepare transactions of incoming blocks in parallel
+    transaction_metadata_cache         trx_metas_cache;  ///< pushed transactions with recovered keys, reused by incoming blocks
+
     /**
      *  Transactions that were undone by pop_block or abort_block, transactions
      *  are removed from this list if they are re-applied in other blocks. Producers
@@ -189,7 +194,7 @@ struct controller_impl {
         , reversible_blocks(cfg.blocks_dir / config::reversible_blocks_dir_name,
              cfg.read_only ? database::read_only : database::read_write,
              cfg.reversible_cache_size)
-        , blog(cfg.blocks_dir)
+        , blog(cfg.blocks_dir, cfg.blocks_flush_interval)
         , fork_db(cfg.state_dir)
         , token_db(cfg.db_config)
         , token_db_cache(token_db, cfg.db_config.object_cache_size)
@@ -197,14 +202,23 @@ struct controller_impl {
         , chain_id(cfg.genesis.compute_chain_id())
         , exec_ctx(s)
         , read_mode(cfg.read_mode)
-        , system_api(contracts::jmzk_contract_abi(), cfg.max_serialization_time) {
+        , system_api(contracts::jmzk_contract_abi(), cfg.max_serialization_time)
+        , trx_metas_cache(cfg.trx_metas_cache_size) {
 
         fork_db.irreversible.connect([&](auto b) {
             on_irreversible(b);
         });
+
+        if(cfg.thread_pool_size > 0) {
+            thread_pool.emplace(cfg.thread_pool_size);
+        }
     }
 
     ~controller_impl() {
+        if(thread_pool.has_value()) {
+            thread_pool->join();
+            thread_pool->stop();
+        }
         pending.reset();
     }
 
@@ -781,6 +795,9 @@ struct controller_impl {
 
                 if(!trx->implicit) {
                     unapplied_transactions.erase(trx->signed_id);
+                    if(pending->_block_status == controller::block_status::incomplete) {
+                        trx_metas_cache.add(trx);
+                    }
                 }
                 return trace;
             }
@@ -867,6 +884,57 @@ struct controller_impl {
         static_cast<signed_block_header&>(*p->block) = p->header;
     }  /// sign_block
 
+    /**
+     *  Unpacks the input transactions of one block and recovers their signing keys on the thread pool.
+     *  Only the context-free part is done here, transactions are still applied serially in receipt order
+     *  because every transaction pays its charge into the same fee pool and would conflict anyway.
+     *  Returns empty result when the thread pool is disabled.
+     */
+    std::vector<std::future<transaction_metadata_ptr>>
+    prepare_block_transactions(const signed_block_ptr& b) {
+        auto trx_metas = std::vector<std::future<transaction_metadata_ptr>>();
+        if(!thread_pool.has_value()) {
+            return trx_metas;
+        }
+
+        trx_metas.reserve(b->transactions.size());
+        for(auto i = 0u; i < b->transactions.size(); i++) {
+            if(b->transactions[i].type != transaction_receipt::input) {
+                continue;
+            }
+            trx_metas.emplace_back(async_thread_pool(*thread_pool, [this, b, i]() {
+                return make_block_transaction(b->transactions[i].trx, true);
+            }));
+        }
+        return trx_metas;
+    }
+
+    /**
+     *  Makes metadata for one input transaction of incoming block, the unpacked transaction and recovered keys
+     *  are picked up from the metadata cache if the same transaction has been pushed before.
+     *  A fresh metadata object is always returned so accepted signal is emitted for it as usual.
+     */
+    transaction_metadata_ptr
+    make_block_transaction(const packed_transaction& ptrx, bool recover) const {
+        if(auto cached = trx_metas_cache.find(digest_type::hash(ptrx)); cached) {
+            if(cached->signing_keys.has_value() && cached->signing_keys->first == chain_id) {
+                auto mtrx = std::make_shared<transaction_metadata>(cached->packed_trx);
+                mtrx->signing_keys = cached->signing_keys;
+                return mtrx;
+            }
+        }
+
+        auto mtrx = std::make_shared<transaction_metadata>(std::make_shared<packed_transaction>(ptrx));
+        if(recover) {
+            try {
+                // invalid signatures are reported when the transaction is applied
+                mtrx->recover_keys(chain_id);
+            }
+            catch(...) {}
+        }
+        return mtrx;
+    }
+
     void
     apply_block(const signed_block_ptr& b, controller::block_status s) {
         try {
@@ -875,12 +943,20 @@ struct controller_impl {
                 auto producer_block_id = b->id();
                 start_block(b->timestamp, b->confirmed, s, producer_block_id);
 
+                auto trx_metas = prepare_block_transactions(b);
+                auto trx_index = 0u;
+
                 auto num_pending_receipts = pending->_pending_block_state->block->transactions.size();
                 for(const auto& receipt : b->transactions) {
                     auto trace = transaction_trace_ptr();
                     if(receipt.type == transaction_receipt::input) {
-                        auto& pt    = receipt.trx;
-                        auto  mtrx  = std::make_shared<transaction_metadata>(std::make_shared<packed_transaction>(pt));
+                        auto mtrx = transaction_metadata_ptr();
+                        if(!trx_metas.empty()) {
+                            mtrx = trx_metas[trx_index++].get();
+                        }
+                        else {
+                            mtrx = make_block_transaction(receipt.trx, false);
+                        }
                         
                         trace = push_transaction(mtrx, fc::time_point::maximum());
                     }
@@ -1240,6 +1316,16 @@ controller::get_execution_context() const {
     return my->exec_ctx;
 }
 
+boost::asio::thread_pool*
+controller::get_thread_pool() const {
+    return my->thread_pool.has_value() ? &(*my->thread_pool) : nullptr;
+}
+
+transaction_metadata_cache&
+controller::get_trx_metas_cache() const {
+    return my->trx_metas_cache;
+}
+
 void
 controller::start_block(block_timestamp_type when, uint16_t confirm_block_count) {
     validate_db_available_size();
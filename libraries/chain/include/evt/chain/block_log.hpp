@@ -36,11 +36,15 @@ class block_log_impl;
     *
     * The main file is the only file that needs to persist. The index file can be reconstructed during a
     * linear scan of the main file.
+    *
+    * Both files are memory-mapped for reading, so blocks can be read from any thread without locking
+    * while the log is being appended. Appends are flushed once every `flush_interval` blocks, blocks
+    * not flushed yet are kept in memory and still readable.
     */
 
 class block_log {
 public:
-    block_log(const fc::path& data_dir);
+    block_log(const fc::path& data_dir, uint32_t flush_interval = 1);
     block_log(block_log&& other);
     ~block_log();
 
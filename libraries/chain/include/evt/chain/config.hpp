@@ -54,6 +54,11 @@ const static uint32_t default_global_charge_factor       = 10;
 
 const static uint32_t default_abi_serializer_max_time_ms = 50; ///< default deadline for abi serialization methods
 
+const static uint16_t default_producer_threads = 2;  ///< default size of producer thread pool
+const static uint16_t default_controller_thread_pool_size = 2;  ///< default size of controller thread pool
+const static uint32_t default_block_log_flush_interval    = 1;  ///< flush block log once every N blocks appended
+const static uint32_t default_trx_metadata_cache_size     = 10 * 1024;  ///< max number of pushed transactions kept for reusing in blocks
+
 /**
  *  The number of sequential blocks produced by a single producer
  */
@@ -84,6 +89,12 @@ const static int  default_lua_checkcount  = 200;
 const static int  default_lua_max_time_ms = 10;  // ms
 const static auto lua_token_database_key  = "TOKENDB";
 const static auto lua_start_timestamp_key = "STARTTS";
+const static auto lua_script_env_key      = "SCRIPTENV";
+const static auto lua_reset_state_key     = "RESETSTATE";
+
+const static size_t default_lua_state_pool_size   = 4;    // states per thread
+const static size_t default_lua_script_cache_size = 128;  // compiled scripts per thread
+const static int    default_lua_gc_threshold_kb   = 4 * 1024;
 
 }}}  // namespace jmzk::chain::config
 
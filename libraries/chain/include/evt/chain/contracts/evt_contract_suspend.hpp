@@ -143,6 +143,9 @@ jmzk_ACTION_IMPL_BEGIN(execsuspend) {
 
         auto mtrx = std::make_shared<transaction_metadata>(strx);
 
+        // suspend transaction reserves its own global sequences after the ones of this transaction
+        context.trx_context.commit_global_sequence();
+
         auto trace = context.control.push_suspend_transaction(mtrx, fc::time_point::maximum());
         bool transaction_failed = trace && trace->except;
         if(transaction_failed) {
@@ -0,0 +1,19 @@
+/**
+ *  @file
+ *  @copyright defined in jmzk/LICENSE.txt
+ */
+#pragma once
+
+#include <lua.hpp>
+#include <fc/variant.hpp>
+
+namespace jmzk { namespace chain { namespace contracts {
+
+/**
+ *  Pushes variant onto the stack of lua as native values without going through json.
+ *  Produced values are the same as `json.deserialize(fc::json::to_string(v))`:
+ *  objects and arrays become tables, null is dropped and large integers are kept as numbers.
+ */
+void lua_pushvariant(lua_State* L, const fc::variant& v);
+
+}}}  // namespace jmzk::chain::contracts
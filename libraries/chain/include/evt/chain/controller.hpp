@@ -16,6 +16,10 @@ namespace chainbase {
 class database;
 }
 
+namespace boost { namespace asio {
+class thread_pool;
+}}  // namespace boost::asio
+
 namespace jmzk { namespace chain {
 
 using unapplied_transactions_type = map<transaction_id_type, transaction_metadata_ptr>;
@@ -26,6 +30,7 @@ class charge_manager;
 class execution_context;
 class staking_context;
 class token_database_cache;
+class transaction_metadata_cache;
 
 struct controller_impl;
 using boost::signals2::signal;
@@ -72,6 +77,9 @@ public:
         bool     loadtest_mode          = false;
         bool     charge_free_mode       = false;
         bool     contracts_console      = false;
+        uint16_t thread_pool_size       = chain::config::default_controller_thread_pool_size;
+        uint32_t blocks_flush_interval  = chain::config::default_block_log_flush_interval;
+        uint32_t trx_metas_cache_size   = chain::config::default_trx_metadata_cache_size;
 
         std::chrono::microseconds max_serialization_time = std::chrono::milliseconds(chain::config::default_abi_serializer_max_time_ms);
 
@@ -139,6 +147,12 @@ public:
 
     execution_context& get_execution_context() const;
 
+    // thread pool for context-free work, returns nullptr when `thread_pool_size` is zero
+    boost::asio::thread_pool* get_thread_pool() const;
+
+    // metadata of pushed transactions, reused when the same transactions are applied in blocks
+    transaction_metadata_cache& get_trx_metas_cache() const;
+
     const global_property_object&         get_global_properties() const;
     const dynamic_global_property_object& get_dynamic_global_properties() const;
 
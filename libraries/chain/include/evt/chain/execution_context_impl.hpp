@@ -9,6 +9,7 @@
 #include <functional>
 #include <string>
 #include <type_traits>
+#include <utility>
 
 #include <boost/hana.hpp>
 
@@ -148,47 +149,18 @@ public:
     template <template<uint64_t> typename Invoker, typename RType, typename ... Args>
     RType
     invoke(int actindex, Args&&... args) const {
-        using opt_type = std::conditional_t<std::is_void<RType>::value, int, RType>;
-
-        auto fn = [&](auto i) -> std::optional<opt_type> {
-            auto name  = act_names_[i];
-            auto vers  = hana::filter(act_types_,
-                [&](auto& t) { return hana::equal(name, hana::ulong_c<decltype(+t)::type::get_action_name().value>); });
-            auto cver = get_curr_ver(i);
-
-            static_assert(hana::length(vers)() > hana::size_c<0>(), "empty version actions!");
-
-            auto result = std::optional<opt_type>();
-            hana::for_each(vers, [&, cver](auto v) {
-                using ty = typename decltype(+v)::type;
-
-                constexpr auto n = ty::get_action_name().value;
-                if(ty::get_version() == cver) {
-                    if constexpr (std::is_void<RType>::value) {
-                        Invoker<n>::template invoke<ty>(std::forward<Args>(args)...);
-                        result = 1;
-                    }
-                    else {
-                        result = Invoker<n>::template invoke<ty>(std::forward<Args>(args)...);
-                    }
-                }
-            });
+        using table_type = dispatch_table<Invoker, RType, Args...>;
 
-            return result;
-        };
+        // generated at compile time, one slot for each (action index, version)
+        static constexpr auto table = table_type::make(std::make_index_sequence<act_num_ * max_version_>());
 
-        auto range  = hana::make_range(hana::int_c<0>, hana::length(act_names_));
-        auto result = std::optional<opt_type>();
-        hana::for_each(range, [&](auto i) {
-            if(static_cast<int>(i()) == actindex) {
-                result = fn(i);
-            }
-        });
+        jmzk_ASSERT(actindex >= 0 && actindex < (int)act_num_, action_index_exception, "Invalid action index: ${act}", ("act", actindex));
 
-        jmzk_ASSERT(result.has_value(), action_index_exception, "Invalid action index: ${act}", ("act", actindex));
-        if constexpr (!std::is_void<RType>::value) {
-            return *result;
-        }
+        auto cver = get_curr_ver(actindex);
+        auto fn   = (cver >= 1 && cver <= max_version_) ? table[actindex * max_version_ + (cver - 1)] : nullptr;
+        jmzk_ASSERT2(fn != nullptr, action_version_exception, "Invalid version: {} of action index: {}", cver, actindex);
+
+        return fn(std::forward<Args>(args)...);
     }
 
     template <typename T, typename Func>
@@ -238,6 +210,47 @@ private:
 private:
     static constexpr auto act_types_ = hana::make_tuple(hana::type_c<ACTTYPE>...);
     static constexpr auto act_names_ = hana::sort(hana::unique(hana::transform(act_types_, [](auto& a) { return hana::ulong_c<decltype(+a)::type::get_action_name().value>; })));
+    static constexpr auto act_vers_  = hana::transform(act_types_, [](auto& a) { return hana::int_c<decltype(+a)::type::get_version()>; });
+
+    static constexpr size_t act_num_     = hana::length(act_names_);
+    static constexpr int    max_version_ = decltype(hana::maximum(act_vers_))::value;
+
+    template <template<uint64_t> typename Invoker, typename RType, typename ... Args>
+    struct dispatch_table {
+    public:
+        using func_type = RType(*)(Args&&...);
+
+        template<typename T>
+        static RType
+        invoke_one(Args&&... args) {
+            return Invoker<T::get_action_name().value>::template invoke<T>(std::forward<Args>(args)...);
+        }
+
+        // entry for the I-th slot, null when the action doesn't have that version
+        template<size_t I>
+        static constexpr func_type
+        entry() {
+            constexpr auto n = std::decay_t<decltype(hana::at_c<I / max_version_>(act_names_))>::value;
+            constexpr auto v = (int)(I % max_version_) + 1;
+
+            auto t = hana::find_if(act_types_, [](auto& a) {
+                using ty = typename decltype(+a)::type;
+                return hana::bool_c<ty::get_action_name().value == n && ty::get_version() == v>;
+            });
+            if constexpr(decltype(t == hana::nothing)::value) {
+                return nullptr;
+            }
+            else {
+                return &invoke_one<typename decltype(+t.value())::type>;
+            }
+        }
+
+        template<size_t ... I>
+        static constexpr std::array<func_type, sizeof...(I)>
+        make(std::index_sequence<I...>) {
+            return {{ entry<I>()... }};
+        }
+    };
 
 private:
     controller&                                                        chain_;
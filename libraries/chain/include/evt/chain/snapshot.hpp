@@ -6,6 +6,8 @@
 
 #include <ostream>
 #include <optional>
+#include <string>
+#include <vector>
 #include <jmzk/chain/database_utils.hpp>
 #include <jmzk/chain/exceptions.hpp>
 #include <fc/variant_object.hpp>
@@ -173,6 +175,42 @@ struct snapshot_row_raw_writer : abstract_snapshot_row_writer {
 
 }  // namespace detail
 
+/**
+ * Rows of one section packed in memory apart from any writer, so that independent sections
+ * can be built and prepared on other threads, and written in order by `write_section_data`.
+ */
+struct snapshot_section_data {
+public:
+    template <typename T>
+    void
+    add_row(const T& row) {
+        auto& v  = detail::snapshot_row_traits<T>::to_snapshot_row(row);
+        auto  sz = fc::raw::pack_size(v);
+        auto  ps = rows.size();
+
+        rows.resize(ps + sz);
+        auto ds = fc::datastream<char*>(rows.data() + ps, sz);
+        fc::raw::pack(ds, v);
+
+        row_sizes.emplace_back(sz);
+        row_count++;
+    }
+
+    void
+    add_row(const char* data, size_t sz) {
+        rows.append(data, sz);
+        row_sizes.emplace_back(sz);
+        row_count++;
+    }
+
+public:
+    std::string           name;
+    uint64_t              row_count = 0;
+    std::string           rows;        // packed rows, one by one
+    std::vector<uint32_t> row_sizes;
+    std::string           compressed;  // filled by writers which store compressed sections
+};
+
 class snapshot_writer {
 public:
     class section_writer {
@@ -217,6 +255,10 @@ public:
         write_section(detail::snapshot_section_traits<T>::section_name(), f);
     }
 
+    // called on worker threads before `write_section_data`, must not touch the state of writer
+    virtual void prepare_section_data(snapshot_section_data& data) const {}
+    virtual void write_section_data(const snapshot_section_data& data);
+
     virtual ~snapshot_writer(){};
 
 protected:
@@ -472,6 +514,9 @@ public:
     void write_end_section() override;
     void finalize();
 
+    void prepare_section_data(snapshot_section_data& data) const override;
+    void write_section_data(const snapshot_section_data& data) override;
+
     static const uint32_t magic_number = 0x30510550;
 
 private:
@@ -0,0 +1,24 @@
+/**
+ *  @file
+ *  @copyright defined in jmzk/LICENSE.txt
+ */
+#pragma once
+#include <future>
+#include <memory>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+namespace jmzk { namespace chain {
+
+// async on thread_pool and return future
+template<typename F>
+auto
+async_thread_pool(boost::asio::thread_pool& thread_pool, F&& f) {
+    auto task = std::make_shared<std::packaged_task<decltype(f())()>>(std::forward<F>(f));
+    boost::asio::post(thread_pool, [task]() {
+        (*task)();
+    });
+    return task->get_future();
+}
+
+}}  // namespace jmzk::chain
@@ -30,6 +30,14 @@ enum class storage_profile {
     memory = 1
 };
 
+// how irreversible writes are made durable, crash consistency of savepoints is kept by
+// the dirty flag of persisted savepoints log in all the modes
+enum class durability_mode {
+    sync_every_write = 0,  // fsync every write batch
+    group_commit,          // fsync on a background thread every `group_commit_ms`, syncs of batches are coalesced
+    wal_only               // only write into WAL, leave syncing to OS
+};
+
 enum class token_type {
     asset = 0,
     domain,
@@ -126,6 +134,11 @@ extract_db_value(const std::string& str, T& v) {
 
 using token_keys_t = small_vector<name128, 4>;
 
+class token_database_view;
+using token_database_view_ptr = std::shared_ptr<const token_database_view>;
+
+class token_database_bulk_loader;
+
 class token_database : boost::noncopyable {
 public:
     struct config {
@@ -134,6 +147,8 @@ public:
         uint32_t        object_cache_size = 256 * 1024 * 1024; // 256M
         fc::path        db_path           = ::jmzk::chain::config::default_token_database_dir_name;
         bool            enable_stats      = true;
+        durability_mode durability        = durability_mode::sync_every_write;
+        uint32_t        group_commit_ms   = 100;
     };
 
     class session {
@@ -217,6 +232,12 @@ public:
 
     size_t savepoints_size() const;
 
+public:
+    token_database_view_ptr new_view() const;
+    // savepoints newer than `seq` are invisible to the view
+    token_database_view_ptr new_view(int64_t seq) const;
+    std::unique_ptr<token_database_bulk_loader> new_bulk_loader();
+
 public:
     std::string stats() const;
 
@@ -226,9 +247,10 @@ private:
     void load_savepoints(std::istream&);
 
 private:  // for cache usage
-    std::string get_db_key(token_type type, const std::optional<name128>& domain, const name128& key);
+    const name128& get_db_prefix(token_type type, const std::optional<name128>& domain) const;
     boost::signals2::signal<void(const rocksdb::Slice&)> rollback_token_value;
     boost::signals2::signal<void(const rocksdb::Slice&)> remove_token_value;
+    boost::signals2::signal<void(std::string&)>          collect_stats;
 
 private:
     std::unique_ptr<class token_database_impl> my_;
@@ -236,6 +258,56 @@ private:
     friend class token_database_impl;
 };
 
+/**
+ * Read-only view of token database pinned at the state when it's created.
+ * Writes made after that are invisible to it, so it can be read from other threads
+ * while the database keeps changing. Views should be released before database is closed.
+ */
+class token_database_view : boost::noncopyable {
+public:
+    ~token_database_view();
+
+public:
+    int exists_token(token_type type, const std::optional<name128>& domain, const name128& key) const;
+
+    int read_token(token_type type, const std::optional<name128>& domain, const name128& key, std::string& out, bool no_throw = false) const;
+    int read_asset(const address& addr, const symbol_id_type sym_id, std::string& out, bool no_throw = false) const;
+
+    int read_tokens_range(token_type type, const std::optional<name128>& domain, int skip, const read_value_func& func) const;
+    int read_assets_range(const symbol_id_type sym_id, int skip, const read_value_func& func) const;
+
+private:
+    token_database_view(std::unique_ptr<class token_database_view_impl>&& my);
+
+private:
+    std::unique_ptr<class token_database_view_impl> my_;
+    friend class token_database_impl;
+};
+
+/**
+ * Loads large amount of rows into token database by building sorted SST files and ingesting them directly,
+ * which skips the memtable, WAL and most of the compactions. Rows are collected into chunks and each chunk is
+ * sorted and written on worker threads. Only used to fill database without savepoints, like loading a snapshot.
+ * Nothing is visible until `finish` is called.
+ */
+class token_database_bulk_loader : boost::noncopyable {
+public:
+    ~token_database_bulk_loader();
+
+public:
+    void put_token(token_type type, const std::optional<name128>& domain, const name128& key, std::string&& data);
+    void put_asset(const address& addr, const symbol_id_type sym_id, std::string&& data);
+
+    void finish();
+
+private:
+    token_database_bulk_loader(std::unique_ptr<class token_database_bulk_loader_impl>&& my);
+
+private:
+    std::unique_ptr<class token_database_bulk_loader_impl> my_;
+    friend class token_database_impl;
+};
+
 }}  // namespace jmzk::chain
 
-FC_REFLECT(jmzk::chain::token_database::config, (profile)(block_cache_size)(object_cache_size)(db_path));
+FC_REFLECT(jmzk::chain::token_database::config, (profile)(block_cache_size)(object_cache_size)(db_path)(durability)(group_commit_ms));
@@ -3,12 +3,20 @@
  *  @copyright defined in jmzk/LICENSE.txt
 */
 #pragma once
+#include <array>
+#include <atomic>
 #include <memory>
+#include <unordered_map>
+#include <vector>
+#include <boost/signals2/connection.hpp>
 #include <boost/type_index.hpp>
+#include <fmt/format.h>
 #include <fc/io/datastream.hpp>
 #include <fc/io/raw.hpp>
-#include <rocksdb/cache.h>
+#include <fc/scoped_exit.hpp>
+#include <rocksdb/slice.h>
 #include <jmzk/chain/token_database.hpp>
+#include <jmzk/utilities/spinlock.hpp>
 
 namespace jmzk { namespace chain {
 
@@ -16,22 +24,78 @@ class token_database_cache {
 public:
     token_database_cache(token_database& db, size_t cache_size)
         : db_(db)
-        , cache_(rocksdb::NewLRUCache(cache_size)) {
+        , capacity_(cache_size) {
         watch_db();
     }
 
+    ~token_database_cache() {
+        for(auto& c : conns_) {
+            c.disconnect();
+        }
+        for(auto& s : shards_) {
+            for(auto e : s.ring) {
+                release(e);
+            }
+        }
+    }
+
 private:
-    template<typename T>
-    struct cache_entry {
+    static constexpr int kShardBits = 4;
+    static constexpr int kShards    = 1 << kShardBits;
+
+    // same layout as the key in token database: prefix + key
+    struct cache_key {
+        name128 prefix;
+        name128 key;
+
+        bool
+        operator==(const cache_key& rhs) const {
+            return prefix == rhs.prefix && key == rhs.key;
+        }
+    };
+    static_assert(sizeof(cache_key) == sizeof(name128) * 2);
+
+    struct cache_key_hash {
+        size_t
+        operator()(const cache_key& k) const noexcept {
+            auto h = std::hash<name128>()(k.prefix);
+            return h ^ (std::hash<name128>()(k.key) + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2));
+        }
+    };
+
+    struct entry_base {
     public:
-        cache_entry() : ti(boost::typeindex::type_id<T>()) {}
+        entry_base(const cache_key& key, int tid, const std::type_info& ti, size_t charge)
+            : key(key), tid(tid), ti(ti), charge(charge), refs(1), index(0), visited(false) {}
+        virtual ~entry_base() = default;
 
-        template<typename U>
-        cache_entry(U&& d) : ti(boost::typeindex::type_id<T>()), data(std::forward<U>(d)) {}
+    public:
+        cache_key             key;
+        int                   tid;
+        const std::type_info& ti;
+        size_t                charge;
+        std::atomic_int       refs;     // one for cache itself and one for each returned pointer
+        size_t                index;    // position in the clock ring of shard
+        bool                  visited;  // clock reference bit
+    };
 
+    template<typename T>
+    struct cache_entry : public entry_base {
     public:
-        boost::typeindex::type_index ti;
-        T                            data;
+        template<typename... Args>
+        cache_entry(const cache_key& key, size_t charge, Args&&... args)
+            : entry_base(key, type_id<T>(), typeid(T), charge), data(std::forward<Args>(args)...) {}
+
+    public:
+        T data;
+    };
+
+    struct shard {
+        mutable utilities::spinlock                                 lock;
+        std::unordered_map<cache_key, entry_base*, cache_key_hash> map;
+        std::vector<entry_base*>                                    ring;
+        size_t                                                      hand  = 0;
+        size_t                                                      usage = 0;
     };
 
 public:
@@ -39,19 +103,18 @@ public:
     struct cache_deleter {
     public:
         cache_deleter()
-            : self_(nullptr), handle_(nullptr) {}
-        cache_deleter(token_database_cache* self, rocksdb::Cache::Handle* handle)
-            : self_(self), handle_(handle) {}
+            : entry_(nullptr) {}
+        cache_deleter(entry_base* entry)
+            : entry_(entry) {}
 
     void
     operator()(T* ptr) {
-        assert(handle_);
-        self_->cache_->Release(handle_);
+        assert(entry_);
+        token_database_cache::release(entry_);
     }
 
     private:
-        token_database_cache*   self_;
-        rocksdb::Cache::Handle* handle_;
+        entry_base* entry_;
     };
 
 public:
@@ -60,13 +123,9 @@ public:
     read_token(token_type type, const std::optional<name128>& domain, const name128& key, bool no_throw = false) {
         static_assert(std::is_class_v<T>, "T should be a class type");
 
-        auto k = db_.get_db_key(type, domain, key);
-        auto h = cache_->Lookup(k);
-        if(h != nullptr) {
-            auto entry = (cache_entry<T>*)cache_->Value(h);
-            jmzk_ASSERT2(entry->ti == boost::typeindex::type_id<T>(), token_database_cache_exception,
-                "Types are not matched between cache({}) and query({})", entry->ti.pretty_name(), boost::typeindex::type_id<T>().pretty_name());
-            return std::unique_ptr<T, cache_deleter<T>>(&entry->data, cache_deleter<T>(this, h));
+        auto k = make_key(type, domain, key);
+        if(auto e = lookup_entry(k); e != nullptr) {
+            return make_cache_ptr<T>(e);
         }
 
         auto str = std::string();
@@ -75,14 +134,13 @@ public:
             return nullptr;
         }
 
-        auto entry = new cache_entry<T>();
+        auto entry = new cache_entry<T>(k, str.size());
         extract_db_value(str, entry->data);
 
-        auto s = cache_->Insert(k, (void*)entry, str.size(),
-            [](auto& ck, auto cv) { delete (cache_entry<T>*)cv; }, &h);
-        FC_ASSERT(s == rocksdb::Status::OK());
+        entry->refs++;  // pinned by returned pointer
+        insert_entry(entry);
 
-        return std::unique_ptr<T, cache_deleter<T>>(&entry->data, cache_deleter<T>(this, h));
+        return std::unique_ptr<T, cache_deleter<T>>(&entry->data, cache_deleter<T>(entry));
     }
 
     template<typename T>
@@ -90,13 +148,9 @@ public:
     lookup_token(token_type type, const std::optional<name128>& domain, const name128& key, bool no_throw = false) {
         static_assert(std::is_class_v<T>, "T should be a class type");
 
-        auto k = db_.get_db_key(type, domain, key);
-        auto h = cache_->Lookup(k);
-        if(h != nullptr) {
-            auto entry = (cache_entry<T>*)cache_->Value(h);
-            jmzk_ASSERT2(entry->ti == boost::typeindex::type_id<T>(), token_database_cache_exception,
-                "Types are not matched between cache({}) and query({})", entry->ti.pretty_name(), boost::typeindex::type_id<T>().pretty_name());
-            return std::unique_ptr<T, cache_deleter<T>>(&entry->data, cache_deleter<T>(this, h));
+        auto k = make_key(type, domain, key);
+        if(auto e = lookup_entry(k); e != nullptr) {
+            return make_cache_ptr<T>(e);
         }
         return nullptr;
     }
@@ -107,20 +161,18 @@ public:
         static_assert(std::is_class_v<U>, "Underlying of T should be a class type");
         using entry_t = cache_entry<U>;
 
-        auto k = db_.get_db_key(type, domain, key);
-        auto h = cache_->Lookup(k);
-        if(h != nullptr) {
-            auto entry = (entry_t*)cache_->Value(h);
-            jmzk_ASSERT2(entry->ti == boost::typeindex::type_id<T>(), token_database_cache_exception,
-                "Types are not matched between cache({}) and query({})", entry->ti.pretty_name(), boost::typeindex::type_id<T>().pretty_name());
-            jmzk_ASSERT2(&entry->data == &data, token_database_cache_exception,
+        auto k = make_key(type, domain, key);
+        if(auto e = lookup_entry(k); e != nullptr) {
+            auto rel = fc::make_scoped_exit([e] { release(e); });
+
+            jmzk_ASSERT2(e->tid == type_id<U>(), token_database_cache_exception,
+                "Types are not matched between cache({}) and query({})", type_name(e->ti), type_name(typeid(U)));
+            jmzk_ASSERT2(&static_cast<entry_t*>(e)->data == &data, token_database_cache_exception,
                 "Provided updated data object should be the same as original one in cache");
-        }
 
-        auto v = make_db_value(data);
-        db_.put_token(type, op, domain, key, v.as_string_view());
-        
-        if(h != nullptr) {
+            auto v = make_db_value(data);
+            db_.put_token(type, op, domain, key, v.as_string_view());
+
             // if there's already cache item, no need to insert new one
             if constexpr(!RtnPTR) {
                 return;
@@ -130,34 +182,211 @@ public:
             }
         }
 
-        auto entry = new entry_t(std::forward<T>(data));
+        auto v = make_db_value(data);
+        db_.put_token(type, op, domain, key, v.as_string_view());
+
+        auto entry = new entry_t(k, v.size(), std::forward<T>(data));
         if constexpr(!RtnPTR) {
-            auto s = cache_->Insert(k, (void*)entry, v.size(),
-                [](auto& ck, auto cv) { delete (cache_entry<U>*)cv; }, nullptr /* handle */);
-            FC_ASSERT(s == rocksdb::Status::OK());
+            insert_entry(entry);
         }
         else {
-            auto s = cache_->Insert(k, (void*)entry, v.size(),
-                [](auto& ck, auto cv) { delete (cache_entry<U>*)cv; }, &h);
-            FC_ASSERT(s == rocksdb::Status::OK());
-            return std::unique_ptr<U, cache_deleter<U>>(&entry->data, cache_deleter<U>(this, h));
+            entry->refs++;  // pinned by returned pointer
+            insert_entry(entry);
+            return std::unique_ptr<U, cache_deleter<U>>(&entry->data, cache_deleter<U>(entry));
         }
     }
 
+    std::string
+    stats() const {
+        auto usage   = size_t(0);
+        auto entries = size_t(0);
+        for(auto& s : shards_) {
+            auto g = utilities::spinlock_guard(s.lock);
+            usage   += s.usage;
+            entries += s.ring.size();
+        }
+        return fmt::format("\n** Object Cache **\ncapacity: {}, usage: {}, entries: {}\nhits: {}, misses: {}, inserts: {}, evictions: {}\n",
+            capacity_, usage, entries, hits_.load(), misses_.load(), inserts_.load(), evictions_.load());
+    }
+
 private:
+    static int
+    next_type_id() {
+        static std::atomic_int id(0);
+        return id++;
+    }
+
+    template<typename T>
+    static int
+    type_id() {
+        static const int id = next_type_id();
+        return id;
+    }
+
+    static std::string
+    type_name(const std::type_info& ti) {
+        return boost::typeindex::type_index(ti).pretty_name();
+    }
+
+    static void
+    release(entry_base* e) {
+        if(e->refs.fetch_sub(1) == 1) {
+            delete e;
+        }
+    }
+
+    cache_key
+    make_key(token_type type, const std::optional<name128>& domain, const name128& key) const {
+        return cache_key { db_.get_db_prefix(type, domain), key };
+    }
+
+    static cache_key
+    make_key(const rocksdb::Slice& key) {
+        assert(key.size() == sizeof(cache_key));
+
+        auto k = cache_key();
+        memcpy(&k, key.data(), sizeof(cache_key));
+        return k;
+    }
+
+    static shard&
+    get_shard(std::array<shard, kShards>& shards, const cache_key& key) {
+        return shards[cache_key_hash()(key) & (kShards - 1)];
+    }
+
+    template<typename T>
+    std::unique_ptr<T, cache_deleter<T>>
+    make_cache_ptr(entry_base* e) {
+        if(e->tid != type_id<T>()) {
+            auto name = type_name(e->ti);
+            release(e);
+            jmzk_THROW2(token_database_cache_exception,
+                "Types are not matched between cache({}) and query({})", name, type_name(typeid(T)));
+        }
+        return std::unique_ptr<T, cache_deleter<T>>(&static_cast<cache_entry<T>*>(e)->data, cache_deleter<T>(e));
+    }
+
+    // returned entry is pinned and should be released by caller
+    entry_base*
+    lookup_entry(const cache_key& key) {
+        auto& s = get_shard(shards_, key);
+        auto  g = utilities::spinlock_guard(s.lock);
+
+        auto it = s.map.find(key);
+        if(it == s.map.end()) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        auto e = it->second;
+        e->refs++;
+        e->visited = true;
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return e;
+    }
+
+    void
+    insert_entry(entry_base* e) {
+        auto& s = get_shard(shards_, e->key);
+        auto  g = utilities::spinlock_guard(s.lock);
+
+        auto it = s.map.find(e->key);
+        if(it != s.map.end()) {
+            auto old = it->second;
+            remove_from_ring(s, old);
+            s.map.erase(it);
+            release(old);
+        }
+
+        e->index = s.ring.size();
+        s.ring.emplace_back(e);
+        s.map.emplace(e->key, e);
+        s.usage += e->charge;
+        inserts_.fetch_add(1, std::memory_order_relaxed);
+
+        evict(s);
+    }
+
+    void
+    erase_entry(const cache_key& key) {
+        auto& s = get_shard(shards_, key);
+        auto  g = utilities::spinlock_guard(s.lock);
+
+        auto it = s.map.find(key);
+        if(it == s.map.end()) {
+            return;
+        }
+
+        auto e = it->second;
+        remove_from_ring(s, e);
+        s.map.erase(it);
+        release(e);
+    }
+
+    static void
+    remove_from_ring(shard& s, entry_base* e) {
+        auto last = s.ring.back();
+        s.ring[e->index] = last;
+        last->index      = e->index;
+        s.ring.pop_back();
+        s.usage -= e->charge;
+    }
+
+    // CLOCK eviction: entries referenced since last sweep get a second chance,
+    // entries still held by returned pointers are skipped
+    void
+    evict(shard& s) {
+        auto cap   = capacity_ / kShards;
+        auto steps = s.ring.size() * 2;
+
+        while(s.usage > cap && steps-- > 0 && !s.ring.empty()) {
+            if(s.hand >= s.ring.size()) {
+                s.hand = 0;
+            }
+
+            auto e = s.ring[s.hand];
+            if(e->visited) {
+                e->visited = false;
+                s.hand++;
+                continue;
+            }
+            if(e->refs.load() > 1) {
+                s.hand++;
+                continue;
+            }
+
+            // the last entry in ring is swapped into current position
+            remove_from_ring(s, e);
+            s.map.erase(e->key);
+            release(e);
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
     void
     watch_db() {
-        db_.rollback_token_value.connect([this](auto& key) {
-            cache_->Erase(key);
+        conns_[0] = db_.rollback_token_value.connect([this](auto& key) {
+            erase_entry(make_key(key));
+        });
+        conns_[1] = db_.remove_token_value.connect([this](auto& key) {
+            erase_entry(make_key(key));
         });
-        db_.remove_token_value.connect([this](auto& key) {
-            cache_->Erase(key);
+        conns_[2] = db_.collect_stats.connect([this](auto& str) {
+            str.append(stats());
         });
     }
 
 private:
-    token_database&                 db_;
-    std::shared_ptr<rocksdb::Cache> cache_;
+    token_database&             db_;
+    size_t                      capacity_;
+    std::array<shard, kShards>  shards_;
+
+    std::atomic<uint64_t>       hits_      {0};
+    std::atomic<uint64_t>       misses_    {0};
+    std::atomic<uint64_t>       inserts_   {0};
+    std::atomic<uint64_t>       evictions_ {0};
+
+    std::array<boost::signals2::scoped_connection, 3> conns_;
 };
 
 template<typename T>
@@ -34,6 +34,9 @@ public:
 
     inline void add_net_usage( uint64_t u ) { net_usage += u; check_net_usage(); }
 
+    uint64_t next_global_sequence();
+    void     commit_global_sequence();
+
 private:
     friend struct controller_impl;
     friend class apply_context;
@@ -73,6 +76,10 @@ public:
 
 private:
     bool is_initialized = false;
+
+    // global action sequences are reserved here and written into dynamic global properties at once
+    bool     has_global_sequence = false;
+    uint64_t global_sequence     = 0;  // last reserved one
 };
 
 }}  // namespace jmzk::chain
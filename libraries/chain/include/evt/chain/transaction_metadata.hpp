@@ -35,6 +35,8 @@ public:
     }
 
 public:
+    // not thread-safe, producer_plugin recovers keys on its thread pool before
+    // handing the transaction over to main thread
     const public_keys_set&
     recover_keys(const chain_id_type& chain_id) {
         if(!signing_keys.has_value() || signing_keys->first != chain_id) {  // Unlikely for more than one chain_id to be used in one nodeos instance
@@ -0,0 +1,83 @@
+/**
+ *  @file
+ *  @copyright defined in jmzk/LICENSE.txt
+ */
+#pragma once
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <jmzk/chain/transaction_metadata.hpp>
+#include <jmzk/utilities/spinlock.hpp>
+
+namespace jmzk { namespace chain {
+
+/**
+ *  Bounded cache of transaction metadata keyed by signed id. Transactions pushed into pending block
+ *  leave their unpacked transaction and recovered keys here, so when the same transaction arrives
+ *  later in a block it doesn't need to be unpacked and recovered again. Oldest entries are evicted first.
+ *  Thread-safe, lookups are done on controller thread pool.
+ */
+class transaction_metadata_cache {
+public:
+    explicit transaction_metadata_cache(size_t capacity)
+        : capacity_(capacity) {}
+
+public:
+    void
+    add(const transaction_metadata_ptr& trx) {
+        if(capacity_ == 0 || !trx->signing_keys.has_value()) {
+            return;
+        }
+
+        auto g = utilities::spinlock_guard(lock_);
+
+        auto r = metas_.push_back(trx);
+        if(!r.second) {
+            // move it to the newest
+            metas_.relocate(metas_.end(), r.first);
+            return;
+        }
+        while(metas_.size() > capacity_) {
+            metas_.pop_front();
+        }
+    }
+
+    transaction_metadata_ptr
+    find(const transaction_id_type& signed_id) const {
+        auto g = utilities::spinlock_guard(lock_);
+
+        auto& idx = metas_.get<by_signed_id>();
+        if(auto it = idx.find(signed_id); it != idx.end()) {
+            return *it;
+        }
+        return nullptr;
+    }
+
+    size_t
+    size() const {
+        auto g = utilities::spinlock_guard(lock_);
+        return metas_.size();
+    }
+
+private:
+    struct by_signed_id;
+
+    using metas_type = boost::multi_index_container<
+        transaction_metadata_ptr,
+        boost::multi_index::indexed_by<
+            boost::multi_index::sequenced<>,
+            boost::multi_index::hashed_unique<
+                boost::multi_index::tag<by_signed_id>,
+                boost::multi_index::member<transaction_metadata, transaction_id_type, &transaction_metadata::signed_id>,
+                std::hash<transaction_id_type>
+            >
+        >
+    >;
+
+    size_t                      capacity_;
+    mutable utilities::spinlock lock_;
+    metas_type                  metas_;
+};
+
+}}  // namespace jmzk::chain
@@ -45,13 +45,19 @@ merkle(vector<digest_type> ids) {
         return digest_type();
     }
 
+    static_assert(sizeof(digest_type) == 32, "digests should be stored continuously");
+
     while(ids.size() > 1) {
         if(ids.size() % 2)
             ids.push_back(ids.back());
 
-        for(auto i = 0u; i < ids.size() / 2; i++) {
-            ids[i] = digest_type::hash(make_canonical_pair(ids[2 * i], ids[(2 * i) + 1]));
+        // each canonical pair is 64 bytes in place, hash the whole level in one batch
+        // same as hashing the packed `make_canonical_pair` one by one
+        for(auto i = 0u; i < ids.size(); i += 2) {
+            ids[i]     = make_canonical_left(ids[i]);
+            ids[i + 1] = make_canonical_right(ids[i + 1]);
         }
+        digest_type::hash64_batch((const char*)ids.data(), ids.size() / 2, ids.data());
 
         ids.resize(ids.size() / 2);
     }
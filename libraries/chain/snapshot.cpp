@@ -1,6 +1,7 @@
 #include <jmzk/chain/snapshot.hpp>
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/iostreams/filter/zlib.hpp>
 
 #include <fc/scoped_exit.hpp>
@@ -8,6 +9,20 @@
 
 namespace jmzk { namespace chain {
 
+void
+snapshot_writer::write_section_data(const snapshot_section_data& data) {
+    jmzk_ASSERT(data.row_sizes.size() == data.row_count, snapshot_exception,
+        "Section data of ${s} is already prepared and cannot be written as rows", ("s",data.name));
+
+    write_start_section(data.name);
+    auto p = data.rows.data();
+    for(auto sz : data.row_sizes) {
+        write_row(detail::snapshot_row_raw_writer(p, sz));
+        p += sz;
+    }
+    write_end_section();
+}
+
 variant_snapshot_writer::variant_snapshot_writer(fc::mutable_variant_object& snapshot)
     : snapshot(snapshot) {
     snapshot.set("sections", fc::variants());
@@ -227,6 +242,42 @@ ostream_snapshot_writer::write_end_section() {
     row_count   = 0;
 }
 
+void
+ostream_snapshot_writer::prepare_section_data(snapshot_section_data& data) const {
+    namespace io = boost::iostreams;
+
+    // compress rows in the same way as the row stream does, then original rows are no longer needed
+    auto stream = io::filtering_ostream();
+    stream.push(io::zlib_compressor());
+    stream.push(io::back_inserter(data.compressed));
+    stream.write(data.rows.data(), data.rows.size());
+    io::close(stream);
+
+    data.rows = std::string();
+    data.row_sizes.clear();
+    data.row_sizes.shrink_to_fit();
+}
+
+void
+ostream_snapshot_writer::write_section_data(const snapshot_section_data& data) {
+    if(data.compressed.empty() && data.row_count > 0) {
+        // not prepared, fallback to write rows one by one
+        snapshot_writer::write_section_data(data);
+        return;
+    }
+
+    jmzk_ASSERT(section_pos == std::streampos(-1), snapshot_exception, "Attempting to write a new section without closing the previous section");
+
+    // section size covers row count, name and compressed rows
+    uint64_t section_size = sizeof(uint64_t) + data.name.size() + 1 + data.compressed.size();
+
+    snapshot.write((char*)&section_size, sizeof(section_size));
+    snapshot.write((char*)&data.row_count, sizeof(data.row_count));
+    snapshot.write(data.name.data(), data.name.size());
+    snapshot.put('\0');
+    snapshot.write(data.compressed.data(), data.compressed.size());
+}
+
 void
 ostream_snapshot_writer::finalize() {
     uint64_t end_marker = std::numeric_limits<uint64_t>::max();
@@ -8,21 +8,36 @@
 #define __cpp_lib_string_view
 #endif
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <deque>
 #include <fstream>
+#include <future>
+#include <limits>
+#include <list>
+#include <mutex>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 
+#include <boost/asio/thread_pool.hpp>
+#include <fmt/format.h>
+
 #include <rocksdb/db.h>
 #include <rocksdb/cache.h>
 #include <rocksdb/options.h>
 #include <rocksdb/filter_policy.h>
 #include <rocksdb/slice_transform.h>
+#include <rocksdb/sst_file_writer.h>
 #include <rocksdb/statistics.h>
 #include <rocksdb/table.h>
 
-#include <llvm/ADT/StringSet.h>
 #include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Allocator.h>
 
 #include <fc/filesystem.hpp>
 #include <fc/io/datastream.hpp>
@@ -31,6 +46,7 @@
 
 #include <jmzk/chain/config.hpp>
 #include <jmzk/chain/exceptions.hpp>
+#include <jmzk/chain/thread_utils.hpp>
 
 namespace jmzk { namespace chain {
 
@@ -48,10 +64,11 @@ namespace internal {
 #error jmzk can only be compiled in X86-64 architecture
 #endif
 
-const char*  kAssetsColumnFamilyName = "Assets";
 const size_t kSymbolIdSize           = sizeof(symbol_id_type);
 const size_t kPublicKeySize          = sizeof(fc::ecc::public_key_shim);
 const size_t kDefaultSavePointsSize  = (4 / 3 * 24 + 1) * 12;
+const size_t kMigrationBatchSize     = 16 * 1024 * 1024;
+const int    kColumns                = (int)token_type::max_value + 1;
 
 struct db_token_key : boost::noncopyable {
 public:
@@ -130,7 +147,58 @@ name128 action_key_prefixes[] = {
 
 static_assert(sizeof(action_key_prefixes) / sizeof(name128) == (int)token_type::max_value + 1);
 
-using keys_hash_set = llvm::StringSet<llvm::MallocAllocator>;
+// exists in default column family while tokens of old layout are being migrated
+const name128 kMigrationKey[] = { N128(.tokendb), N128(.migrating) };
+
+enum access_pattern {
+    kNormal = 0,
+    kHot,    // small and read by most of the actions
+    kLarge   // large sets of rows, mostly read one by one
+};
+
+const char* access_pattern_names[] = { "normal", "hot", "large" };
+
+// each token type has its own column family, tuned by its access pattern
+struct column_tuning {
+    const char*    name;
+    access_pattern pattern;
+    size_t         block_size;
+    int            bloom_bits;
+};
+
+const column_tuning column_tunings[] = {
+    { "Assets",        kNormal, 4 * 1024,  10 },
+    { "Domains",       kHot,    4 * 1024,  16 },
+    { "Tokens",        kLarge,  16 * 1024, 10 },
+    { "Groups",        kHot,    4 * 1024,  16 },
+    { "Suspends",      kNormal, 4 * 1024,  10 },
+    { "Locks",         kNormal, 4 * 1024,  10 },
+    { "Fungibles",     kHot,    4 * 1024,  16 },
+    { "ProdVotes",     kHot,    4 * 1024,  16 },
+    { "JmzkLinks",     kNormal, 4 * 1024,  10 },
+    { "PsvBonuses",    kHot,    4 * 1024,  16 },
+    { "PsvBonusDists", kNormal, 4 * 1024,  10 },
+    { "Validators",    kHot,    4 * 1024,  16 },
+    { "StakePools",    kHot,    4 * 1024,  16 },
+    { "Scripts",       kHot,    4 * 1024,  16 }
+};
+
+static_assert(sizeof(column_tunings) / sizeof(column_tuning) == kColumns);
+
+// tokens of reserved types are stored with their fixed prefixes, the others are tokens in domains.
+// names of domains cannot start with '.', so they never collide with the reserved prefixes
+token_type
+token_type_of_key(const char* key) {
+    auto prefix = name128();
+    memcpy(&prefix, key, sizeof(prefix));
+
+    for(auto i = (int)token_type::domain; i <= (int)token_type::max_value; i++) {
+        if(i != (int)token_type::token && action_key_prefixes[i] == prefix) {
+            return (token_type)i;
+        }
+    }
+    return token_type::token;
+}
 
 struct flag {
 public:
@@ -148,41 +216,6 @@ enum action_type {
     kPersist
 };
 
-enum data_type {
-    kTokenKey = 0,
-    kTokenFullKey,
-    kAssetKey,
-    kTokenKeys
-};
-
-// realtime action
-// stored in memory
-struct rt_action {
-public:
-    rt_action(uint8_t token_type, uint8_t op, uint8_t data_type, void* data) {
-        assert(data_type < 8 && op < 8);
-        f.type  = token_type;
-        f.exts  = op;
-        f.exts |= (data_type << 4);
-        SETPOINTER(void, this->data, data);
-    }
-
-    token_type get_token_type() const { return (token_type)f.type; }
-    action_op  get_action_op()  const { return (action_op)(f.exts & 0xF); }
-    data_type  get_data_type()  const { return (data_type)(f.exts >> 4); }
-
-public:
-    union {
-        flag  f;
-        void* data;
-    };
-};
-
-struct rt_group {
-    const void*                rb_snapshot;
-    small_vector<rt_action, 4> actions;
-};
-
 // persistent action
 // stored in disk
 struct pd_action {
@@ -220,30 +253,17 @@ public:
     sp_node node;
 };
 
-struct rt_token_key {
-    name128 key;
-};
-
-struct rt_token_fullkey {
-    name128 prefix;
-    name128 key;
-};
-
-struct rt_token_keys {
-    name128      prefix;
-    token_keys_t keys;
-};
-
-struct rt_asset_key {
-    char key[kSymbolIdSize + kPublicKeySize];
-};
-
 struct pd_header {
     int dirty_flag;
 };
 
 }  // namespace internal
 
+/**
+ * In-memory overlay of the writes made under savepoints, the values in it shadow the ones in db.
+ * Each savepoint records the writes with the previous values, so it can be undone without touching db.
+ * The values are written into db only when their savepoints are popped, which means they're irreversible.
+ */
 class write_cache_layer : boost::noncopyable {
 private:
     struct cache_entry {
@@ -259,23 +279,54 @@ private:
 
     using data_map_t = llvm::StringMap<cache_entry>;
 
+public:
+    // values written by a run of ops in one savepoint, shared by views and never changed once built
+    using delta_t   = llvm::StringMap<std::string>;
+    using delta_ptr = std::shared_ptr<const delta_t>;
+
+private:
+
     struct data_op {
     public:
-        data_op(data_map_t::iterator& it, std::string&& pv)
-            : it(&(*it)), pv(std::move(pv)) {}
+        data_op(data_map_t::iterator& it, std::string_view pv)
+            : it(&(*it)), pv(pv) {}
 
     public:
         data_map_t::value_type* it;
-        std::string             pv;
+        std::string_view        pv;  // allocated in the arenas of savepoint
     };
 
     struct data_ops {
+    public:
+        data_ops() = default;
+        data_ops(int64_t seq) : seq(seq) { arenas.emplace_back(); }
+        data_ops(data_ops&&) = default;
+
+        data_ops& operator=(data_ops&&) = default;
+
+    public:
         int64_t              seq;
         std::vector<data_op> vec;
+
+        // the first one is used for allocating, others are spliced from squashed savepoints
+        // all of them are released at once with the savepoint
+        std::list<llvm::BumpPtrAllocator> arenas;
+
+        // built when views are created, each one covers the ops written since the previous one.
+        // `frozen_ops` is the count of the ops covered by them
+        mutable std::vector<delta_ptr> frozen;
+        mutable size_t                 frozen_ops = 0;
+    };
+
+public:
+    struct stats_t {
+        uint64_t allocs;       // previous values allocated in arenas
+        uint64_t alloc_bytes;  // bytes of previous values allocated in arenas
+        uint64_t releases;     // arenas released together with savepoints
     };
 
 public:
-    write_cache_layer() : ops_(internal::kDefaultSavePointsSize) {}
+    write_cache_layer() : ops_(internal::kDefaultSavePointsSize), stats_() {}
 
 public:
     void put(const std::string_view& key, const std::string_view& value);
@@ -284,7 +335,7 @@ public:
 
 public:
     void add_savepoint(int64_t seq);
-    void rollback_to_latest_savepoint();
+    void rollback_to_latest_savepoint(std::function<void(const llvm::StringRef&, int)> rollback_func = nullptr);
     void squash();
     void pop_front(std::function<void(const llvm::StringRef&, std::string&&)> persist_func);
     void pop_back();
@@ -293,9 +344,18 @@ public:
     void persist_savepoints(std::ostream& os) const;
     void load_savepoints(std::istream& is);
 
+    std::vector<const data_map_t::value_type*> sorted_range(const std::string_view& prefix) const;
+    std::vector<delta_ptr> freeze(int64_t seq) const;
+
+    const stats_t& stats() const { return stats_; }
+
+private:
+    void release(data_ops& ops);
+
 private:
     data_map_t                data_;
     fc::ring_vector<data_ops> ops_;
+    stats_t                   stats_;
 
 private:
     friend class token_database_impl;
@@ -305,15 +365,30 @@ void
 write_cache_layer::put(const std::string_view& key, const std::string_view& value) {
     assert(!ops_.empty());
 
-    auto pair = data_.try_emplace(llvm::StringRef(key.data(), key.size()), 1, std::string(value.data(), value.size()));
+    auto& ops  = ops_.back();
+    auto  pair = data_.try_emplace(llvm::StringRef(key.data(), key.size()), 0, std::string());
+    auto& e    = pair.first->second;
+
+    auto pv = std::string_view();
     if(!pair.second) {
-        auto pv = std::move(pair.first->second.value);
-        pair.first->second.used_count += 1;
-        pair.first->second.value       = std::string(value.data(), value.size());
-        ops_.back().vec.emplace_back(data_op(pair.first, std::move(pv)));
-        return;
+        // keep previous value in arena, the buffer of entry is reused for new value
+        // non-null `pv` marks that there's a previous value in cache, even if it's empty
+        if(e.value.empty()) {
+            pv = std::string_view("", 0);
+        }
+        else {
+            auto buf = (char*)ops.arenas.front().Allocate(e.value.size(), 1);
+            memcpy(buf, e.value.data(), e.value.size());
+            pv = std::string_view(buf, e.value.size());
+
+            stats_.allocs      += 1;
+            stats_.alloc_bytes += e.value.size();
+        }
     }
-    ops_.back().vec.emplace_back(data_op(pair.first, std::string()));
+    e.used_count += 1;
+    e.value.assign(value.data(), value.size());
+
+    ops.vec.emplace_back(data_op(pair.first, pv));
 }
 
 int
@@ -333,22 +408,45 @@ write_cache_layer::exists(const std::string_view& key) const {
 
 void
 write_cache_layer::add_savepoint(int64_t seq) {
-    ops_.push_back(data_ops{ .seq = seq, .vec = {} });
+    ops_.push_back(data_ops(seq));
+}
+
+// slots in ring are not destructed when popped, release the memory here
+void
+write_cache_layer::release(data_ops& ops) {
+    stats_.releases += ops.arenas.size();
+
+    ops.arenas.clear();
+    ops.vec = std::vector<data_op>();
+    ops.frozen.clear();
+    ops.frozen_ops = 0;
 }
 
+// `rollback_func` is called with each key rolled back and whether it's removed from cache
 void
-write_cache_layer::rollback_to_latest_savepoint() {
+write_cache_layer::rollback_to_latest_savepoint(std::function<void(const llvm::StringRef&, int)> rollback_func) {
     auto& ops = ops_.back();
     for(auto it = ops.vec.rbegin(); it != ops.vec.rend(); it++) {
         auto& op = *it;
         if(--op.it->second.used_count == 0) {
+            // no savepoint writes this key anymore, so the value before this op is in db,
+            // either it's not written by any savepoint or it's persisted when its savepoint was popped
+            if(rollback_func) {
+                rollback_func(op.it->first(), true);
+            }
             data_.erase(op.it->first());
         }
         else {
-            assert(!op.it->second.value.empty());
-            op.it->second.value = std::move(op.pv);
+            // earlier savepoints still write this key, so the value before this op must be kept in cache
+            jmzk_ASSERT(op.pv.data() != nullptr, token_database_exception,
+                "Previous value of key: ${k} is missing in cache when rolling back", ("k", op.it->first().str()));
+            op.it->second.value.assign(op.pv.data(), op.pv.size());
+            if(rollback_func) {
+                rollback_func(op.it->first(), false);
+            }
         }
     }
+    release(ops);
     ops_.pop_back();
 }
 
@@ -358,27 +456,120 @@ write_cache_layer::squash() {
     auto& b1 = ops_[ops_.size() - 1];
     auto& b2 = ops_[ops_.size() - 2];
 
+    // ops of `b1` can only be frozen when all of `b2` are, so frozen ones are still the leading ops after merging
+    if(b2.frozen_ops == b2.vec.size()) {
+        b2.frozen_ops += b1.frozen_ops;
+        b2.frozen.insert(b2.frozen.end(), b1.frozen.begin(), b1.frozen.end());
+    }
     b2.vec.insert(b2.vec.end(), b1.vec.begin(), b1.vec.end());
+    // previous values are still referred by ops, move arenas without copying them
+    b2.arenas.splice(b2.arenas.end(), b1.arenas);
+    b1.vec = std::vector<data_op>();
+    b1.frozen.clear();
+    b1.frozen_ops = 0;
     ops_.pop_back();
 }
 
+// `persist_func` is called with the value written by each key of the popped savepoint, in the order of writes
 void
 write_cache_layer::pop_front(std::function<void(const llvm::StringRef&, std::string&&)> persist_func) {
+    // keys written again by later savepoints stay in cache, their values written by
+    // the popped savepoint are the previous values of the first later ops on them
+    auto pending = std::unordered_set<const data_map_t::value_type*>();
     for(auto& op : ops_.front().vec) {
         if(--op.it->second.used_count == 0) {
+            pending.erase(op.it);
             persist_func(op.it->first(), std::move(op.it->second.value));
             data_.erase(op.it->first());
         }
+        else {
+            pending.emplace(op.it);
+        }
+    }
+
+    for(auto i = 1u; i < ops_.size() && !pending.empty(); i++) {
+        for(auto& op : ops_[i].vec) {
+            if(pending.erase(op.it)) {
+                persist_func(op.it->first(), std::string(op.pv));
+            }
+        }
     }
+    assert(pending.empty());
 
+    release(ops_.front());
     ops_.pop_front();
 }
 
 void
 write_cache_layer::pop_back() {
+    release(ops_.back());
     ops_.pop_back();
 }
 
+std::vector<const write_cache_layer::data_map_t::value_type*>
+write_cache_layer::sorted_range(const std::string_view& prefix) const {
+    auto entries = std::vector<const data_map_t::value_type*>();
+    for(auto& it : data_) {
+        if(it.first().startswith(llvm::StringRef(prefix.data(), prefix.size()))) {
+            entries.emplace_back(&it);
+        }
+    }
+
+    // same as the bytewise order of keys in rocksdb
+    std::sort(entries.begin(), entries.end(), [](auto a, auto b) {
+        return a->first().compare(b->first()) < 0;
+    });
+    return entries;
+}
+
+// returns the values written by the savepoints not newer than `seq`, from the oldest to the newest ones.
+// savepoints are only written when they're the latest one, so the ops not frozen yet are always the newest ones,
+// and only they are built here, into one delta for each savepoint. values written by them are found by walking
+// the ops backward, newer savepoints excluded are walked as well since their previous values are needed
+std::vector<write_cache_layer::delta_ptr>
+write_cache_layer::freeze(int64_t seq) const {
+    auto last = (int)ops_.size() - 1;
+    while(last >= 0 && ops_[last].seq > seq) {
+        last--;
+    }
+
+    auto next_values = std::unordered_map<const data_map_t::value_type*, std::string_view>();
+    for(auto i = (int)ops_.size() - 1; i >= 0; i--) {
+        auto& ops = ops_[i];
+        if(ops.frozen_ops == ops.vec.size()) {
+            if(ops.vec.empty()) {
+                continue;
+            }
+            // older ones are all frozen as well
+            break;
+        }
+
+        auto delta = (i <= last) ? std::make_shared<delta_t>() : nullptr;
+        for(auto j = (int)ops.vec.size() - 1; j >= (int)ops.frozen_ops; j--) {
+            auto& op = ops.vec[j];
+            if(delta) {
+                auto it = next_values.find(op.it);
+                auto v  = (it != next_values.end()) ? it->second : std::string_view(op.it->second.value);
+
+                // only the last write in one run of ops is kept
+                delta->try_emplace(op.it->first(), std::string(v));
+            }
+            next_values[op.it] = op.pv;
+        }
+        if(delta) {
+            ops.frozen.emplace_back(std::move(delta));
+            ops.frozen_ops = ops.vec.size();
+        }
+    }
+
+    auto deltas = std::vector<delta_ptr>();
+    for(auto i = 0; i <= last; i++) {
+        auto& ops = ops_[i];
+        deltas.insert(deltas.end(), ops.frozen.cbegin(), ops.frozen.cend());
+    }
+    return deltas;
+}
+
 namespace internal {
 
 struct wc_entry {
@@ -395,26 +586,38 @@ struct wc_entry_pack {
 
 void
 write_cache_layer::clear() {
+    while(!ops_.empty()) {
+        release(ops_.back());
+        ops_.pop_back();
+    }
     data_.clear();
-    ops_.clear();
 }
 
 void
 write_cache_layer::persist_savepoints(std::ostream& os) const {
     using namespace internal;
 
+    // value written by one op is the previous value of the next op on the same key,
+    // or the current value if it's the last one. So walk the ops backward
+    auto next_values = std::unordered_map<const data_map_t::value_type*, std::string_view>();
+
     auto pack = std::vector<wc_entry_pack>();
     pack.resize(ops_.size());
-    for(auto i = 0; i < ops_.size(); i++) {
+    for(auto i = (int)ops_.size() - 1; i >= 0; i--) {
         auto& ops = ops_[i];
-        
+
         auto& epack = pack[i];
         epack.seq   = ops.seq;
-        for(auto& op : ops.vec) {
-            epack.vec.emplace_back(wc_entry {
+        epack.vec.resize(ops.vec.size());
+        for(auto j = (int)ops.vec.size() - 1; j >= 0; j--) {
+            auto& op = ops.vec[j];
+            auto  it = next_values.find(op.it);
+
+            epack.vec[j] = wc_entry {
                 .k  = op.it->first().str(),
-                .v  = op.it->second.value
-            });
+                .v  = (it != next_values.end()) ? std::string(it->second) : op.it->second.value
+            };
+            next_values[op.it] = op.pv;
         }
     }
     fc::raw::pack(os, pack);
@@ -452,15 +655,18 @@ public:
                     const small_vector_base<std::string_view>& data);
     void put_asset(const address& addr, const symbol_id_type sym_id, const std::string_view& data);
 
-    int exists_token(const name128& prefix, const name128& key) const;
+    int exists_token(token_type type, const name128& prefix, const name128& key) const;
     int exists_asset(const address& addr, const symbol_id_type sym_id) const;
 
-    int read_token(const name128& prefix, const name128& key, std::string& out, bool no_throw = false) const;
+    int read_token(token_type type, const name128& prefix, const name128& key, std::string& out, bool no_throw = false) const;
     int read_asset(const address& addr, const symbol_id_type sym_id, std::string& out, bool no_throw = false) const;
 
-    int read_tokens_range(const name128& prefix, int skip, const read_value_func& func) const;
+    int read_tokens_range(token_type type, const name128& prefix, int skip, const read_value_func& func) const;
     int read_assets_range(const symbol_id_type sym_id, int skip, const read_value_func& func) const;
 
+    token_database_view_ptr new_view(int64_t seq) const;
+    std::unique_ptr<token_database_bulk_loader> new_bulk_loader();
+
 public:
     void add_savepoint(int64_t seq);
     void rollback_to_latest_savepoint();
@@ -472,15 +678,22 @@ public:
     int64_t new_savepoint_session_seq() const;
     size_t  savepoints_size() const { return savepoints_.size(); }
 
-    void rollback_rt_group(internal::rt_group*);
     void rollback_pd_group(internal::pd_group*);
 
     int should_record() { return !savepoints_.empty(); }
 
-    void record(uint8_t action_type, uint8_t op, uint8_t data_type, void* data);
     void free_savepoint(internal::savepoint&);
     void free_all_savepoints();
 
+    rocksdb::ColumnFamilyOptions default_column_options(const rocksdb::Options& options, const std::shared_ptr<rocksdb::Cache>& cache) const;
+    rocksdb::ColumnFamilyOptions column_options(int column, const rocksdb::Options& options, const std::shared_ptr<rocksdb::Cache>& cache) const;
+    void migrate_default_column();
+
+    void write_irreversible(rocksdb::WriteBatch& batch);
+    void start_flusher();
+    void stop_flusher();
+    void sync_wal();
+
     void persist_savepoints() const;
     void load_savepoints();
     void persist_savepoints(std::ostream&) const;
@@ -488,6 +701,8 @@ public:
     void flush() const;
 
     std::string get_db_path() const { return config_.db_path.to_native_ansi_path(); }
+    std::string stats() const;
+    std::string column_stats() const;
 
 public:
     token_database&        self_;
@@ -497,12 +712,23 @@ public:
     rocksdb::ReadOptions  read_opts_;
     rocksdb::WriteOptions write_opts_;
 
-    rocksdb::ColumnFamilyHandle* tokens_handle_;
-    rocksdb::ColumnFamilyHandle* assets_handle_;
+    rocksdb::ColumnFamilyHandle*                                 default_handle_;  // no data in it, except during migration
+    std::array<rocksdb::ColumnFamilyHandle*, internal::kColumns> handles_;         // indexed by token type
 
+    write_cache_layer tokens_write_cache_;
     write_cache_layer assets_write_cache_;
 
     fc::ring_vector<internal::savepoint> savepoints_;
+
+    // background flusher of `group_commit` durability mode
+    std::thread             flusher_;
+    std::mutex              flusher_mutex_;
+    std::condition_variable flusher_cv_;
+    bool                    flusher_stop_;
+
+    std::atomic<uint64_t> unsynced_writes_;  // irreversible writes not synced yet
+    std::atomic<uint64_t> irreversible_writes_;
+    std::atomic<uint64_t> wal_syncs_;
 };
 
 token_database_impl::token_database_impl(token_database& self, const token_database::config& config)
@@ -511,9 +737,13 @@ token_database_impl::token_database_impl(token_database& self, const token_datab
     , db_(nullptr)
     , read_opts_()
     , write_opts_()
-    , tokens_handle_(nullptr)
-    , assets_handle_(nullptr)
-    , savepoints_(internal::kDefaultSavePointsSize) {}
+    , default_handle_(nullptr)
+    , handles_()
+    , savepoints_(internal::kDefaultSavePointsSize)
+    , flusher_stop_(false)
+    , unsynced_writes_(0)
+    , irreversible_writes_(0)
+    , wal_syncs_(0) {}
 
 void
 token_database_impl::open(int load_persistence) {
@@ -521,6 +751,8 @@ token_database_impl::open(int load_persistence) {
     using namespace internal;
 
     jmzk_ASSERT(db_ == nullptr, token_database_exception, "Token database is already opened");
+    jmzk_ASSERT(config_.durability != durability_mode::group_commit || config_.group_commit_ms > 0, token_database_exception,
+        "Interval of group commit should be greater than 0");
 
     auto options = Options();
     options.OptimizeUniversalStyleCompaction();
@@ -540,31 +772,7 @@ token_database_impl::open(int load_persistence) {
 #endif
     }
 
-    auto assets_options = ColumnFamilyOptions(options);
-
-    if(config_.profile == storage_profile::disk) {
-        auto table_opts = BlockBasedTableOptions();
-
-        table_opts.index_type     = BlockBasedTableOptions::kHashSearch;
-        table_opts.checksum       = kxxHash64;
-        table_opts.format_version = 4;
-        table_opts.block_cache    = NewLRUCache(config_.block_cache_size);
-        table_opts.filter_policy.reset(NewBloomFilterPolicy(10, false));
-
-        options.table_factory.reset(NewBlockBasedTableFactory(table_opts));
-        assets_options.prefix_extractor.reset(NewFixedPrefixTransform(kSymbolIdSize));
-    }
-    else if(config_.profile == storage_profile::memory) {
-        auto tokens_table_options = PlainTableOptions();
-        auto assets_table_options = PlainTableOptions();
-        tokens_table_options.user_key_len = sizeof(name128) + sizeof(name128);
-        assets_table_options.user_key_len = kPublicKeySize + kSymbolIdSize;
-
-        options.table_factory.reset(NewPlainTableFactory(tokens_table_options));
-        assets_options.table_factory.reset(NewPlainTableFactory(assets_table_options));
-        assets_options.prefix_extractor.reset(NewFixedPrefixTransform(kSymbolIdSize));
-    }
-    else {
+    if(config_.profile != storage_profile::disk && config_.profile != storage_profile::memory) {
         jmzk_THROW(token_database_exception, "Unknown token database profile");
     }
 
@@ -572,62 +780,238 @@ token_database_impl::open(int load_persistence) {
     read_opts_.prefix_same_as_start = true;
     read_opts_.tailing              = true;
 
+    // block cache is shared by all the column families, the high priority pool is for index and filter blocks of hot ones
+    auto cache   = NewLRUCache(config_.block_cache_size, -1, false, 0.5);
     auto columns = std::vector<ColumnFamilyDescriptor>();
-    auto handles = std::vector<ColumnFamilyHandle*>();
-    columns.emplace_back(kDefaultColumnFamilyName, options);
+    columns.emplace_back(kDefaultColumnFamilyName, default_column_options(options, cache));
+    for(auto i = 0; i < kColumns; i++) {
+        columns.emplace_back(column_tunings[i].name, column_options(i, options, cache));
+    }
 
+    auto path = config_.db_path.to_native_ansi_path();
     if(!fc::exists(config_.db_path)) {
-        auto t = config_.db_path.to_native_ansi_path();
-        // create new database and open
         fc::create_directories(config_.db_path);
-        
-        auto status  = DB::Open(options, config_.db_path.to_native_ansi_path(), columns, &handles, &db_);
-        if(!status.ok()) {
-            jmzk_THROW(token_database_rocksdb_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
+    }
+
+    // open the column families existed, and create the others after opening.
+    // new database only has default one, and database of old layout has default and `Assets` ones
+    auto existed = std::vector<std::string>();
+    DB::ListColumnFamilies(options, path, &existed);
+
+    auto opening = std::vector<ColumnFamilyDescriptor>();
+    auto missing = std::vector<int>();
+    opening.emplace_back(columns[0]);
+    for(auto i = 0; i < kColumns; i++) {
+        auto& c = columns[i + 1];
+        if(std::find(existed.cbegin(), existed.cend(), c.name) != existed.cend()) {
+            opening.emplace_back(c);
+        }
+        else {
+            missing.emplace_back(i);
         }
+    }
+
+    auto handles = std::vector<ColumnFamilyHandle*>();
+    auto status  = DB::Open(options, path, opening, &handles, &db_);
+    if(!status.ok()) {
+        jmzk_THROW(token_database_rocksdb_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
+    }
+
+    assert(handles.size() == opening.size());
+    default_handle_ = handles[0];
+    for(auto i = 1u; i < handles.size(); i++) {
+        auto it = std::find_if(std::begin(column_tunings), std::end(column_tunings), [&](auto& t) { return opening[i].name == t.name; });
+        handles_[it - std::begin(column_tunings)] = handles[i];
+    }
 
-        assert(handles.size() == 1);
-        tokens_handle_ = handles[0];
+    // tokens of old layout are all in default column family, mark it before creating new column families,
+    // so the migration is always resumed if it's interrupted
+    auto marker = db_token_key(kMigrationKey[0], kMigrationKey[1]);
+    if(!existed.empty() && std::find(missing.cbegin(), missing.cend(), (int)token_type::domain) != missing.cend()) {
+        auto sync_write_opts = write_opts_;
+        sync_write_opts.sync = true;
 
-        status = db_->CreateColumnFamily(assets_options, kAssetsColumnFamilyName, &assets_handle_);
+        status = db_->Put(sync_write_opts, default_handle_, marker.as_slice(), rocksdb::Slice());
         if(!status.ok()) {
             jmzk_THROW(token_database_rocksdb_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
         }
+    }
 
-        if(load_persistence) {
-            load_savepoints();
+    for(auto i : missing) {
+        status = db_->CreateColumnFamily(columns[i + 1].options, columns[i + 1].name, &handles_[i]);
+        if(!status.ok()) {
+            jmzk_THROW(token_database_rocksdb_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
         }
-        return;
     }
 
-    columns.emplace_back(kAssetsColumnFamilyName, assets_options);
-
-    auto status = DB::Open(options, config_.db_path.to_native_ansi_path(), columns, &handles, &db_);
-    if(!status.ok()) {
-        jmzk_THROW(token_database_rocksdb_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
+    auto value = std::string();
+    if(db_->Get(read_opts_, default_handle_, marker.as_slice(), &value).ok()) {
+        migrate_default_column();
     }
 
-    assert(handles.size() == 2);
-    tokens_handle_ = handles[0];
-    assets_handle_ = handles[1];
-
+    start_flusher();
     if(load_persistence) {
         load_savepoints();
     }
 }
 
+// default column family keeps all the tokens in old layout until they're migrated, it's written with the table format
+// the old versions used for the profile, and read by an adaptive factory so tables of either format can be opened
+rocksdb::ColumnFamilyOptions
+token_database_impl::default_column_options(const rocksdb::Options& options, const std::shared_ptr<rocksdb::Cache>& cache) const {
+    using namespace rocksdb;
+
+    auto opts = ColumnFamilyOptions(options);
+
+    auto block_opts = BlockBasedTableOptions();
+    block_opts.index_type     = BlockBasedTableOptions::kHashSearch;
+    block_opts.checksum       = kxxHash64;
+    block_opts.format_version = 4;
+    block_opts.block_cache    = cache;
+    block_opts.filter_policy.reset(NewBloomFilterPolicy(10, false));
+
+    auto plain_opts = PlainTableOptions();
+    plain_opts.user_key_len = sizeof(name128) + sizeof(name128);
+
+    auto block_factory = std::shared_ptr<TableFactory>(NewBlockBasedTableFactory(block_opts));
+    auto plain_factory = std::shared_ptr<TableFactory>(NewPlainTableFactory(plain_opts));
+    auto write_factory = (config_.profile == storage_profile::memory) ? plain_factory : block_factory;
+
+    opts.table_factory.reset(NewAdaptiveTableFactory(write_factory, block_factory, plain_factory));
+    return opts;
+}
+
+rocksdb::ColumnFamilyOptions
+token_database_impl::column_options(int column, const rocksdb::Options& options, const std::shared_ptr<rocksdb::Cache>& cache) const {
+    using namespace rocksdb;
+    using namespace internal;
+
+    auto& t    = column_tunings[column];
+    auto  opts = ColumnFamilyOptions(options);
+
+    if(column == (int)token_type::asset) {
+        opts.prefix_extractor.reset(NewFixedPrefixTransform(kSymbolIdSize));
+    }
+
+    if(config_.profile == storage_profile::memory) {
+        auto table_opts = PlainTableOptions();
+        table_opts.user_key_len       = (column == (int)token_type::asset) ? (kSymbolIdSize + kPublicKeySize) : (sizeof(name128) * 2);
+        table_opts.bloom_bits_per_key = t.bloom_bits;
+
+        opts.table_factory.reset(NewPlainTableFactory(table_opts));
+        return opts;
+    }
+
+    auto table_opts = BlockBasedTableOptions();
+
+    table_opts.index_type     = BlockBasedTableOptions::kHashSearch;
+    table_opts.checksum       = kxxHash64;
+    table_opts.format_version = 4;
+    table_opts.block_cache    = cache;
+    table_opts.block_size     = t.block_size;
+    table_opts.filter_policy.reset(NewBloomFilterPolicy(t.bloom_bits, false));
+
+    if(t.pattern == kHot) {
+        // small and read by most of the actions, keep index and filter in cache
+        // and not compress the upper levels, they're not worth the cpu
+        table_opts.cache_index_and_filter_blocks                   = true;
+        table_opts.cache_index_and_filter_blocks_with_high_priority = true;
+        table_opts.pin_l0_filter_and_index_blocks_in_cache         = true;
+
+        opts.compression = CompressionType::kNoCompression;
+    }
+
+    opts.table_factory.reset(NewBlockBasedTableFactory(table_opts));
+    return opts;
+}
+
+// tokens were all stored in default column family by old versions, move them into the column families of their types.
+// each batch puts and deletes rows atomically, and the marker is removed in the end,
+// so migration is resumed in the next opening if it's interrupted
+void
+token_database_impl::migrate_default_column() {
+    using namespace internal;
+
+    ilog("Migrating tokens into column families of their types");
+
+    auto marker       = db_token_key(kMigrationKey[0], kMigrationKey[1]);
+    auto read_opts    = read_opts_;
+    read_opts.tailing = false;
+
+    auto batch = rocksdb::WriteBatch();
+    auto total = size_t(0);
+
+    auto write = [&] {
+        auto status = db_->Write(write_opts_, &batch);
+        if(!status.ok()) {
+            FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
+        }
+        batch.Clear();
+    };
+
+    auto move_prefix = [&](const name128& prefix, rocksdb::ColumnFamilyHandle* handle) {
+        auto it = std::unique_ptr<rocksdb::Iterator>(db_->NewIterator(read_opts, default_handle_));
+        for(it->Seek(rocksdb::Slice((char*)&prefix, sizeof(prefix))); it->Valid(); it->Next()) {
+            batch.Put(handle, it->key(), it->value());
+            batch.Delete(default_handle_, it->key());
+            total++;
+
+            if(batch.GetDataSize() >= kMigrationBatchSize) {
+                write();
+            }
+        }
+        if(!it->status().ok()) {
+            FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", it->status().getState()));
+        }
+    };
+
+    for(auto i = (int)token_type::domain; i <= (int)token_type::max_value; i++) {
+        if(i != (int)token_type::token) {
+            move_prefix(action_key_prefixes[i], handles_[i]);
+        }
+    }
+    write();
+
+    // domains are all moved already, tokens are found by their names
+    auto& dprefix = action_key_prefixes[(int)token_type::domain];
+    auto  dit     = std::unique_ptr<rocksdb::Iterator>(db_->NewIterator(read_opts, handles_[(int)token_type::domain]));
+    for(dit->Seek(rocksdb::Slice((char*)&dprefix, sizeof(dprefix))); dit->Valid(); dit->Next()) {
+        auto domain = name128();
+        memcpy(&domain, dit->key().data() + sizeof(name128), sizeof(domain));
+        move_prefix(domain, handles_[(int)token_type::token]);
+    }
+    write();
+
+    auto sync_write_opts = write_opts_;
+    sync_write_opts.sync = true;
+    auto status = db_->Delete(sync_write_opts, default_handle_, marker.as_slice());
+    if(!status.ok()) {
+        FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
+    }
+
+    ilog("${n} tokens are migrated", ("n", total));
+}
+
 void
 token_database_impl::close(int persist) {
     if(db_) {
+        // sync all the irreversible writes before savepoints log is persisted
+        stop_flusher();
         if(persist) {
             persist_savepoints();
         }
         if(!savepoints_.empty()) {
             free_all_savepoints();
         }
-        
-        delete tokens_handle_;
-        delete assets_handle_;
+        // writes not persisted are discarded together with savepoints
+        tokens_write_cache_.clear();
+        assets_write_cache_.clear();
+
+        for(auto& h : handles_) {
+            delete h;
+            h = nullptr;
+        }
+        delete default_handle_;
         delete db_;
 
         db_ = nullptr;
@@ -638,30 +1022,15 @@ void
 token_database_impl::put_token(token_type type, action_op op, const name128& prefix, const name128& key, const std::string_view& data) {
     using namespace internal;
 
-    auto dbkey  = db_token_key(prefix, key);
-    auto status = db_->Put(write_opts_, dbkey.as_slice(), data);
-    if(!status.ok()) {
-        FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
-    }
+    auto dbkey = db_token_key(prefix, key);
     if(should_record()) {
-        void* data;
-
-        // for `token` action, needs to record both prefix and key, prefix refers to the domain
-        // for `non-token` action, prefix is not necessary which can be inferred by the `type`
-        if(type != token_type::token) {
-            assert(prefix == action_key_prefixes[(int)type]);
-            auto data = (rt_token_key*)malloc(sizeof(rt_token_key));
-            data->key = key;
-
-            record((int)type, (int)op, (int)kTokenKey, data);
-        }
-        else {
-            auto data    = (rt_token_fullkey*)malloc(sizeof(rt_token_fullkey));
-            data->prefix = prefix;
-            data->key    = key;
+        tokens_write_cache_.put(dbkey.as_string_view(), data);
+        return;
+    }
 
-            record((int)type, (int)op, (int)kTokenFullKey, data);
-        }
+    auto status = db_->Put(write_opts_, handles_[(int)type], dbkey.as_slice(), data);
+    if(!status.ok()) {
+        FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
     }
 }
 
@@ -674,19 +1043,23 @@ token_database_impl::put_tokens(token_type type,
     using namespace internal;
     assert(keys.size() == data.size());
 
-    for(auto i = 0u; i < keys.size(); i++) {
-        auto dbkey  = db_token_key(prefix, keys[i]);
-        auto status = db_->Put(write_opts_, dbkey.as_slice(), data[i]);
-        if(!status.ok()) {
-            FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
+    if(should_record()) {
+        for(auto i = 0u; i < keys.size(); i++) {
+            auto dbkey = db_token_key(prefix, keys[i]);
+            tokens_write_cache_.put(dbkey.as_string_view(), data[i]);
         }
+        return;
+    }
+
+    auto batch = rocksdb::WriteBatch();
+    for(auto i = 0u; i < keys.size(); i++) {
+        auto dbkey = db_token_key(prefix, keys[i]);
+        batch.Put(handles_[(int)type], dbkey.as_slice(), data[i]);
     }
-    if(should_record()) {
-        auto data = (rt_token_keys*)malloc(sizeof(rt_token_keys));
-        data->prefix = prefix;
-        new(&data->keys) token_keys_t(std::move(keys));
 
-        record((int)type, (int)op, (int)kTokenKeys, data);
+    auto status = db_->Write(write_opts_, &batch);
+    if(!status.ok()) {
+        FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
     }
 }
 
@@ -700,7 +1073,7 @@ token_database_impl::put_asset(const address& addr, const symbol_id_type sym_id,
         return;
     }
     else {
-        auto status = db_->Put(write_opts_, assets_handle_, dbkey.as_slice(), data);
+        auto status = db_->Put(write_opts_, handles_[(int)token_type::asset], dbkey.as_slice(), data);
         if(!status.ok()) {
             FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
         }
@@ -708,12 +1081,16 @@ token_database_impl::put_asset(const address& addr, const symbol_id_type sym_id,
 }
 
 int
-token_database_impl::exists_token(const name128& prefix, const name128& key) const {
+token_database_impl::exists_token(token_type type, const name128& prefix, const name128& key) const {
     using namespace internal;
 
     auto dbkey  = db_token_key(prefix, key);
     auto value  = std::string();
-    auto status = db_->Get(read_opts_, dbkey.as_slice(), &value);
+
+    if(tokens_write_cache_.exists(dbkey.as_string_view())) {
+        return true;
+    }
+    auto status = db_->Get(read_opts_, handles_[(int)type], dbkey.as_slice(), &value);
     return status.ok();
 }
 
@@ -727,16 +1104,20 @@ token_database_impl::exists_asset(const address& addr, const symbol_id_type sym_
     if(assets_write_cache_.exists(dbkey.as_string_view())) {
         return true;
     }
-    auto status = db_->Get(read_opts_, assets_handle_, dbkey.as_slice(), &value);
+    auto status = db_->Get(read_opts_, handles_[(int)token_type::asset], dbkey.as_slice(), &value);
     return status.ok();
 }
 
 int
-token_database_impl::read_token(const name128& prefix, const name128& key, std::string& out, bool no_throw) const {
+token_database_impl::read_token(token_type type, const name128& prefix, const name128& key, std::string& out, bool no_throw) const {
     using namespace internal;
 
-    auto dbkey  = db_token_key(prefix, key);
-    auto status = db_->Get(read_opts_, dbkey.as_slice(), &out);
+    auto dbkey = db_token_key(prefix, key);
+    if(tokens_write_cache_.read(dbkey.as_string_view(), out)) {
+        return true;
+    }
+
+    auto status = db_->Get(read_opts_, handles_[(int)type], dbkey.as_slice(), &out);
     if(!status.ok()) {
         if(!status.IsNotFound()) {
             FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
@@ -758,7 +1139,7 @@ token_database_impl::read_asset(const address& addr, const symbol_id_type sym_id
         return true;
     }
 
-    auto status = db_->Get(read_opts_, assets_handle_, key.as_slice(), &out);
+    auto status = db_->Get(read_opts_, handles_[(int)token_type::asset], key.as_slice(), &out);
     if(!status.ok()) {
         if(!status.IsNotFound()) {
             FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
@@ -771,103 +1152,466 @@ token_database_impl::read_asset(const address& addr, const symbol_id_type sym_id
     return true;
 }
 
-int
-token_database_impl::read_tokens_range(const name128& prefix, int skip, const read_value_func& func) const {
-    using namespace internal;
+namespace internal {
 
-    auto it    = db_->NewIterator(read_opts_);
-    auto key   = rocksdb::Slice((char*)&prefix, sizeof(prefix));
-    auto i     = 0;
+// values in write cache overlay the ones in db, merge both of them in key order
+// `cached` should be sorted entries with the `prefix`, which is removed from keys passed to `func`
+template<typename Entries, typename GetValue>
+int
+read_range(rocksdb::DB*                 db,
+           const rocksdb::ReadOptions&  read_opts,
+           rocksdb::ColumnFamilyHandle* handle,
+           const rocksdb::Slice&        prefix,
+           const Entries&               cached,
+           GetValue&&                   get_value,
+           int                          skip,
+           const read_value_func&       func) {
+    enum { kNone = 0, kDB = 1, kCache = 2, kBoth = kDB | kCache };
+
+    auto cit = cached.cbegin();
+
+    auto it    = std::unique_ptr<rocksdb::Iterator>(db->NewIterator(read_opts, handle));
     auto count = 0;
-    
-    it->Seek(key);
-    while(it->Valid()) {
-        if(i++ < skip) {
-            it->Next();
-            continue;
+    auto i     = 0;
+
+    // stop at the end of prefix even if the iterator goes further
+    auto valid = [&] { return it->Valid() && it->key().starts_with(prefix); };
+
+    it->Seek(prefix);
+    while(true) {
+        auto src = kNone;
+        auto dbv = valid();
+        if(dbv && cit != cached.cend()) {
+            auto r = it->key().compare(rocksdb::Slice((*cit)->first().data(), (*cit)->first().size()));
+            src = (r < 0) ? kDB : ((r > 0) ? kCache : kBoth);
         }
+        else if(dbv) {
+            src = kDB;
+        }
+        else if(cit != cached.cend()) {
+            src = kCache;
+        }
+        else {
+            break;
+        }
+
+        if(i++ >= skip) {
+            count++;
+
+            auto key   = rocksdb::Slice();
+            auto value = std::string();
+            if(src & kCache) {
+                // cache is newer, value in db is shadowed
+                key   = rocksdb::Slice((*cit)->first().data(), (*cit)->first().size());
+                value = get_value(*cit);
+            }
+            else {
+                key   = it->key();
+                value = it->value().ToString();
+            }
 
-        count++;
-        auto value = it->value().ToString();
-        auto key   = it->key();
+            key.remove_prefix(prefix.size());
+            if(!func(key.ToStringView(), std::move(value))) {
+                return count;
+            }
+        }
 
-        key.remove_prefix(sizeof(prefix));
-        if(!func(key.ToStringView(), std::move(value))) {
-            delete it;
-            return count;
+        if(src & kDB) {
+            it->Next();
+        }
+        if(src & kCache) {
+            cit++;
         }
-        it->Next();
     }
-    delete it;
     return count;
 }
 
+}  // namespace internal
+
+int
+token_database_impl::read_tokens_range(token_type type, const name128& prefix, int skip, const read_value_func& func) const {
+    auto cached = tokens_write_cache_.sorted_range(std::string_view((char*)&prefix, sizeof(prefix)));
+    return internal::read_range(db_, read_opts_, handles_[(int)type], rocksdb::Slice((char*)&prefix, sizeof(prefix)), cached,
+        [](auto e) -> const std::string& { return e->second.value; }, skip, func);
+}
+
 int
 token_database_impl::read_assets_range(const symbol_id_type sym_id, int skip, const read_value_func& func) const {
+    auto cached = assets_write_cache_.sorted_range(std::string_view((char*)&sym_id, sizeof(sym_id)));
+    return internal::read_range(db_, read_opts_, handles_[(int)token_type::asset], rocksdb::Slice((char*)&sym_id, sizeof(sym_id)), cached,
+        [](auto e) -> const std::string& { return e->second.value; }, skip, func);
+}
+
+class token_database_view_impl : boost::noncopyable {
+public:
+    token_database_view_impl(rocksdb::DB*                                                        db,
+                             const rocksdb::ReadOptions&                                         read_opts,
+                             const std::array<rocksdb::ColumnFamilyHandle*, internal::kColumns>& handles)
+        : db_(db)
+        , snapshot_(db->GetSnapshot())
+        , read_opts_(read_opts)
+        , handles_(handles) {
+        // tailing iterators cannot read from snapshot, range scans are kept within the prefix
+        read_opts_.tailing              = false;
+        read_opts_.total_order_seek     = false;
+        read_opts_.prefix_same_as_start = true;
+        read_opts_.snapshot             = snapshot_;
+    }
+
+    ~token_database_view_impl() {
+        db_->ReleaseSnapshot(snapshot_);
+    }
+
+public:
+    int exists_token(token_type type, const name128& prefix, const name128& key) const;
+    int read_token(token_type type, const name128& prefix, const name128& key, std::string& out, bool no_throw) const;
+    int read_asset(const address& addr, const symbol_id_type sym_id, std::string& out, bool no_throw) const;
+    int read_tokens_range(token_type type, const name128& prefix, int skip, const read_value_func& func) const;
+    int read_assets_range(const symbol_id_type sym_id, int skip, const read_value_func& func) const;
+
+private:
+    using delta_ptr = write_cache_layer::delta_ptr;
+    using entries_t = std::vector<const llvm::StringMapEntry<std::string>*>;
+
+    const std::string* find(const std::vector<delta_ptr>& deltas, const std::string_view& key) const;
+    entries_t sorted_range(const std::vector<delta_ptr>& deltas, const llvm::StringRef& prefix) const;
+
+public:
+    rocksdb::DB*                 db_;
+    const rocksdb::Snapshot*     snapshot_;
+    rocksdb::ReadOptions         read_opts_;
+
+    std::array<rocksdb::ColumnFamilyHandle*, internal::kColumns> handles_;
+
+    // values in write caches are not in db yet, they're shared with write caches and
+    // other views, from the oldest savepoint to the newest one
+    std::vector<delta_ptr> tokens_;
+    std::vector<delta_ptr> assets_;
+};
+
+const std::string*
+token_database_view_impl::find(const std::vector<delta_ptr>& deltas, const std::string_view& key) const {
+    for(auto it = deltas.crbegin(); it != deltas.crend(); it++) {
+        auto vit = (*it)->find(llvm::StringRef(key.data(), key.size()));
+        if(vit != (*it)->end()) {
+            return &vit->second;
+        }
+    }
+    return nullptr;
+}
+
+int
+token_database_view_impl::exists_token(token_type type, const name128& prefix, const name128& key) const {
     using namespace internal;
 
-    // create snapshot first
-    auto ss = db_->GetSnapshot();
-    
-    // write new values from cache into db
-    for(auto& it : assets_write_cache_.data_) {
-        auto k = rocksdb::Slice(it.first().data(), it.first().size());
-        auto v = rocksdb::Slice(it.second.value.data(), it.second.value.size());
-        db_->Put(write_opts_, assets_handle_, k, v);
+    auto dbkey  = db_token_key(prefix, key);
+    auto value  = std::string();
+
+    if(find(tokens_, dbkey.as_string_view())) {
+        return true;
     }
+    auto status = db_->Get(read_opts_, handles_[(int)type], dbkey.as_slice(), &value);
+    return status.ok();
+}
 
-    // scan values
-    auto it    = db_->NewIterator(read_opts_, assets_handle_);
-    auto key   = rocksdb::Slice((char*)&sym_id, sizeof(sym_id));
-    auto count = 0;
-    auto i     = 0;
-    
-    it->Seek(key);
-    while(it->Valid()) {
-        if(i++ < skip) {
-            it->Next();
-            continue;
+int
+token_database_view_impl::read_token(token_type type, const name128& prefix, const name128& key, std::string& out, bool no_throw) const {
+    using namespace internal;
+
+    auto dbkey = db_token_key(prefix, key);
+    if(auto v = find(tokens_, dbkey.as_string_view()); v) {
+        out = *v;
+        return true;
+    }
+
+    auto status = db_->Get(read_opts_, handles_[(int)type], dbkey.as_slice(), &out);
+    if(!status.ok()) {
+        if(!status.IsNotFound()) {
+            FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
+        }
+        if(!no_throw) {
+            jmzk_THROW(unknown_token_database_key, "Cannot find key: ${k} with prefix: ${p}", ("k",key)("p",prefix));
         }
+        return false;
+    }
+    return true;
+}
+
+int
+token_database_view_impl::read_asset(const address& addr, const symbol_id_type sym_id, std::string& out, bool no_throw) const {
+    using namespace internal;
 
-        count++;
-        auto value = it->value().ToString();
-        auto key   = it->key();
+    auto key = db_asset_key(addr, sym_id);
+    if(auto v = find(assets_, key.as_string_view()); v) {
+        out = *v;
+        return true;
+    }
+
+    auto status = db_->Get(read_opts_, handles_[(int)token_type::asset], key.as_slice(), &out);
+    if(!status.ok()) {
+        if(!status.IsNotFound()) {
+            FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
+        }
+        if(!no_throw) {
+            jmzk_THROW2(unknown_token_database_key, "There's no balance of fungible with sym id: {} in address: {}", sym_id, addr);
+        }
+        return false;
+    }
+    return true;
+}
 
-        key.remove_prefix(sizeof(sym_id));
-        if(!func(key.ToStringView(), std::move(value))) {
-            delete it;
-            return count;
+token_database_view_impl::entries_t
+token_database_view_impl::sorted_range(const std::vector<delta_ptr>& deltas, const llvm::StringRef& prefix) const {
+    // collect from the newest savepoint, so after stable sorting the newest value of each key comes first
+    auto entries = entries_t();
+    for(auto it = deltas.crbegin(); it != deltas.crend(); it++) {
+        for(auto& e : **it) {
+            if(e.first().startswith(prefix)) {
+                entries.emplace_back(&e);
+            }
         }
-        it->Next();
     }
-    delete it;
+    std::stable_sort(entries.begin(), entries.end(), [](auto a, auto b) {
+        return a->first().compare(b->first()) < 0;
+    });
+    entries.erase(std::unique(entries.begin(), entries.end(), [](auto a, auto b) {
+        return a->first() == b->first();
+    }), entries.end());
+    return entries;
+}
 
-    // restore values
-    auto snapshot_read_opts_     = read_opts_;
-    snapshot_read_opts_.snapshot = ss;
+int
+token_database_view_impl::read_tokens_range(token_type type, const name128& prefix, int skip, const read_value_func& func) const {
+    auto cached = sorted_range(tokens_, llvm::StringRef((char*)&prefix, sizeof(prefix)));
+    return internal::read_range(db_, read_opts_, handles_[(int)type], rocksdb::Slice((char*)&prefix, sizeof(prefix)), cached,
+        [](auto e) -> const std::string& { return e->second; }, skip, func);
+}
 
-    auto batch = rocksdb::WriteBatch();
-    for(auto& it : assets_write_cache_.data_) {
-        auto v = std::string();
-        auto k = rocksdb::Slice(it.first().data(), it.first().size());
-        auto s = db_->Get(snapshot_read_opts_, assets_handle_, k, &v);
-        if(s.ok()) {
-            // put value back
-            batch.Put(assets_handle_, k, v);
+int
+token_database_view_impl::read_assets_range(const symbol_id_type sym_id, int skip, const read_value_func& func) const {
+    auto cached = sorted_range(assets_, llvm::StringRef((char*)&sym_id, sizeof(sym_id)));
+    return internal::read_range(db_, read_opts_, handles_[(int)token_type::asset], rocksdb::Slice((char*)&sym_id, sizeof(sym_id)), cached,
+        [](auto e) -> const std::string& { return e->second; }, skip, func);
+}
+
+token_database_view_ptr
+token_database_impl::new_view(int64_t seq) const {
+    jmzk_ASSERT(db_ != nullptr, token_database_exception, "Token database is not opened");
+
+    // only the ops written since last view are built, others are shared
+    auto my = std::make_unique<token_database_view_impl>(db_, read_opts_, handles_);
+    my->tokens_ = tokens_write_cache_.freeze(seq);
+    my->assets_ = assets_write_cache_.freeze(seq);
+    return token_database_view_ptr(new token_database_view(std::move(my)));
+}
+
+class token_database_bulk_loader_impl : boost::noncopyable {
+public:
+    // chunks bigger than this are cut into a new file
+    static constexpr size_t kChunkSize = 64 * 1024 * 1024;
+
+    struct chunk {
+        std::vector<std::pair<std::string, std::string>> rows;
+        size_t                                           bytes = 0;
+    };
+
+    struct sst_file {
+        std::string path;
+        std::string smallest;
+        std::string largest;
+    };
+
+    static constexpr int kColumns = internal::kColumns;
+
+public:
+    token_database_bulk_loader_impl(token_database_impl& db);
+    ~token_database_bulk_loader_impl();
+
+public:
+    void put(int column, std::string&& key, std::string&& value);
+    void finish();
+
+private:
+    void flush_chunk(int column);
+    void wait_oldest();
+    void ingest(int column, std::vector<sst_file>& files);
+
+    static sst_file write_file(const rocksdb::Options& options, std::string path, chunk&& c);
+
+private:
+    token_database_impl& db_;
+    fc::path             dir_;
+    size_t               threads_;
+    bool                 direct_;  // plain table files cannot be ingested, write into db directly instead
+    int                  next_file_;
+
+    std::optional<boost::asio::thread_pool> thread_pool_;
+
+    std::array<rocksdb::ColumnFamilyHandle*, kColumns> handles_;
+    std::array<rocksdb::Options, kColumns>             options_;
+    std::array<chunk, kColumns>                        chunks_;
+    std::array<std::vector<sst_file>, kColumns>        files_;
+
+    std::deque<std::pair<int, std::future<sst_file>>> pending_;
+};
+
+token_database_bulk_loader_impl::token_database_bulk_loader_impl(token_database_impl& db)
+    : db_(db)
+    , dir_(db.config_.db_path / "ingest")
+    , threads_(std::max(std::thread::hardware_concurrency(), 1u))
+    , direct_(db.config_.profile == storage_profile::memory)
+    , next_file_(0) {
+    handles_ = db_.handles_;
+    if(direct_) {
+        return;
+    }
+
+    for(auto i = 0; i < kColumns; i++) {
+        options_[i] = db_.db_->GetOptions(handles_[i]);
+    }
+    if(fc::exists(dir_)) {
+        fc::remove_all(dir_);
+    }
+    fc::create_directories(dir_);
+    thread_pool_.emplace(threads_);
+}
+
+token_database_bulk_loader_impl::~token_database_bulk_loader_impl() {
+    if(thread_pool_) {
+        thread_pool_->join();
+        thread_pool_->stop();
+    }
+    if(!direct_ && fc::exists(dir_)) {
+        fc::remove_all(dir_);
+    }
+}
+
+void
+token_database_bulk_loader_impl::put(int column, std::string&& key, std::string&& value) {
+    if(direct_) {
+        auto status = db_.db_->Put(db_.write_opts_, handles_[column], key, value);
+        if(!status.ok()) {
+            FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
         }
-        else if(s.code() == rocksdb::Status::kNotFound) {
-            // remove value
-            batch.Delete(assets_handle_, k);
+        return;
+    }
+
+    auto& c = chunks_[column];
+    c.bytes += key.size() + value.size();
+    c.rows.emplace_back(std::move(key), std::move(value));
+
+    if(c.bytes >= kChunkSize) {
+        flush_chunk(column);
+    }
+}
+
+void
+token_database_bulk_loader_impl::flush_chunk(int column) {
+    auto& c = chunks_[column];
+    if(c.rows.empty()) {
+        return;
+    }
+
+    // limit chunks in flight, otherwise the whole input may be buffered in memory
+    while(pending_.size() >= threads_ * 2) {
+        wait_oldest();
+    }
+
+    auto path = (dir_ / fmt::format("{:06}.sst", next_file_++)).to_native_ansi_path();
+    pending_.emplace_back(column, async_thread_pool(*thread_pool_, [&opts = options_[column], path, c = std::move(c)]() mutable {
+        return write_file(opts, std::move(path), std::move(c));
+    }));
+    c = chunk();
+}
+
+void
+token_database_bulk_loader_impl::wait_oldest() {
+    auto& p = pending_.front();
+    files_[p.first].emplace_back(p.second.get());
+    pending_.pop_front();
+}
+
+token_database_bulk_loader_impl::sst_file
+token_database_bulk_loader_impl::write_file(const rocksdb::Options& options, std::string path, chunk&& c) {
+    std::sort(c.rows.begin(), c.rows.end(), [](auto& a, auto& b) { return a.first < b.first; });
+
+    auto writer = rocksdb::SstFileWriter(rocksdb::EnvOptions(), options);
+    auto status = writer.Open(path);
+    if(status.ok()) {
+        for(auto& r : c.rows) {
+            status = writer.Put(r.first, r.second);
+            if(!status.ok()) {
+                break;
+            }
         }
-        else {
-            FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", s.getState()));
+    }
+    if(status.ok()) {
+        status = writer.Finish();
+    }
+    if(!status.ok()) {
+        jmzk_THROW(token_database_rocksdb_exception, "Write sst file failed: ${err}", ("err", status.getState()));
+    }
+
+    return sst_file { std::move(path), std::move(c.rows.front().first), std::move(c.rows.back().first) };
+}
+
+void
+token_database_bulk_loader_impl::ingest(int column, std::vector<sst_file>& files) {
+    if(files.empty()) {
+        return;
+    }
+
+    auto opts       = rocksdb::IngestExternalFileOptions();
+    opts.move_files = true;
+
+    auto do_ingest = [&](const std::vector<std::string>& paths) {
+        auto status = db_.db_->IngestExternalFile(handles_[column], paths, opts);
+        if(!status.ok()) {
+            jmzk_THROW(token_database_rocksdb_exception, "Ingest sst files failed: ${err}", ("err", status.getState()));
         }
+    };
+
+    // files ingested in one call should not overlap with each other
+    std::sort(files.begin(), files.end(), [](auto& a, auto& b) { return a.smallest < b.smallest; });
+
+    auto paths   = std::vector<std::string>();
+    auto largest = (const std::string*)nullptr;
+    for(auto& f : files) {
+        if(largest && f.smallest <= *largest) {
+            do_ingest(paths);
+            paths.clear();
+        }
+        paths.emplace_back(f.path);
+        largest = &f.largest;
     }
-    auto sync_write_opts = write_opts_;
-    sync_write_opts.sync = true;
-    db_->Write(sync_write_opts, &batch);
+    do_ingest(paths);
+}
 
-    return count;
+void
+token_database_bulk_loader_impl::finish() {
+    if(direct_) {
+        return;
+    }
+
+    for(auto i = 0; i < kColumns; i++) {
+        flush_chunk(i);
+    }
+    while(!pending_.empty()) {
+        wait_oldest();
+    }
+    for(auto i = 0; i < kColumns; i++) {
+        ingest(i, files_[i]);
+        files_[i].clear();
+    }
+}
+
+std::unique_ptr<token_database_bulk_loader>
+token_database_impl::new_bulk_loader() {
+    jmzk_ASSERT(db_ != nullptr, token_database_exception, "Token database is not opened");
+    jmzk_ASSERT(savepoints_.empty(), token_database_exception, "Bulk loading is only allowed when there's no savepoint");
+
+    auto my = std::make_unique<token_database_bulk_loader_impl>(*this);
+    return std::unique_ptr<token_database_bulk_loader>(new token_database_bulk_loader(std::move(my)));
 }
 
 void
@@ -882,10 +1626,10 @@ token_database_impl::add_savepoint(int64_t seq) {
         }
     }
 
+    // writes of runtime savepoints are all kept in write caches
     savepoints_.push_back(savepoint(seq, kRuntime));
-    auto rt = new rt_group { .rb_snapshot = (const void*)db_->GetSnapshot(), .actions = {} }; 
-    SETPOINTER(void, savepoints_.back().node.group, rt);
 
+    tokens_write_cache_.add_savepoint(seq);
     assets_write_cache_.add_savepoint(seq);
 }
 
@@ -897,26 +1641,7 @@ token_database_impl::free_savepoint(internal::savepoint& sp) {
 
     switch(n.f.type) {
     case kRuntime: {
-        auto rt = GETPOINTER(rt_group, n.group);
-        for(auto& act : rt->actions) {
-            switch(act.get_data_type()) {
-            case kTokenKey:
-            case kTokenFullKey:
-            case kAssetKey: {
-                free(GETPOINTER(void, act.data));
-                break;
-            }
-            case kTokenKeys: {
-                auto p = GETPOINTER(rt_token_keys, act.data);
-                //need to call dtor of keys manually
-                p->keys.~token_keys_t();
-                free(p);
-                break;
-            }
-            }  // switch
-        }
-        db_->ReleaseSnapshot((const rocksdb::Snapshot*)rt->rb_snapshot);
-        delete rt;
+        // nothing allocated for runtime savepoint
         break;
     }
     case kPersist: {
@@ -937,21 +1662,29 @@ token_database_impl::free_all_savepoints() {
 
 void
 token_database_impl::pop_savepoints(int64_t until) {
+    // values of all the popped savepoints are irreversible now,
+    // pop them from write caches and persist into underlying db in one batch
+    auto batch = rocksdb::WriteBatch();
     while(!savepoints_.empty() && savepoints_.front().seq < until) {
         auto it = std::move(savepoints_.front());
         savepoints_.pop_front();
         free_savepoint(it);
 
-        // pop write cache and persist into underlying db
+        assert(tokens_write_cache_.ops_.front().seq == it.seq);
+        tokens_write_cache_.pop_front([&](auto& k, auto&& v) {
+            batch.Put(handles_[(int)token_type_of_key(k.data())], rocksdb::Slice(k.data(), k.size()), v);
+        });
+
         assert(assets_write_cache_.ops_.front().seq == it.seq);
-        auto batch = rocksdb::WriteBatch();
         assets_write_cache_.pop_front([&](auto& k, auto&& v) {
-            batch.Put(assets_handle_, rocksdb::Slice(k.data(), k.size()), v);
+            batch.Put(handles_[(int)token_type::asset], rocksdb::Slice(k.data(), k.size()), v);
         });
-        auto sync_write_opts = write_opts_;
-        sync_write_opts.sync = true;
-        db_->Write(sync_write_opts, &batch);
     }
+
+    if(batch.Count() == 0) {
+        return;
+    }
+    write_irreversible(batch);
 }
 
 void
@@ -962,6 +1695,7 @@ token_database_impl::pop_back_savepoint() {
     savepoints_.pop_back();
     free_savepoint(it);
 
+    tokens_write_cache_.pop_back();
     assets_write_cache_.pop_back();
 }
 
@@ -977,16 +1711,8 @@ token_database_impl::squash() {
     auto n2 = savepoints_.back().node;
     jmzk_ASSERT(n2.f.type == kRuntime, token_database_squash_exception, "Squash needs two realtime savepoints.");
 
-    auto rt1 = GETPOINTER(rt_group, n.group);
-    auto rt2 = GETPOINTER(rt_group, n2.group);
-
-    // add all actions from rt1 into end of rt2
-    rt2->actions.insert(rt2->actions.cend(), rt1->actions.cbegin(), rt1->actions.cend());
-
-    // just release rt1's snapshot
-    db_->ReleaseSnapshot((const rocksdb::Snapshot*)rt1->rb_snapshot);
-    delete rt1;
-
+    // runtime savepoints have nothing but the writes in write caches
+    tokens_write_cache_.squash();
     assets_write_cache_.squash();
 }
 
@@ -1005,163 +1731,6 @@ token_database_impl::new_savepoint_session_seq() const {
     return seq;
 }
 
-void
-token_database_impl::record(uint8_t action_type, uint8_t op, uint8_t data_type, void* data) {
-    using namespace internal;
-
-    if(!should_record()) {
-        return;
-    }
-    auto n = savepoints_.back().node;
-    assert(n.f.type == kRuntime);
-
-    GETPOINTER(rt_group, n.group)->actions.emplace_back(rt_action(action_type, op, data_type, data));
-}
-
-namespace internal {
-
-std::string
-get_sp_key(const rt_action& act) {
-    switch(act.get_data_type()) {
-    case kTokenKey: {
-        auto data = GETPOINTER(rt_token_key, act.data);
-        return db_token_key(action_key_prefixes[act.f.type], data->key).as_string();
-    }
-    case kTokenFullKey: {
-        auto data = GETPOINTER(rt_token_fullkey, act.data);
-        return db_token_key(data->prefix, data->key).as_string();
-    }
-    case kAssetKey: {
-        auto data = GETPOINTER(rt_asset_key, act.data);
-        return std::string(data->key, sizeof(data->key));
-    }
-    case kTokenKeys: {
-        assert(false);
-    }
-    }  // switch
-    return std::string();
-}
-
-}  // namespace internal
-
-void
-token_database_impl::rollback_rt_group(internal::rt_group* rt) {
-    using namespace internal;
-
-    if(rt->actions.empty()) {
-        db_->ReleaseSnapshot((const rocksdb::Snapshot*)rt->rb_snapshot);
-        return;
-    }
-
-    auto snapshot_read_opts_     = read_opts_;
-    snapshot_read_opts_.snapshot = (const rocksdb::Snapshot*)rt->rb_snapshot;
-
-    auto key_set = keys_hash_set();
-    auto batch   = rocksdb::WriteBatch();
-    
-    for(auto it = rt->actions.begin(); it < rt->actions.end(); it++) {
-        auto data = GETPOINTER(void, it->data);
-
-        auto fn = [&](auto& key, auto type, auto op) {
-            switch(op) {
-            case action_op::add: {
-                assert(key_set.find(key) == key_set.end());
-
-                batch.Delete(key);
-                self_.remove_token_value(key);
-            
-                // insert key into key set
-                key_set.insert(key);
-                break;
-            }
-            case action_op::update: {
-                // only update operation need to check if key is already processed
-                if(key_set.find(key) != key_set.end()) {
-                    break;
-                }
-                auto old_value = std::string();
-                auto status    = db_->Get(snapshot_read_opts_, key, &old_value);
-                if(!status.ok()) {
-                    FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
-                }
-                batch.Put(key, old_value);
-                self_.rollback_token_value(key);
-
-                // insert key into key set
-                key_set.insert(key);
-                break;
-            }
-            case action_op::put: {
-                // only update operation need to check if key is already processed
-                if(key_set.find(key) != key_set.end()) {
-                    break;
-                }
-
-                // Asset type only has put op
-                auto handle    = (type == token_type::asset) ? assets_handle_ : tokens_handle_;
-                auto old_value = std::string();
-                auto status    = db_->Get(snapshot_read_opts_, handle, key, &old_value);
-
-                // key may not existed in latest snapshot, remove it
-                if(!status.ok()) {
-                    if(status.code() != rocksdb::Status::kNotFound) {
-                        FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
-                    }
-                    batch.Delete(handle, key);
-                    if(handle == tokens_handle_) {
-                        self_.remove_token_value(key);
-                    }
-                }
-                else {
-                    batch.Put(handle, key, old_value);
-                    if(handle == tokens_handle_) {
-                        self_.rollback_token_value(key);
-                    }
-                }
-
-                // insert key into key set
-                key_set.insert(key);
-                break;
-            }
-            }  // switch
-        };
-
-        auto op         = it->get_action_op();
-        auto data_type  = it->get_data_type();
-        auto type       = it->get_token_type();
-
-        switch(data_type) {
-        case kTokenKey:
-        case kTokenFullKey:
-        case kAssetKey: {
-            auto key  = get_sp_key(*it);
-            fn(key, type, op);
-            break;
-        }
-        case kTokenKeys: {
-            auto  keys   = (rt_token_keys*)data;
-            auto& prefix = keys->prefix;
-            for(auto& k : keys->keys) {
-                auto key = db_token_key(prefix, k).as_string();
-                fn(key, type, op);
-            }
-
-            //need to call dtor of keys manually
-            keys->keys.~token_keys_t();
-            break;
-        }
-        }  // switch
-
-        free(data);
-    }  // for
-
-    auto sync_write_opts = write_opts_;
-    sync_write_opts.sync = true;
-    db_->Write(sync_write_opts, &batch);
-
-    db_->ReleaseSnapshot((const rocksdb::Snapshot*)rt->rb_snapshot);
-}
-
 void
 token_database_impl::rollback_pd_group(internal::pd_group* pd) {
     using namespace internal;
@@ -1170,26 +1739,25 @@ token_database_impl::rollback_pd_group(internal::pd_group* pd) {
         return;
     }
 
-    // keyset is not required here,
-    // because it has done during creating persist savepoint
-    // cache rollback is also no need here
+    // replay in reverse order, keys may be duplicated in the groups persisted by old versions
+    // cache rollback is no need here
     // because cache cannot have persist value objects
     auto batch = rocksdb::WriteBatch();
-    for(auto it = pd->actions.begin(); it < pd->actions.end(); it++) {
+    for(auto it = pd->actions.rbegin(); it != pd->actions.rend(); it++) {
+        auto handle = handles_[it->type];
         switch((action_op)it->op) {
         case action_op::add: {
             assert(it->value.empty());
-            batch.Delete(it->key);
+            batch.Delete(handle, it->key);
             break;
         }
         case action_op::update: {
             assert(!it->value.empty());
-            batch.Put(it->key, it->value);
+            batch.Put(handle, it->key, it->value);
             break;
         }
         case action_op::put: {
             // Asset type only has put op
-            auto handle = (it->type == (int)token_type::asset) ? assets_handle_ : tokens_handle_;
             if(it->value.empty()) {
                 batch.Delete(handle, it->key);
             }
@@ -1201,9 +1769,79 @@ token_database_impl::rollback_pd_group(internal::pd_group* pd) {
         }  // switch
     }
 
-    auto sync_write_opts = write_opts_;
-    sync_write_opts.sync = true;
-    db_->Write(sync_write_opts, &batch);
+    write_irreversible(batch);
+}
+
+void
+token_database_impl::write_irreversible(rocksdb::WriteBatch& batch) {
+    auto opts = write_opts_;
+    opts.sync = (config_.durability == durability_mode::sync_every_write);
+
+    auto status = db_->Write(opts, &batch);
+    if(!status.ok()) {
+        FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
+    }
+
+    irreversible_writes_.fetch_add(1, std::memory_order_relaxed);
+    if(!opts.sync) {
+        unsynced_writes_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void
+token_database_impl::start_flusher() {
+    if(config_.durability != durability_mode::group_commit) {
+        return;
+    }
+
+    flusher_stop_ = false;
+    flusher_ = std::thread([this] {
+        auto lock = std::unique_lock<std::mutex>(flusher_mutex_);
+        while(!flusher_stop_) {
+            flusher_cv_.wait_for(lock, std::chrono::milliseconds(config_.group_commit_ms));
+            if(flusher_stop_) {
+                break;
+            }
+
+            lock.unlock();
+            sync_wal();
+            lock.lock();
+        }
+    });
+}
+
+void
+token_database_impl::stop_flusher() {
+    if(flusher_.joinable()) {
+        {
+            auto lock = std::lock_guard<std::mutex>(flusher_mutex_);
+            flusher_stop_ = true;
+        }
+        flusher_cv_.notify_one();
+        flusher_.join();
+    }
+
+    // writes left by flusher or `wal_only` mode
+    sync_wal();
+}
+
+// all the writes made before calling are synced, the ones made during syncing may be synced too,
+// then they're counted again and synced next time
+void
+token_database_impl::sync_wal() {
+    auto n = unsynced_writes_.exchange(0, std::memory_order_relaxed);
+    if(n == 0) {
+        return;
+    }
+
+    auto status = db_->SyncWAL();
+    if(!status.ok()) {
+        // retry next time
+        unsynced_writes_.fetch_add(n, std::memory_order_relaxed);
+        elog("Sync WAL of token database failed: ${err}", ("err", status.getState()));
+        return;
+    }
+    wal_syncs_.fetch_add(1, std::memory_order_relaxed);
 }
 
 void
@@ -1216,10 +1854,7 @@ token_database_impl::rollback_to_latest_savepoint() {
 
     switch(n.f.type) {
     case kRuntime: {
-        auto rt = GETPOINTER(rt_group, n.group);
-        rollback_rt_group(rt);
-        delete rt;
-
+        // writes are only in write caches
         break;
     }
     case kPersist: {
@@ -1233,6 +1868,17 @@ token_database_impl::rollback_to_latest_savepoint() {
 
     savepoints_.pop_back();
 
+    assert(seq == tokens_write_cache_.ops_.back().seq);
+    tokens_write_cache_.rollback_to_latest_savepoint([this](auto& k, auto removed) {
+        auto key = rocksdb::Slice(k.data(), k.size());
+        if(removed) {
+            self_.remove_token_value(key);
+        }
+        else {
+            self_.rollback_token_value(key);
+        }
+    });
+
     assert(seq == assets_write_cache_.ops_.back().seq);
     assets_write_cache_.rollback_to_latest_savepoint();
 }
@@ -1258,6 +1904,7 @@ token_database_impl::persist_savepoints() const {
 
         persist_savepoints(fs);
         assets_write_cache_.persist_savepoints(fs);
+        tokens_write_cache_.persist_savepoints(fs);
 
         // clear dirty
         fs.seekp(0);
@@ -1285,11 +1932,21 @@ token_database_impl::load_savepoints() {
 
     // delete old savepoints if existed (from snapshot)
     savepoints_.clear();
+    tokens_write_cache_.clear();
     assets_write_cache_.clear();
 
     // load
     load_savepoints(fs);
     assets_write_cache_.load_savepoints(fs);
+    if(fs.peek() != std::fstream::traits_type::eof()) {
+        tokens_write_cache_.load_savepoints(fs);
+    }
+    else {
+        // tokens were written into db directly by old versions, only savepoints are needed
+        for(auto i = 0u; i < savepoints_.size(); i++) {
+            tokens_write_cache_.add_savepoint(savepoints_[i].seq);
+        }
+    }
 
     // close
     fs.close();
@@ -1317,90 +1974,7 @@ token_database_impl::persist_savepoints(std::ostream& os) const {
             break;
         }
         case kRuntime: {
-            auto rt = GETPOINTER(rt_group, n.group);
-
-            auto key_set = keys_hash_set();
-
-            auto snapshot_read_opts_     = read_opts_;
-            snapshot_read_opts_.snapshot = (const rocksdb::Snapshot*)rt->rb_snapshot;
-
-            for(auto& act : rt->actions) {
-                auto data = GETPOINTER(void, act.data);
-
-                auto fn = [&](const auto& key, auto type, auto op) {
-                    auto value = std::string();
-
-                    switch(op) {
-                    case action_op::add: {
-                        assert(key_set.find(key) == key_set.end());
-
-                        // no need to read value
-                        key_set.insert(key);
-                        break;
-                    }
-                    case action_op::update: {
-                        if(key_set.find(key) != key_set.end()) {
-                            break;
-                        }
-
-                        auto status = db_->Get(snapshot_read_opts_, key, &value);
-                        if(!status.ok()) {
-                            FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
-                        }
-
-                        key_set.insert(key);
-                        break;
-                    }
-                    case action_op::put: {
-                        if(key_set.find(key) != key_set.end()) {
-                            break;
-                        }
-
-                        auto handle = (type == token_type::asset) ? assets_handle_ : tokens_handle_;
-                        auto status = db_->Get(snapshot_read_opts_, handle, key, &value);
-                        
-                        // key may not existed in latest snapshot
-                        if(!status.ok() && status.code() != rocksdb::Status::kNotFound) {
-                            FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
-                        }
-
-                        key_set.insert(key);
-                        break;
-                    }
-                    }  // switch
-
-                    return value;
-                };
-
-                auto op         = act.get_action_op();
-                auto data_type  = act.get_data_type();
-                auto type       = act.get_token_type();
-
-                auto pdact = pd_action();
-                pdact.op   = (int)op;
-                pdact.type = (int)type;
-
-                switch(data_type) {
-                case kTokenKey:
-                case kTokenFullKey:
-                case kAssetKey: {
-                    pdact.key   = get_sp_key(act);
-                    pdact.value = fn(pdact.key, type, op);
-                    pd.actions.emplace_back(std::move(pdact));
-                    break;
-                }
-                case kTokenKeys: {
-                    auto  keys   = (rt_token_keys*)data;
-                    auto& prefix = keys->prefix;
-                    for(auto& k : keys->keys) {
-                        pdact.key   = db_token_key(prefix, k).as_string();
-                        pdact.value = fn(pdact.key, type, op);
-                        pd.actions.emplace_back(pdact);
-                    }
-                    break;
-                }
-                }  // switch
-            }  // for
+            // writes are persisted together with write caches
             break;
         }
         }  // switch
@@ -1430,11 +2004,53 @@ token_database_impl::load_savepoints(std::istream& is) {
     }
 }
 
+std::string
+token_database_impl::stats() const {
+    auto& ts = tokens_write_cache_.stats();
+    auto& as = assets_write_cache_.stats();
+    auto durability = "sync-every-write";
+    if(config_.durability == durability_mode::group_commit) {
+        durability = "group-commit";
+    }
+    else if(config_.durability == durability_mode::wal_only) {
+        durability = "wal-only";
+    }
+
+    return fmt::format("\n** Savepoints **\nsavepoints: {}\n"
+        "tokens arena allocs: {}, bytes: {}, releases: {}\n"
+        "assets arena allocs: {}, bytes: {}, releases: {}\n"
+        "\n** Durability **\nmode: {}, irreversible writes: {}, wal syncs: {}, unsynced writes: {}\n",
+        savepoints_.size(),
+        ts.allocs, ts.alloc_bytes, ts.releases,
+        as.allocs, as.alloc_bytes, as.releases,
+        durability, irreversible_writes_.load(), wal_syncs_.load(), unsynced_writes_.load()) + column_stats();
+}
+
+std::string
+token_database_impl::column_stats() const {
+    using namespace internal;
+
+    auto s = std::string("\n** Column Families **\n");
+    for(auto i = 0; i < kColumns; i++) {
+        auto& t    = column_tunings[i];
+        auto  keys = uint64_t(0);
+        auto  size = uint64_t(0);
+        db_->GetIntProperty(handles_[i], "rocksdb.estimate-num-keys", &keys);
+        db_->GetIntProperty(handles_[i], "rocksdb.total-sst-files-size", &size);
+
+        s.append(fmt::format("{}: pattern: {}, block size: {}, bloom bits: {}, keys: ~{}, sst size: {}\n",
+            t.name, access_pattern_names[t.pattern], t.block_size, t.bloom_bits, keys, size));
+    }
+    return s;
+}
+
 void
 token_database_impl::flush() const {
-    auto status = db_->Flush(rocksdb::FlushOptions());
-    if(!status.ok()) {
-        FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
+    for(auto h : handles_) {
+        auto status = db_->Flush(rocksdb::FlushOptions(), h);
+        if(!status.ok()) {
+            FC_THROW_EXCEPTION(fc::unrecoverable_exception, "Rocksdb internal error: ${err}", ("err", status.getState()));
+        }
     }
 }
 
@@ -1491,7 +2107,7 @@ token_database::exists_token(token_type type, const std::optional<name128>& doma
     assert(type != token_type::asset);
     assert((type == token_type::token) != (!domain.has_value()));
     auto& prefix = domain.has_value() ? *domain : action_key_prefixes[(int)type];
-    return my_->exists_token(prefix, key);
+    return my_->exists_token(type, prefix, key);
 }
 
 int
@@ -1506,7 +2122,7 @@ token_database::read_token(token_type type, const std::optional<name128>& domain
     assert(type != token_type::asset);
     assert((type == token_type::token) != (!domain.has_value()));
     auto& prefix = domain.has_value() ? *domain : action_key_prefixes[(int)type];
-    return my_->read_token(prefix, key, out, no_throw);
+    return my_->read_token(type, prefix, key, out, no_throw);
 }
 
 int
@@ -1521,7 +2137,7 @@ token_database::read_tokens_range(token_type type, const std::optional<name128>&
     assert(type != token_type::asset);
     assert((type == token_type::token) != (!domain.has_value()));
     auto& prefix = domain.has_value() ? *domain : action_key_prefixes[(int)type];
-    return my_->read_tokens_range(prefix, skip, func);
+    return my_->read_tokens_range(type, prefix, skip, func);
 }
 
 int
@@ -1577,13 +2193,30 @@ token_database::latest_savepoint_seq() const {
     return my_->latest_savepoint_seq();
 }
 
+token_database_view_ptr
+token_database::new_view() const {
+    return my_->new_view(std::numeric_limits<int64_t>::max());
+}
+
+token_database_view_ptr
+token_database::new_view(int64_t seq) const {
+    return my_->new_view(seq);
+}
+
+std::unique_ptr<token_database_bulk_loader>
+token_database::new_bulk_loader() {
+    return my_->new_bulk_loader();
+}
+
 std::string
 token_database::stats() const {
     auto s = std::string();
-    if(my_->db_->GetProperty(rocksdb::DB::Properties::kStats, &s)) {
-        return s;
+    if(!my_->db_->GetProperty(rocksdb::DB::Properties::kStats, &s)) {
+        s = "NA";
     }
-    return "NA";
+    s.append(my_->stats());
+    collect_stats(s);
+    return s;
 }
 
 void
@@ -1601,13 +2234,79 @@ token_database::load_savepoints(std::istream& is) {
     my_->load_savepoints(is);
 }
 
-std::string
-token_database::get_db_key(token_type type, const std::optional<name128>& domain, const name128& key) {
+const name128&
+token_database::get_db_prefix(token_type type, const std::optional<name128>& domain) const {
+    using namespace internal;
+    return domain.has_value() ? *domain : action_key_prefixes[(int)type];
+}
+
+token_database_view::token_database_view(std::unique_ptr<token_database_view_impl>&& my)
+    : my_(std::move(my)) {}
+
+token_database_view::~token_database_view() = default;
+
+int
+token_database_view::exists_token(token_type type, const std::optional<name128>& domain, const name128& key) const {
+    using namespace internal;
+
+    assert(type != token_type::asset);
+    auto& prefix = domain.has_value() ? *domain : action_key_prefixes[(int)type];
+    return my_->exists_token(type, prefix, key);
+}
+
+int
+token_database_view::read_token(token_type type, const std::optional<name128>& domain, const name128& key, std::string& out, bool no_throw) const {
+    using namespace internal;
+
+    assert(type != token_type::asset);
+    auto& prefix = domain.has_value() ? *domain : action_key_prefixes[(int)type];
+    return my_->read_token(type, prefix, key, out, no_throw);
+}
+
+int
+token_database_view::read_asset(const address& addr, const symbol_id_type sym_id, std::string& out, bool no_throw) const {
+    return my_->read_asset(addr, sym_id, out, no_throw);
+}
+
+int
+token_database_view::read_tokens_range(token_type type, const std::optional<name128>& domain, int skip, const read_value_func& func) const {
+    using namespace internal;
+
+    assert(type != token_type::asset);
+    auto& prefix = domain.has_value() ? *domain : action_key_prefixes[(int)type];
+    return my_->read_tokens_range(type, prefix, skip, func);
+}
+
+int
+token_database_view::read_assets_range(const symbol_id_type sym_id, int skip, const read_value_func& func) const {
+    return my_->read_assets_range(sym_id, skip, func);
+}
+
+token_database_bulk_loader::token_database_bulk_loader(std::unique_ptr<token_database_bulk_loader_impl>&& my)
+    : my_(std::move(my)) {}
+
+token_database_bulk_loader::~token_database_bulk_loader() = default;
+
+void
+token_database_bulk_loader::put_token(token_type type, const std::optional<name128>& domain, const name128& key, std::string&& data) {
     using namespace internal;
 
+    assert(type != token_type::asset);
+    assert((type == token_type::token) != (!domain.has_value()));
     auto& prefix = domain.has_value() ? *domain : action_key_prefixes[(int)type];
-    auto  dkey   = db_token_key(prefix, key);
-    return dkey.as_string();
+    my_->put((int)type, db_token_key(prefix, key).as_string(), std::move(data));
+}
+
+void
+token_database_bulk_loader::put_asset(const address& addr, const symbol_id_type sym_id, std::string&& data) {
+    using namespace internal;
+
+    my_->put((int)token_type::asset, db_asset_key(addr, sym_id).as_string(), std::move(data));
+}
+
+void
+token_database_bulk_loader::finish() {
+    my_->finish();
 }
 
 }}  // namespace jmzk::chain
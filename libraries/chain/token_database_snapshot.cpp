@@ -1,10 +1,17 @@
 #include <jmzk/chain/token_database_snapshot.hpp>
 
 #include <string.h>
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <thread>
 #include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/asio/thread_pool.hpp>
 #include <fmt/format.h>
 #include <rocksdb/db.h>
 #include <jmzk/chain/token_database.hpp>
+#include <jmzk/chain/thread_utils.hpp>
 
 namespace jmzk { namespace chain {
 
@@ -28,9 +35,67 @@ const char* section_names[] = {
     ".script"
 };
 
+/**
+ * Builds sections on worker threads, each of them is scanned from the shared view and then prepared
+ * (compressed) by the writer. Sections are still written to the writer in the order they are added,
+ * and at most `threads * 2` of them are kept in memory at the same time.
+ */
+class parallel_section_writer : boost::noncopyable {
+public:
+    parallel_section_writer(snapshot_writer_ptr writer)
+        : writer_(writer)
+        , threads_(std::max(std::thread::hardware_concurrency(), 1u))
+        , thread_pool_(threads_) {}
+
+    ~parallel_section_writer() {
+        thread_pool_.join();
+        thread_pool_.stop();
+    }
+
+public:
+    template<typename F>
+    void
+    add_section(std::string name, F&& f) {
+        while(pending_.size() >= threads_ * 2) {
+            write_oldest();
+        }
+
+        pending_.emplace_back(async_thread_pool(thread_pool_, [this, name = std::move(name), f = std::forward<F>(f)]() mutable {
+            auto data = snapshot_section_data();
+            data.name = std::move(name);
+            f(data);
+
+            writer_->prepare_section_data(data);
+            return data;
+        }));
+    }
+
+    void
+    flush() {
+        while(!pending_.empty()) {
+            write_oldest();
+        }
+    }
+
+private:
+    void
+    write_oldest() {
+        auto data = pending_.front().get();
+        pending_.pop_front();
+
+        writer_->write_section_data(data);
+    }
+
+private:
+    snapshot_writer_ptr                            writer_;
+    size_t                                         threads_;
+    boost::asio::thread_pool                       thread_pool_;
+    std::deque<std::future<snapshot_section_data>> pending_;
+};
+
 void
-add_reserved_tokens(snapshot_writer_ptr          writer, 
-                    const token_database&        db, 
+add_reserved_tokens(parallel_section_writer&     writer,
+                    const token_database_view&   view,
                     std::vector<domain_name>&    domains,
                     std::vector<symbol_id_type>& symbol_ids) {
     static_assert(sizeof(section_names) / sizeof(char*) == (int)token_type::max_value + 1);
@@ -39,8 +104,9 @@ add_reserved_tokens(snapshot_writer_ptr          writer,
         if(i == (int)token_type::asset || i == (int)token_type::token) {
             continue;
         }
-        writer->write_section(section_names[i], [&](auto& w) {
-            db.read_tokens_range((token_type)i, std::nullopt, 0, [&](auto& key, auto&& v) {
+        // only one section fills `domains` or `symbol_ids`, and they're read after flushing
+        writer.add_section(section_names[i], [&, i](auto& w) {
+            view.read_tokens_range((token_type)i, std::nullopt, 0, [&](auto& key, auto&& v) {
                 assert(key.size() == sizeof(name128));
 
                 w.add_row(key.data(), key.size());
@@ -63,13 +129,14 @@ add_reserved_tokens(snapshot_writer_ptr          writer,
             });
         });
     }
+    writer.flush();
 }
 
 void
-add_tokens(snapshot_writer_ptr writer, const token_database& db, const std::vector<domain_name> domains) {
+add_tokens(parallel_section_writer& writer, const token_database_view& view, const std::vector<domain_name>& domains) {
     for(auto& d : domains) {
-        writer->write_section(d.to_string(), [&](auto& w) {
-            db.read_tokens_range(token_type::token, d, 0, [&w](auto& key, auto&& v) {
+        writer.add_section(d.to_string(), [&view, &d](auto& w) {
+            view.read_tokens_range(token_type::token, d, 0, [&w](auto& key, auto&& v) {
                 w.add_row(key.data(), key.size());
                 w.add_row(v);
 
@@ -80,11 +147,11 @@ add_tokens(snapshot_writer_ptr writer, const token_database& db, const std::vect
 }
 
 void
-add_assets(snapshot_writer_ptr writer, const token_database& db, const std::vector<symbol_id_type>& symbol_ids) {
+add_assets(parallel_section_writer& writer, const token_database_view& view, const std::vector<symbol_id_type>& symbol_ids) {
     for(auto& id : symbol_ids) {
         auto sn = fmt::format(".asset-{}", id);
-        writer->write_section(sn, [&](auto& w) {
-            db.read_assets_range(id, 0, [&w](auto& key, auto&& v) {
+        writer.add_section(std::move(sn), [&view, id](auto& w) {
+            view.read_assets_range(id, 0, [&w](auto& key, auto&& v) {
                 assert(key.size() == sizeof(fc::ecc::public_key_shim));
                 w.add_row(key.data(), key.size());
                 w.add_row(v);
@@ -97,7 +164,7 @@ add_assets(snapshot_writer_ptr writer, const token_database& db, const std::vect
 
 void
 read_reserved_tokens(snapshot_reader_ptr          reader,
-                     token_database&              db,
+                     token_database_bulk_loader&  loader,
                      std::vector<domain_name>&    domains,
                      std::vector<symbol_id_type>& symbol_ids) {
     for(auto i = (int)token_type::domain; i <= (int)token_type::max_value; i++) {
@@ -113,7 +180,7 @@ read_reserved_tokens(snapshot_reader_ptr          reader,
                 r.read_row((char*)&k, sizeof(k));
                 r.read_row(v);
 
-                db.put_token((token_type)i, action_op::put, std::nullopt, k, std::string_view(v.data(), v.size()));
+                loader.put_token((token_type)i, std::nullopt, k, std::move(v));
 
                 if(i == (int)token_type::domain) {
                     domains.emplace_back(k);
@@ -127,7 +194,7 @@ read_reserved_tokens(snapshot_reader_ptr          reader,
 }
 
 void
-read_tokens(snapshot_reader_ptr reader, token_database& db, const std::vector<domain_name>& domains) {
+read_tokens(snapshot_reader_ptr reader, token_database_bulk_loader& loader, const std::vector<domain_name>& domains) {
     for(auto& d : domains) {
         reader->read_section(d.to_string(), [&](auto& r) {
             while(!r.eof()) {
@@ -137,14 +204,14 @@ read_tokens(snapshot_reader_ptr reader, token_database& db, const std::vector<do
                 r.read_row((char*)&k, sizeof(k));
                 r.read_row(v);
 
-                db.put_token(token_type::token, action_op::put, d, k, std::string_view(v.data(), v.size()));
+                loader.put_token(token_type::token, d, k, std::move(v));
             }
         });
     }
 }
 
 void
-read_assets(snapshot_reader_ptr reader, token_database& db, const std::vector<symbol_id_type>& symbol_ids) {
+read_assets(snapshot_reader_ptr reader, token_database_bulk_loader& loader, const std::vector<symbol_id_type>& symbol_ids) {
     for(auto& id : symbol_ids) {
         auto sn = fmt::format(".asset-{}", id);
         reader->read_section(sn, [&](auto& r) {
@@ -156,7 +223,7 @@ read_assets(snapshot_reader_ptr reader, token_database& db, const std::vector<sy
                 r.read_row(v);
 
                 auto addr = address(public_key_type(k));
-                db.put_asset(addr, id, std::string_view(v.data(), v.size()));
+                loader.put_asset(addr, id, std::move(v));
             }
         });
     }
@@ -172,9 +239,15 @@ token_database_snapshot::add_to_snapshot(snapshot_writer_ptr writer, const token
         auto domains    = std::vector<domain_name>();
         auto symbol_ids = std::vector<symbol_id_type>();
 
-        add_reserved_tokens(writer, db, domains, symbol_ids);
-        add_tokens(writer, db, domains);
-        add_assets(writer, db, symbol_ids);
+        // all the sections are read from one pinned view, so they're consistent with each other
+        auto view = db.new_view();
+        auto pw   = parallel_section_writer(writer);
+
+        add_reserved_tokens(pw, *view, domains, symbol_ids);
+        add_tokens(pw, *view, domains);
+        add_assets(pw, *view, symbol_ids);
+
+        pw.flush();
     }
     jmzk_CAPTURE_AND_RETHROW(token_database_snapshot_exception);
 }
@@ -193,9 +266,15 @@ token_database_snapshot::read_from_snapshot(snapshot_reader_ptr reader, token_da
         auto domains    = std::vector<domain_name>();
         auto symbol_ids = std::vector<symbol_id_type>();
 
-        read_reserved_tokens(reader, db, domains, symbol_ids);
-        read_tokens(reader, db, domains);
-        read_assets(reader, db, symbol_ids);        
+        // rows are written into sorted files on worker threads while reading sections,
+        // and ingested into database at once in the end
+        auto loader = db.new_bulk_loader();
+
+        read_reserved_tokens(reader, *loader, domains, symbol_ids);
+        read_tokens(reader, *loader, domains);
+        read_assets(reader, *loader, symbol_ids);
+
+        loader->finish();
     }
     jmzk_CAPTURE_AND_RETHROW(token_database_snapshot_exception);
 }
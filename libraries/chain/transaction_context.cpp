@@ -127,6 +127,8 @@ transaction_context::finalize() {
         finalize_pay();
     }
 
+    commit_global_sequence();
+
     trace->charge  = charge;
     trace->elapsed = fc::time_point::now() - start;
 }
@@ -273,6 +275,29 @@ transaction_context::finalize_pay() {
     assert(at.generated_actions.empty());
 }
 
+uint64_t
+transaction_context::next_global_sequence() {
+    if(!has_global_sequence) {
+        global_sequence     = control.get_dynamic_global_properties().global_action_sequence;
+        has_global_sequence = true;
+    }
+    return ++global_sequence;
+}
+
+void
+transaction_context::commit_global_sequence() {
+    if(!has_global_sequence) {
+        return;
+    }
+
+    // one modify (and one undo record) for all the actions executed since last commit
+    auto& db = control.db();
+    db.modify(control.get_dynamic_global_properties(), [&](auto& dgp) {
+        dgp.global_action_sequence = global_sequence;
+    });
+    has_global_sequence = false;
+}
+
 void
 transaction_context::check_net_usage() const {
     if(!control.skip_trx_checks()) {
@@ -19,13 +19,13 @@ public:
     void
     push_back(const T& item) {
         buf_[tail_] = item;
+        advance_tail();
+    }
 
-        if(++tail_ >= capacity_) {
-            tail_ = 0;
-        }
-        if(head_ == tail_) {
-            expand();
-        }
+    void
+    push_back(T&& item) {
+        buf_[tail_] = std::move(item);
+        advance_tail();
     }
 
     void
@@ -101,12 +101,22 @@ public:
     }
 
 private:
+    void
+    advance_tail() {
+        if(++tail_ >= capacity_) {
+            tail_ = 0;
+        }
+        if(head_ == tail_) {
+            expand();
+        }
+    }
+
     void
     expand() {
         auto new_vec = std::vector<T>();
         new_vec.resize(capacity_ * 2);
         for(auto i = 0u; i < capacity_; i++) {
-            new_vec[i] = buf_[(head_ + i) % capacity_];
+            new_vec[i] = std::move(buf_[(head_ + i) % capacity_]);
         }
 
         head_      = 0;
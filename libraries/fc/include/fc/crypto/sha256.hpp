@@ -24,6 +24,12 @@ public:
     static sha256 hash(const string&);
     static sha256 hash(const sha256&);
 
+    /**
+     * Hashes `n` messages of exactly 64 bytes each, which are stored continuously in `in`.
+     * Uses SHA extensions or AVX2 when CPU supports them. `out` can be the same as `in`.
+     */
+    static void hash64_batch(const char* in, size_t n, sha256* out);
+
     template<typename T>
     static sha256 hash(const T& t) {
         sha256::encoder e;
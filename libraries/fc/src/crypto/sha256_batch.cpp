@@ -0,0 +1,347 @@
+#include <fc/crypto/sha256.hpp>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FC_SHA256_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace fc {
+
+namespace detail { namespace sha256_batch {
+
+/**
+ * Multi-buffer sha256 for messages of exactly 64 bytes, which is what hashing a pair of digests
+ * (merkle tree nodes) needs. Every message takes two blocks: the message itself and a fixed padding block.
+ * The implementation is chosen once at runtime by the features of CPU:
+ *   - SHA extensions: hashes two messages at a time by the dedicated instructions
+ *   - AVX2: hashes 8 messages at the same time, one lane for each
+ *   - portable code otherwise
+ */
+
+alignas(16) static const uint32_t K256[] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static const uint32_t H256[] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+// second block of every 64 bytes message: 0x80, zeros and then the length in bits (512)
+alignas(16) static const uint8_t padding_block[64] = {
+    0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x02, 0x00
+};
+
+inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+// padding block is the same for all the messages, so are its message schedule plus round constants
+struct padding_schedule {
+    padding_schedule() {
+        uint32_t w[64];
+        for(auto i = 0; i < 16; i++) {
+            w[i] = ((uint32_t)padding_block[i * 4] << 24) | ((uint32_t)padding_block[i * 4 + 1] << 16)
+                 | ((uint32_t)padding_block[i * 4 + 2] << 8) | (uint32_t)padding_block[i * 4 + 3];
+        }
+        for(auto i = 16; i < 64; i++) {
+            auto s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            auto s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        for(auto i = 0; i < 64; i++) {
+            wk[i] = w[i] + K256[i];
+        }
+    }
+
+    alignas(16) uint32_t wk[64];
+};
+
+static const padding_schedule padding;
+
+inline uint32_t
+load_be32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap32(v);
+}
+
+inline void
+store_be32(uint8_t* p, uint32_t v) {
+    v = __builtin_bswap32(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+// `wk` is the message schedule plus round constants
+void
+rounds_scalar(uint32_t state[8], const uint32_t wk[64]) {
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for(auto i = 0; i < 64; i++) {
+        auto t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + wk[i];
+        auto t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void
+compress_scalar(uint32_t state[8], const uint8_t* block) {
+    uint32_t w[64];
+    for(auto i = 0; i < 16; i++) {
+        w[i] = load_be32(block + i * 4);
+    }
+    for(auto i = 16; i < 64; i++) {
+        auto s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        auto s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    for(auto i = 0; i < 64; i++) {
+        w[i] += K256[i];
+    }
+    rounds_scalar(state, w);
+}
+
+void
+hash64_scalar(const uint8_t* in, size_t n, uint8_t* out) {
+    for(auto i = 0u; i < n; i++) {
+        uint32_t state[8];
+        memcpy(state, H256, sizeof(state));
+
+        compress_scalar(state, in + i * 64);
+        rounds_scalar(state, padding.wk);
+        for(auto j = 0; j < 8; j++) {
+            store_be32(out + i * 32 + j * 4, state[j]);
+        }
+    }
+}
+
+#ifdef FC_SHA256_X86
+
+// hashes N messages together to hide the latency of sha instructions
+template<size_t N>
+__attribute__((target("sha,sse4.1")))
+inline void
+hash64_shani_n(const uint8_t* in, uint8_t* out, __m128i iabef, __m128i icdgh) {
+    const auto mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i state0[N], state1[N], msgs[N][4];
+    for(auto l = 0u; l < N; l++) {
+        state0[l] = iabef;
+        state1[l] = icdgh;
+    }
+
+    // message block
+#pragma GCC unroll 16
+    for(auto k = 0; k < 16; k++) {
+        auto t = _mm_load_si128((const __m128i*)&K256[k * 4]);
+        for(auto l = 0u; l < N; l++) {
+            auto& w = msgs[l];
+            if(k < 4) {
+                w[k] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + l * 64 + k * 16)), mask);
+            }
+            else {
+                // W[t] = s1(W[t-2]) + W[t-7] + s0(W[t-15]) + W[t-16], four words at a time
+                auto m = _mm_sha256msg1_epu32(w[k & 3], w[(k - 3) & 3]);
+                m = _mm_add_epi32(m, _mm_alignr_epi8(w[(k - 1) & 3], w[(k - 2) & 3], 4));
+                w[k & 3] = _mm_sha256msg2_epu32(m, w[(k - 1) & 3]);
+            }
+
+            auto wk   = _mm_add_epi32(w[k & 3], t);
+            state1[l] = _mm_sha256rnds2_epu32(state1[l], state0[l], wk);
+            state0[l] = _mm_sha256rnds2_epu32(state0[l], state1[l], _mm_shuffle_epi32(wk, 0x0E));
+        }
+    }
+
+    __m128i abef[N], cdgh[N];
+    for(auto l = 0u; l < N; l++) {
+        state0[l] = abef[l] = _mm_add_epi32(state0[l], iabef);
+        state1[l] = cdgh[l] = _mm_add_epi32(state1[l], icdgh);
+    }
+
+    // padding block, schedule is precomputed
+#pragma GCC unroll 16
+    for(auto k = 0; k < 16; k++) {
+        auto wk = _mm_load_si128((const __m128i*)&padding.wk[k * 4]);
+        auto wh = _mm_shuffle_epi32(wk, 0x0E);
+        for(auto l = 0u; l < N; l++) {
+            state1[l] = _mm_sha256rnds2_epu32(state1[l], state0[l], wk);
+            state0[l] = _mm_sha256rnds2_epu32(state0[l], state1[l], wh);
+        }
+    }
+
+    // all the inputs are consumed, outputs can overlap them now
+    for(auto l = 0u; l < N; l++) {
+        auto s0 = _mm_add_epi32(state0[l], abef[l]);
+        auto s1 = _mm_add_epi32(state1[l], cdgh[l]);
+
+        auto feba = _mm_shuffle_epi32(s0, 0x1B);
+        auto dchg = _mm_shuffle_epi32(s1, 0xB1);
+        s0 = _mm_blend_epi16(feba, dchg, 0xF0);  // DCBA
+        s1 = _mm_alignr_epi8(dchg, feba, 8);     // HGFE
+
+        _mm_storeu_si128((__m128i*)(out + l * 32), _mm_shuffle_epi8(s0, mask));
+        _mm_storeu_si128((__m128i*)(out + l * 32 + 16), _mm_shuffle_epi8(s1, mask));
+    }
+}
+
+__attribute__((target("sha,sse4.1")))
+void
+hash64_shani(const uint8_t* in, size_t n, uint8_t* out) {
+    // instructions work on state as ABEF and CDGH
+    auto cdab  = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&H256[0]), 0xB1);
+    auto efgh  = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&H256[4]), 0x1B);
+    auto iabef = _mm_alignr_epi8(cdab, efgh, 8);
+    auto icdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+    auto i = size_t(0);
+    for(; i + 2 <= n; i += 2) {
+        hash64_shani_n<2>(in + i * 64, out + i * 32, iabef, icdgh);
+    }
+    if(i < n) {
+        hash64_shani_n<1>(in + i * 64, out + i * 32, iabef, icdgh);
+    }
+}
+
+#define ROTR8(x, n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+
+// transposes 8x8 matrix of 32 bits words
+__attribute__((target("avx2")))
+inline void
+transpose_avx2(__m256i r[8]) {
+    __m256i t[8], u[8];
+    for(auto i = 0; i < 8; i += 2) {
+        t[i]     = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+    }
+    for(auto i = 0; i < 8; i += 4) {
+        u[i]     = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+        u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+        u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+        u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+    for(auto i = 0; i < 4; i++) {
+        r[i]     = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+        r[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+    }
+}
+
+// `wk` is the message schedule plus round constants, one lane for each message
+__attribute__((target("avx2")))
+inline void
+rounds_avx2(__m256i state[8], const __m256i wk[64]) {
+    auto a = state[0], b = state[1], c = state[2], d = state[3];
+    auto e = state[4], f = state[5], g = state[6], h = state[7];
+    for(auto i = 0; i < 64; i++) {
+        auto S1 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(e, 6), ROTR8(e, 11)), ROTR8(e, 25));
+        auto ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        auto t1 = _mm256_add_epi32(_mm256_add_epi32(h, S1), _mm256_add_epi32(ch, wk[i]));
+        auto S0 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(a, 2), ROTR8(a, 13)), ROTR8(a, 22));
+        auto mj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        auto t2 = _mm256_add_epi32(S0, mj);
+
+        h = g; g = f; f = e; e = _mm256_add_epi32(d, t1);
+        d = c; c = b; b = a; a = _mm256_add_epi32(t1, t2);
+    }
+
+    state[0] = _mm256_add_epi32(state[0], a); state[1] = _mm256_add_epi32(state[1], b);
+    state[2] = _mm256_add_epi32(state[2], c); state[3] = _mm256_add_epi32(state[3], d);
+    state[4] = _mm256_add_epi32(state[4], e); state[5] = _mm256_add_epi32(state[5], f);
+    state[6] = _mm256_add_epi32(state[6], g); state[7] = _mm256_add_epi32(state[7], h);
+}
+
+__attribute__((target("avx2")))
+void
+hash64_avx2(const uint8_t* in, size_t n, uint8_t* out) {
+    const auto bswap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                       12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+    __m256i pwk[64];
+    for(auto i = 0; i < 64; i++) {
+        pwk[i] = _mm256_set1_epi32(padding.wk[i]);
+    }
+
+    auto i = size_t(0);
+    for(; i + 8 <= n; i += 8) {
+        // load words 0-7 and 8-15 of 8 messages, and turn them into one word of all the messages each
+        __m256i w[64];
+        for(auto half = 0; half < 2; half++) {
+            auto r = &w[half * 8];
+            for(auto l = 0; l < 8; l++) {
+                r[l] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(in + (i + l) * 64 + half * 32)), bswap);
+            }
+            transpose_avx2(r);
+        }
+        for(auto j = 16; j < 64; j++) {
+            auto s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(w[j - 15], 7), ROTR8(w[j - 15], 18)), _mm256_srli_epi32(w[j - 15], 3));
+            auto s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR8(w[j - 2], 17), ROTR8(w[j - 2], 19)), _mm256_srli_epi32(w[j - 2], 10));
+            w[j] = _mm256_add_epi32(_mm256_add_epi32(w[j - 16], s0), _mm256_add_epi32(w[j - 7], s1));
+        }
+        for(auto j = 0; j < 64; j++) {
+            w[j] = _mm256_add_epi32(w[j], _mm256_set1_epi32(K256[j]));
+        }
+
+        __m256i state[8];
+        for(auto j = 0; j < 8; j++) {
+            state[j] = _mm256_set1_epi32(H256[j]);
+        }
+        rounds_avx2(state, w);
+        rounds_avx2(state, pwk);
+
+        // all the inputs are consumed, outputs can overlap them now
+        transpose_avx2(state);
+        for(auto l = 0; l < 8; l++) {
+            _mm256_storeu_si256((__m256i*)(out + (i + l) * 32), _mm256_shuffle_epi8(state[l], bswap));
+        }
+    }
+
+    // less than 8 messages left
+    hash64_scalar(in + i * 64, n - i, out + i * 32);
+}
+
+#undef ROTR8
+
+#endif  // FC_SHA256_X86
+
+using hash64_func = void (*)(const uint8_t*, size_t, uint8_t*);
+
+hash64_func
+select_hash64() {
+#ifdef FC_SHA256_X86
+    __builtin_cpu_init();
+
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if(__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA) && __builtin_cpu_supports("sse4.1")) {
+        return hash64_shani;
+    }
+    if(__builtin_cpu_supports("avx2")) {
+        return hash64_avx2;
+    }
+#endif
+    return hash64_scalar;
+}
+
+}}  // namespace detail::sha256_batch
+
+void
+sha256::hash64_batch(const char* in, size_t n, sha256* out) {
+    static_assert(sizeof(sha256) == 32, "sha256 should be exactly 32 bytes");
+
+    static const auto func = detail::sha256_batch::select_hash64();
+    func((const uint8_t*)in, n, (uint8_t*)out);
+}
+
+}  // namespace fc
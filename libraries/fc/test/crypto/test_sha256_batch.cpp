@@ -0,0 +1,36 @@
+#define BOOST_TEST_MODULE sha256 batch test
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/exception/exception.hpp>
+
+#include <vector>
+
+using namespace fc;
+
+BOOST_AUTO_TEST_SUITE(sha256_batch)
+BOOST_AUTO_TEST_CASE(test_hash64_batch) try {
+   // cover all the lanes and the remaining messages of every implementation
+   for(auto n : { 0, 1, 2, 3, 7, 8, 9, 16, 17, 100 }) {
+      auto in = std::vector<char>(n * 64);
+      for(auto i = 0u; i < in.size(); i++) {
+         in[i] = (char)(i * 131 + n);
+      }
+
+      auto out = std::vector<sha256>(n);
+      sha256::hash64_batch(in.data(), n, out.data());
+      for(auto i = 0; i < n; i++) {
+         BOOST_CHECK_EQUAL(out[i].str(), sha256::hash(in.data() + i * 64, 64).str());
+      }
+
+      // in place
+      sha256::hash64_batch(in.data(), n, (sha256*)in.data());
+      for(auto i = 0; i < n; i++) {
+         BOOST_CHECK_EQUAL(((sha256*)in.data())[i].str(), out[i].str());
+      }
+   }
+} FC_LOG_AND_RETHROW();
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -6,7 +6,10 @@
 
 #include <signal.h>
 #include <stdlib.h>
+#include <atomic>
 
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
 #include <boost/signals2/connection.hpp>
 
 #include <fc/io/json.hpp>
@@ -154,6 +157,49 @@ validate(boost::any&                     v,
     }
 }
 
+std::ostream&
+operator<<(std::ostream& osm, jmzk::chain::durability_mode m) {
+    if(m == jmzk::chain::durability_mode::sync_every_write) {
+        osm << "sync-every-write";
+    }
+    else if(m == jmzk::chain::durability_mode::group_commit) {
+        osm << "group-commit";
+    }
+    else if(m == jmzk::chain::durability_mode::wal_only) {
+        osm << "wal-only";
+    }
+
+    return osm;
+}
+
+void
+validate(boost::any&                     v,
+         const std::vector<std::string>& values,
+         jmzk::chain::durability_mode* /* target_type */,
+         int) {
+    using namespace boost::program_options;
+
+    // Make sure no previous assignment to 'v' was made.
+    validators::check_first_occurrence(v);
+
+    // Extract the first string from 'values'. If there is more than
+    // one string, it's an error, and exception will be thrown.
+    std::string const& s = validators::get_single_string(values);
+
+    if(s == "sync-every-write") {
+        v = boost::any(jmzk::chain::durability_mode::sync_every_write);
+    }
+    else if(s == "group-commit") {
+        v = boost::any(jmzk::chain::durability_mode::group_commit);
+    }
+    else if(s == "wal-only") {
+        v = boost::any(jmzk::chain::durability_mode::wal_only);
+    }
+    else {
+        throw validation_error(validation_error::invalid_option_value);
+    }
+}
+
 }  // namespace chain
 
 using namespace jmzk;
@@ -241,6 +287,7 @@ chain_plugin::chain_plugin()
     app().register_config_type<jmzk::chain::db_read_mode>();
     app().register_config_type<jmzk::chain::validation_mode>();
     app().register_config_type<jmzk::chain::storage_profile>();
+    app().register_config_type<jmzk::chain::durability_mode>();
 }
 
 chain_plugin::~chain_plugin() {}
@@ -256,6 +303,13 @@ chain_plugin::set_program_options(options_description& cli, options_description&
             "In \"disk\" profile database is optimized for the standard storage devices.\n"
             "In \"memory\" mode database is optimized for the usage in ultra-low latency devices like memory\n"
         )
+        ("token-db-durability", boost::program_options::value<jmzk::chain::durability_mode>()->default_value(jmzk::chain::durability_mode::sync_every_write),
+            "How irreversible writes of token database are made durable (\"sync-every-write\", \"group-commit\" or \"wal-only\").\n"
+            "In \"sync-every-write\" mode every write is synced to disk before returning.\n"
+            "In \"group-commit\" mode writes are synced on a background thread once every token-db-group-commit-ms.\n"
+            "In \"wal-only\" mode writes are only appended to WAL and synced by OS, recent writes may be lost if the host crashes\n"
+        )
+        ("token-db-group-commit-ms", bpo::value<uint32_t>()->default_value(100), "Interval in milliseconds of syncing token database in \"group-commit\" durability mode")
         ("checkpoint", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
         ("abi-serializer-max-time-ms", bpo::value<uint32_t>()->default_value(config::default_abi_serializer_max_time_ms), "Override default maximum ABI serialization time allowed in ms")
         ("chain-state-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_size / (1024 * 1024)), "Maximum size (in MiB) of the chain state database")
@@ -263,6 +317,12 @@ chain_plugin::set_program_options(options_description& cli, options_description&
         ("reversible-blocks-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_cache_size / (1024 * 1024)), "Maximum size (in MiB) of the reversible blocks database")
         ("reversible-blocks-db-guard-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_guard_size / (1024 * 1024)), "Safely shut down node when free space remaining in the reverseible blocks database drops below this size (in MiB).")
         ("contracts-console", bpo::bool_switch()->default_value(false), "print contract's output to console")
+        ("chain-threads", bpo::value<uint16_t>()->default_value(config::default_controller_thread_pool_size),
+            "Number of worker threads in controller thread pool, used to unpack and recover keys of transactions in incoming blocks in parallel (0 to disable)")
+        ("blocks-log-flush-interval", bpo::value<uint32_t>()->default_value(config::default_block_log_flush_interval),
+            "Flush block log once every N irreversible blocks appended, blocks not flushed are lost if node crashes")
+        ("trx-metadata-cache-size", bpo::value<uint32_t>()->default_value(config::default_trx_metadata_cache_size),
+            "Max number of pushed transactions whose recovered keys are kept for reusing when they are applied in blocks (0 to disable)")
         ("read-mode", boost::program_options::value<jmzk::chain::db_read_mode>()->default_value(jmzk::chain::db_read_mode::SPECULATIVE),
             "Database read mode (\"speculative\", \"head\", or \"read-only\").\n"// or \"irreversible\").\n"
             "In \"speculative\" mode database contains changes done up to the head block plus changes made by transactions not yet included to the blockchain.\n"
@@ -415,6 +475,15 @@ chain_plugin::plugin_initialize(const variables_map& options) {
             my->chain_config->db_config.profile = options.at("token-db-profile").as<storage_profile>();
         }
 
+        if(options.count("token-db-durability")) {
+            my->chain_config->db_config.durability = options.at("token-db-durability").as<durability_mode>();
+        }
+
+        if(options.count("token-db-group-commit-ms")) {
+            my->chain_config->db_config.group_commit_ms = options.at("token-db-group-commit-ms").as<uint32_t>();
+            jmzk_ASSERT(my->chain_config->db_config.group_commit_ms > 0, plugin_config_exception, "token-db-group-commit-ms should be greater than 0");
+        }
+
         if(options.count("chain-state-db-size-mb")) {
             my->chain_config->state_size = options.at("chain-state-db-size-mb").as<uint64_t>() * 1024 * 1024;
         }
@@ -436,6 +505,9 @@ chain_plugin::plugin_initialize(const variables_map& options) {
         my->chain_config->loadtest_mode       = options.at("loadtest-mode").as<bool>();
         my->chain_config->charge_free_mode    = options.at("charge-free-mode").as<bool>();
         my->chain_config->contracts_console   = options.at("contracts-console").as<bool>();
+        my->chain_config->thread_pool_size    = options.at("chain-threads").as<uint16_t>();
+        my->chain_config->blocks_flush_interval = options.at("blocks-log-flush-interval").as<uint32_t>();
+        my->chain_config->trx_metas_cache_size  = options.at("trx-metadata-cache-size").as<uint32_t>();
 
         if(options.count("extract-genesis-json") || options.at("print-genesis-json").as<bool>()) {
             genesis_state gs;
@@ -1271,39 +1343,119 @@ read_write::push_transaction(const read_write::push_transaction_params& params,
     CATCH_AND_CALL(next);
 }
 
-static void
-push_recurse(read_write* rw, int index, const std::shared_ptr<read_write::push_transactions_params>& params, const std::shared_ptr<read_write::push_transactions_results>& results, const next_function<read_write::push_transactions_results>& next) {
-    auto wrapped_next = [=](const fc::static_variant<fc::exception_ptr, read_write::push_transaction_results>& result) {
-        if(result.contains<fc::exception_ptr>()) {
-            const auto& e = result.get<fc::exception_ptr>();
-            results->emplace_back(read_write::push_transaction_results{transaction_id_type(), fc::mutable_variant_object("error", e->to_detail_string())});
-        }
-        else {
-            const auto& r = result.get<read_write::push_transaction_results>();
-            results->emplace_back(r);
-        }
-
-        auto next_index = index + 1;
-        if((size_t)next_index < params->size()) {
-            push_recurse(rw, next_index, params, results, next);
-        }
-        else {
-            next(*results);
-        }
-    };
+struct push_transactions_batch {
+public:
+    push_transactions_batch(size_t size)
+        : trxs(size), results(size), remaining(0) {}
 
-    rw->push_transaction(params->at(index), wrapped_next);
-}
+public:
+    std::vector<transaction_metadata_ptr> trxs;  // empty if the transaction cannot be deserialized
+    read_write::push_transactions_results results;
+    std::atomic<size_t>                   remaining;
+};
 
 void
 read_write::push_transactions(const read_write::push_transactions_params& params, next_function<read_write::push_transactions_results> next) {
     try {
         FC_ASSERT(params.size() <= 1000, "Attempt to push too many transactions at once");
-        auto params_copy = std::make_shared<read_write::push_transactions_params>(params.begin(), params.end());
-        auto result      = std::make_shared<read_write::push_transactions_results>();
-        result->reserve(params.size());
 
-        push_recurse(this, 0, params_copy, result, next);
+        auto  batch    = std::make_shared<push_transactions_batch>(params.size());
+        auto& exec_ctx = db.get_execution_context();
+        auto  valid    = size_t(0);
+
+        // deserialization depends on the action versions in execution context, so it's done on main thread
+        for(auto i = 0u; i < params.size(); i++) {
+            try {
+                try {
+                    auto ptrx = std::make_shared<packed_transaction>();
+                    db.get_abi_serializer().from_variant(params[i], *ptrx, exec_ctx);
+                    batch->trxs[i] = std::make_shared<transaction_metadata>(ptrx);
+                    valid++;
+                }
+                jmzk_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
+            }
+            catch(const fc::unrecoverable_exception&) {
+                // not an error of this transaction, handled below
+                throw;
+            }
+            catch(const fc::exception& e) {
+                batch->results[i] = read_write::push_transaction_results{transaction_id_type(), fc::mutable_variant_object("error", e.to_detail_string())};
+            }
+        }
+
+        if(valid == 0) {
+            next(batch->results);
+            return;
+        }
+
+        // pushes all the transactions in order, their keys are recovered already
+        // so producer_plugin handles them right away without reordering
+        auto submit = [this, batch, valid, next, &exec_ctx] {
+            batch->remaining = valid;
+            for(auto i = 0u; i < batch->trxs.size(); i++) {
+                if(!batch->trxs[i]) {
+                    continue;
+                }
+                app().get_method<incoming::methods::transaction_async>()(batch->trxs[i], true, [this, batch, i, next, &exec_ctx](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result) -> void {
+                    auto& r = batch->results[i];
+                    if(result.contains<fc::exception_ptr>()) {
+                        r = read_write::push_transaction_results{transaction_id_type(), fc::mutable_variant_object("error", result.get<fc::exception_ptr>()->to_detail_string())};
+                    }
+                    else {
+                        auto& trace = result.get<transaction_trace_ptr>();
+                        try {
+                            auto pretty_output = fc::variant();
+                            db.get_abi_serializer().to_variant(*trace, pretty_output, exec_ctx);
+                            r = read_write::push_transaction_results{trace->id, pretty_output};
+                        }
+                        catch(boost::interprocess::bad_alloc&) {
+                            chain_plugin::handle_db_exhaustion();
+                        }
+                        catch(fc::unrecoverable_exception&) {
+                            raise(SIGUSR1);
+                        }
+                        catch(const fc::exception& e) {
+                            r = read_write::push_transaction_results{trace->id, fc::mutable_variant_object("error", e.to_detail_string())};
+                        }
+                    }
+
+                    if(--batch->remaining == 0) {
+                        next(batch->results);
+                    }
+                });
+            }
+        };
+
+        auto pool = db.get_thread_pool();
+        if(pool == nullptr) {
+            submit();
+            return;
+        }
+
+        // recover keys of whole batch in parallel, the last finished one hands the batch back to main thread
+        batch->remaining = valid;
+        for(auto& trx : batch->trxs) {
+            if(!trx) {
+                continue;
+            }
+            boost::asio::post(*pool, [trx, batch, submit, chain_id = db.get_chain_id()] {
+                try {
+                    // invalid signatures are reported when the transaction is applied
+                    trx->recover_keys(chain_id);
+                }
+                catch(...) {}
+
+                if(--batch->remaining == 0) {
+                    app().post(priority::low, submit);
+                }
+            });
+        }
+    }
+    catch(boost::interprocess::bad_alloc&) {
+        chain_plugin::handle_db_exhaustion();
+    }
+    catch(fc::unrecoverable_exception&) {
+        raise(SIGUSR1);
     }
     CATCH_AND_CALL(next);
 }
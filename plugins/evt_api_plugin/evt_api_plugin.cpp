@@ -52,23 +52,30 @@ void
 jmzk_api_plugin::plugin_startup() {
     ilog("starting jmzk_api_plugin");
     my.reset(new jmzk_api_plugin_impl(app().get_plugin<chain_plugin>().chain()));
+    auto& http = app().get_plugin<http_plugin>();
+    if(http.read_only_threads() > 0) {
+        app().get_plugin<jmzk_plugin>().enable_read_only_view();
+    }
+
     auto ro_api = app().get_plugin<jmzk_plugin>().get_read_only_api();
 
-    app().get_plugin<http_plugin>().add_api({jmzk_RO_CALL(get_domain, 200),
-                                             jmzk_RO_CALL(get_group, 200),
-                                             jmzk_RO_CALL(get_token, 200),
-                                             jmzk_RO_CALL(get_tokens, 200),
-                                             jmzk_RO_CALL(get_fungible, 200),
-                                             jmzk_RO_CALL(get_fungible_balance, 200),
-                                             jmzk_RO_CALL(get_fungible_psvbonus, 200),
-                                             jmzk_RO_CALL(get_suspend, 200),
-                                             jmzk_RO_CALL(get_lock, 200),
-                                             jmzk_RO_CALL(get_stakepool, 200),
-                                             jmzk_RO_CALL(get_validator, 200),
-                                             jmzk_RO_CALL(get_staking_shares, 200),
-                                             jmzk_RO_CALL(get_jmzklink_signed_keys, 200),
-                                             jmzk_RO_CALL(get_script, 200)
-                                         });
+    // apis only reading token database can be served from read-only threads
+    http.add_read_only_api({jmzk_RO_CALL(get_domain, 200),
+                            jmzk_RO_CALL(get_group, 200),
+                            jmzk_RO_CALL(get_token, 200),
+                            jmzk_RO_CALL(get_tokens, 200),
+                            jmzk_RO_CALL(get_fungible, 200),
+                            jmzk_RO_CALL(get_fungible_balance, 200),
+                            jmzk_RO_CALL(get_fungible_psvbonus, 200),
+                            jmzk_RO_CALL(get_lock, 200),
+                            jmzk_RO_CALL(get_stakepool, 200),
+                            jmzk_RO_CALL(get_validator, 200),
+                            jmzk_RO_CALL(get_staking_shares, 200),
+                            jmzk_RO_CALL(get_script, 200)
+                        });
+    http.add_api({jmzk_RO_CALL(get_suspend, 200),
+                  jmzk_RO_CALL(get_jmzklink_signed_keys, 200)
+              });
 }
 
 void
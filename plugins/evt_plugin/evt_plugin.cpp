@@ -5,6 +5,8 @@
 
 #include <jmzk/jmzk_plugin/jmzk_plugin.hpp>
 
+#include <atomic>
+
 #include <fc/container/flat.hpp>
 #include <fc/io/json.hpp>
 #include <fc/variant.hpp>
@@ -29,8 +31,23 @@ public:
     jmzk_plugin_impl(controller& db)
         : db_(db) {}
 
+public:
+    token_database_view_ptr
+    get_view() const {
+        return std::atomic_load(&view_);
+    }
+
+    // savepoint of each block has the seq of its block num, the ones of pending block are excluded
+    void
+    update_view(uint32_t block_num) {
+        std::atomic_store(&view_, db_.token_db().new_view(block_num));
+    }
+
 public:
     controller& db_;
+
+    token_database_view_ptr                          view_;
+    std::optional<boost::signals2::scoped_connection> accepted_block_connection_;
 };
 
 jmzk_plugin::jmzk_plugin() {}
@@ -45,11 +62,31 @@ jmzk_plugin::plugin_startup() {
     this->my_.reset(new jmzk_plugin_impl(app().get_plugin<chain_plugin>().chain()));
 }
 
-void jmzk_plugin::plugin_shutdown() {}
+void
+jmzk_plugin::plugin_shutdown() {
+    if(my_) {
+        my_->accepted_block_connection_.reset();
+        std::atomic_store(&my_->view_, token_database_view_ptr());
+    }
+}
 
 jmzk_apis::read_only
 jmzk_plugin::get_read_only_api() const {
-    return jmzk_apis::read_only(my_->db_);
+    return jmzk_apis::read_only(my_->db_, *my_);
+}
+
+void
+jmzk_plugin::enable_read_only_view() {
+    if(my_->accepted_block_connection_.has_value()) {
+        return;
+    }
+
+    // view is at the state of last accepted block, writes of pending block are not visible
+    my_->update_view(my_->db_.head_block_num());
+    my_->accepted_block_connection_ = my_->db_.accepted_block.connect([this](auto& bs) {
+        my_->update_view(bs->block_num);
+    });
+    ilog("Read-only APIs of jmzk_plugin are served from token database view");
 }
 
 jmzk_apis::read_write
@@ -59,13 +96,36 @@ jmzk_plugin::get_read_write_api() {
 
 namespace jmzk_apis {
 
-#define READ_DB_TOKEN(TYPE, PREFIX, KEY, VPTR, EXCEPTION, FORMAT, ...)      \
-    try {                                                                   \
-        using vtype = typename decltype(VPTR)::element_type;                \
-        VPTR = tokendb_cache.template read_token<vtype>(TYPE, PREFIX, KEY); \
-    }                                                                       \
-    catch(token_database_exception&) {                                      \
-        jmzk_THROW2(EXCEPTION, FORMAT, __VA_ARGS__);                         \
+// read from view when it's enabled, otherwise from the cache shared with main thread
+template<typename T>
+std::shared_ptr<T>
+read_db_token(const token_database_view_ptr& view, token_database_cache& cache, token_type type, const std::optional<name128>& domain, const name128& key) {
+    if(view) {
+        auto str = std::string();
+        view->read_token(type, domain, key, str);
+
+        auto v = std::make_shared<T>();
+        extract_db_value(str, *v);
+        return v;
+    }
+    return cache.read_token<T>(type, domain, key);
+}
+
+int
+read_db_asset(const token_database_view_ptr& view, const token_database& tokendb, const address& addr, symbol_id_type sym_id, std::string& out, bool no_throw = false) {
+    if(view) {
+        return view->read_asset(addr, sym_id, out, no_throw);
+    }
+    return tokendb.read_asset(addr, sym_id, out, no_throw);
+}
+
+#define READ_DB_TOKEN(TYPE, PREFIX, KEY, VPTR, EXCEPTION, FORMAT, ...)            \
+    try {                                                                         \
+        using vtype = typename decltype(VPTR)::element_type;                      \
+        VPTR = read_db_token<vtype>(tokendb_view, tokendb_cache, TYPE, PREFIX, KEY); \
+    }                                                                             \
+    catch(token_database_exception&) {                                            \
+        jmzk_THROW2(EXCEPTION, FORMAT, __VA_ARGS__);                               \
     }
     
 #define MAKE_PROPERTY(AMOUNT, SYM) \
@@ -80,7 +140,7 @@ namespace jmzk_apis {
 #define READ_DB_ASSET(ADDR, SYM, VALUEREF)                                                         \
     try {                                                                                          \
         auto str = std::string();                                                                  \
-        tokendb.read_asset(ADDR, SYM.id(), str);                                                   \
+        read_db_asset(tokendb_view, tokendb, ADDR, SYM.id(), str);                                 \
                                                                                                    \
         extract_db_value(str, VALUEREF);                                                           \
     }                                                                                              \
@@ -88,20 +148,21 @@ namespace jmzk_apis {
         jmzk_THROW2(balance_exception, "There's no balance left in {} with sym id: {}", ADDR, SYM); \
     }
 
-#define READ_DB_ASSET_NO_THROW(ADDR, SYM, VALUEREF)                         \
-    {                                                                       \
-        auto str = std::string();                                           \
-        if(!tokendb.read_asset(ADDR, SYM.id(), str, true /* no throw */)) { \
-            VALUEREF = MAKE_PROPERTY(0, SYM);                               \
-        }                                                                   \
-        else {                                                              \
-            extract_db_value(str, VALUEREF);                                \
-        }                                                                   \
+#define READ_DB_ASSET_NO_THROW(ADDR, SYM, VALUEREF)                                          \
+    {                                                                                        \
+        auto str = std::string();                                                            \
+        if(!read_db_asset(tokendb_view, tokendb, ADDR, SYM.id(), str, true /* no throw */)) { \
+            VALUEREF = MAKE_PROPERTY(0, SYM);                                                \
+        }                                                                                    \
+        else {                                                                               \
+            extract_db_value(str, VALUEREF);                                                 \
+        }                                                                                    \
     }
 
-#define DECLARE_TOKEN_DB()                     \
-    auto& tokendb = db_.token_db();            \
-    auto& tokendb_cache = db_.token_db_cache();
+#define DECLARE_TOKEN_DB()                          \
+    auto& tokendb       = db_.token_db();           \
+    auto& tokendb_cache = db_.token_db_cache();     \
+    auto  tokendb_view  = plugin_.get_view();
 
 enum psvbonus_type { kPsvBonus = 0, kPsvBonusSlim };
 
@@ -117,7 +178,7 @@ read_only::get_domain(const read_only::get_domain_params& params) {
     DECLARE_TOKEN_DB();
 
     auto var    = variant();
-    auto domain = make_empty_cache_ptr<domain_def>();
+    auto domain = std::shared_ptr<domain_def>();
     READ_DB_TOKEN(token_type::domain, std::nullopt, params.name, domain, unknown_domain_exception, "Cannot find domain: {}", params.name);
 
     fc::to_variant(*domain, var);
@@ -132,7 +193,7 @@ read_only::get_group(const read_only::get_group_params& params) {
     DECLARE_TOKEN_DB();
 
     auto var   = variant();
-    auto group = make_empty_cache_ptr<group_def>();
+    auto group = std::shared_ptr<group_def>();
     READ_DB_TOKEN(token_type::group, std::nullopt, params.name, group, unknown_group_exception, "Cannot find group: {}", params.name);
 
     fc::to_variant(*group, var);
@@ -147,7 +208,7 @@ read_only::get_token(const read_only::get_token_params& params) {
     DECLARE_TOKEN_DB();
 
     auto var   = variant();
-    auto token = make_empty_cache_ptr<token_def>();
+    auto token = std::shared_ptr<token_def>();
     READ_DB_TOKEN(token_type::token, params.domain, params.name, token, unknown_token_exception, "Cannot find token: {} in {}", params.name, params.domain);
 
     fc::to_variant(*token, var);
@@ -169,7 +230,7 @@ read_only::get_tokens(const get_tokens_params& params) {
     }
 
     int i = 0;
-    tokendb.read_tokens_range(token_type::token, params.domain, s, [&](auto& key, auto&& value) {
+    auto func = [&](auto& key, auto&& value) {
         auto var = fc::variant();
 
         token_def token;
@@ -182,7 +243,14 @@ read_only::get_tokens(const get_tokens_params& params) {
             return false;
         }
         return true;
-    });
+    };
+
+    if(tokendb_view) {
+        tokendb_view->read_tokens_range(token_type::token, params.domain, s, func);
+    }
+    else {
+        tokendb.read_tokens_range(token_type::token, params.domain, s, func);
+    }
 
     return vars;
 }
@@ -192,7 +260,7 @@ read_only::get_fungible(const get_fungible_params& params) {
     DECLARE_TOKEN_DB();
 
     auto var      = variant();
-    auto fungible = make_empty_cache_ptr<fungible_def>();
+    auto fungible = std::shared_ptr<fungible_def>();
     READ_DB_TOKEN(token_type::fungible, std::nullopt, params.id, fungible, unknown_fungible_exception, "Cannot find fungible with sym id: {}", params.id);
 
     fc::to_variant(*fungible, var);
@@ -214,7 +282,7 @@ read_only::get_fungible_balance(const get_fungible_balance_params& params) {
 
     auto vars = variants();
     if(params.sym_id.has_value()) {
-        auto fungible = make_empty_cache_ptr<fungible_def>();
+        auto fungible = std::shared_ptr<fungible_def>();
         READ_DB_TOKEN(token_type::fungible, std::nullopt, *params.sym_id, fungible,
             unknown_fungible_exception, "Cannot find fungible with sym id: {}", *params.sym_id);
 
@@ -235,7 +303,7 @@ fc::variant
 read_only::get_fungible_psvbonus(const get_fungible_psvbonus_params& params) {
     DECLARE_TOKEN_DB();
 
-    auto pb   = make_empty_cache_ptr<passive_bonus>();
+    auto pb   = std::shared_ptr<passive_bonus>();
     auto dkey = get_psvbonus_db_key(params.id, kPsvBonus);
     READ_DB_TOKEN(token_type::psvbonus, std::nullopt, dkey, pb, unknown_bonus_exception,
         "Cannot find passive bonus registered for fungible token with sym id: {}.", params.id);
@@ -255,7 +323,7 @@ read_only::get_suspend(const get_suspend_params& params) {
     DECLARE_TOKEN_DB();
 
     auto var     = variant();
-    auto suspend = make_empty_cache_ptr<suspend_def>();
+    auto suspend = std::shared_ptr<suspend_def>();
     READ_DB_TOKEN(token_type::suspend, std::nullopt, params.name, suspend, unknown_suspend_exception, "Cannot find suspend proposal: {}", params.name);
 
     db_.get_abi_serializer().to_variant(*suspend, var, db_.get_execution_context());
@@ -267,7 +335,7 @@ read_only::get_lock(const get_lock_params& params) {
     DECLARE_TOKEN_DB();
 
     auto var  = variant();
-    auto lock = make_empty_cache_ptr<lock_def>();
+    auto lock = std::shared_ptr<lock_def>();
     READ_DB_TOKEN(token_type::lock, std::nullopt, params.name, lock, unknown_lock_exception, "Cannot find lock proposal: {}", params.name);
 
     fc::to_variant(*lock, var);
@@ -279,7 +347,7 @@ read_only::get_stakepool(const get_stakepool_params& params) {
     DECLARE_TOKEN_DB();
 
     auto var  = variant();
-    auto pool = make_empty_cache_ptr<stakepool_def>();
+    auto pool = std::shared_ptr<stakepool_def>();
     READ_DB_TOKEN(token_type::stakepool, std::nullopt, params.sym_id, pool, unknown_stakepool_exception, "Cannot find stakepool with sym id: {}", params.sym_id);
 
     fc::to_variant(*pool, var);
@@ -291,7 +359,7 @@ read_only::get_validator(const get_validator_params& params) {
     DECLARE_TOKEN_DB();
 
     auto var  = variant();
-    auto validator = make_empty_cache_ptr<validator_def>();
+    auto validator = std::shared_ptr<validator_def>();
     READ_DB_TOKEN(token_type::validator, std::nullopt, params.name, validator, unknown_validator_exception, "Cannot find validator: {}", params.name);
     fc::to_variant(*validator, var);
 
@@ -335,7 +403,7 @@ read_only::get_script(const get_script_params& params) const {
     DECLARE_TOKEN_DB();
 
     auto var  = variant();
-    auto script = make_empty_cache_ptr<script_def>();
+    auto script = std::shared_ptr<script_def>();
     READ_DB_TOKEN(token_type::script, std::nullopt, params.name, script, unknown_script_exception, "Cannot find script: {}", params.name);
     to_variant(*script, var);
 
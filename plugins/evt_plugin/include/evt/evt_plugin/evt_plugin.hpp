@@ -19,6 +19,7 @@ class controller;
 }  // namespace chain
 
 class jmzk_plugin;
+class jmzk_plugin_impl;
 
 namespace jmzk_apis {
 
@@ -27,8 +28,9 @@ using namespace jmzk::chain::contracts;
 
 class read_only {
 public:
-    read_only(const controller& db)
-        : db_(db) {}
+    read_only(const controller& db, const jmzk_plugin_impl& plugin)
+        : db_(db)
+        , plugin_(plugin) {}
 
 public:
     struct get_domain_params {
@@ -107,7 +109,8 @@ public:
     fc::variant get_script(const get_script_params& params) const;
 
 private:
-    const controller& db_;
+    const controller&       db_;
+    const jmzk_plugin_impl& plugin_;
 };
 
 class read_write {};
@@ -130,6 +133,10 @@ public:
     jmzk_apis::read_only  get_read_only_api() const;
     jmzk_apis::read_write get_read_write_api();
 
+    // after enabled, read-only apis read from a token database view pinned at the last accepted block,
+    // instead of the live database, therefore they can be served from threads other than main thread
+    void enable_read_only_view();
+
 private:
     std::unique_ptr<class jmzk_plugin_impl> my_;
 };
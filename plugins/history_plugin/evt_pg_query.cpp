@@ -6,11 +6,13 @@
 
 #pragma GCC diagnostic ignored "-Wunused-local-typedefs"
 
+#include <algorithm>
 #include <functional>
 #include <fmt/format.h>
 #include <libpq-fe.h>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/asio/post.hpp>
 #include <fc/io/json.hpp>
 #include <jmzk/chain/block_header.hpp>
 #include <jmzk/chain/exceptions.hpp>
@@ -112,177 +114,275 @@ fix_pg_timestamp(char* str) {
 
 }  // namespace internal
 
+pg_query::pg_query(boost::asio::io_context& io_serv, controller& chain, size_t connections, size_t threads)
+    : io_serv_(io_serv), chain_(chain) {
+    jmzk_ASSERT(connections > 0, chain::plugin_config_exception, "At least one postgres connection is required for history plugin");
+    for(auto i = 0u; i < connections; i++) {
+        conns_.emplace_back(std::make_unique<connection>(io_serv));
+    }
+    if(threads > 0) {
+        thread_pool_.emplace(threads);
+    }
+}
+
+pg_query::~pg_query() {
+    if(thread_pool_) {
+        thread_pool_->join();
+        thread_pool_->stop();
+    }
+}
+
 int
 pg_query::connect(const std::string& conn) {
-    conn_ = PQconnectdb(conn.c_str());
+    for(auto& c : conns_) {
+        c->conn = PQconnectdb(conn.c_str());
 
-    auto status = PQstatus(conn_);
-    jmzk_ASSERT(status == CONNECTION_OK, chain::postgres_connection_exception, "Connect failed");
+        auto status = PQstatus(c->conn);
+        jmzk_ASSERT(status == CONNECTION_OK, chain::postgres_connection_exception, "Connect failed");
 
-    socket_ = boost::asio::ip::tcp::socket(io_serv_, boost::asio::ip::tcp::v4(), PQsocket(conn_));
+        c->socket = boost::asio::ip::tcp::socket(io_serv_, boost::asio::ip::tcp::v4(), PQsocket(c->conn));
+    }
     return PG_OK;
 }
 
 int
 pg_query::close() {
-    FC_ASSERT(conn_);
-    PQfinish(conn_);
-    conn_ = nullptr;
+    // wait for results being decoded
+    if(thread_pool_) {
+        thread_pool_->join();
+        thread_pool_->stop();
+        thread_pool_.reset();
+    }
+    for(auto& c : conns_) {
+        FC_ASSERT(c->conn);
+        if(c->result) {
+            PQclear(c->result);
+            c->result = nullptr;
+        }
+        PQfinish(c->conn);
+        c->conn = nullptr;
+    }
 
     return PG_OK;
 }
 
 int
 pg_query::prepare_stmts() {
-    for(auto it : internal::prepare_register::instance().stmts) {
-        auto r = PQprepare(conn_, it.first.c_str(), it.second.c_str(), 0, NULL);
-        jmzk_ASSERT(PQresultStatus(r) == PGRES_COMMAND_OK, chain::postgres_exec_exception,
-            "Prepare sql failed, sql: ${s}, detail: ${d}", ("s",it.second)("d",PQerrorMessage(conn_)));
-        PQclear(r);
+    for(auto& c : conns_) {
+        for(auto it : internal::prepare_register::instance().stmts) {
+            auto r = PQprepare(c->conn, it.first.c_str(), it.second.c_str(), 0, NULL);
+            jmzk_ASSERT(PQresultStatus(r) == PGRES_COMMAND_OK, chain::postgres_exec_exception,
+                "Prepare sql failed, sql: ${s}, detail: ${d}", ("s",it.second)("d",PQerrorMessage(c->conn)));
+            PQclear(r);
+        }
+
+#ifdef LIBPQ_HAS_PIPELINING
+        // statements are prepared, switch to pipeline mode so that several queries can be in flight
+        c->pipeline = (PQenterPipelineMode(c->conn) == 1);
+#endif
     }
     return PG_OK;
 }
 
 int
 pg_query::begin_poll_read() {
-    socket_.async_wait(boost::asio::ip::tcp::socket::wait_type::wait_read, std::bind(&pg_query::poll_read, this));
+    for(auto& c : conns_) {
+        c->socket.async_wait(boost::asio::ip::tcp::socket::wait_type::wait_read, std::bind(&pg_query::poll_read, this, std::ref(*c)));
+    }
     return PG_OK;
 }
 
 int
-pg_query::queue(int id, int task, std::string&& stmt) {
-    tasks_.emplace(id, task, std::move(stmt));
-    
-    if(!sending_) {
-        send_once();
-    }
+pg_query::queue(int id, int type, const char* plan, std::vector<std::string>&& params) {
+    tasks_.emplace(id, type, plan, std::move(params));
+    dispatch();
+
     return PG_OK;
 }
 
+void
+pg_query::dispatch() {
+    auto inflight = [](auto& c) {
+        return c->pipeline ? kMaxPipelineDepth : size_t(1);
+    };
+
+    while(!tasks_.empty()) {
+        // pick the connection with the fewest queries in flight
+        auto it = std::min_element(conns_.begin(), conns_.end(), [](auto& a, auto& b) {
+            return a->sent.size() < b->sent.size();
+        });
+        if((*it)->sent.size() >= inflight(*it)) {
+            // all the connections are busy, keep waiting in queue
+            break;
+        }
+
+        auto t = std::move(tasks_.front());
+        tasks_.pop();
+
+        send_once(**it, std::move(t));
+    }
+}
+
 int
-pg_query::send_once() {
+pg_query::send_once(connection& c, task&& t) {
     using namespace internal;
 
-    assert(!tasks_.empty());
-    auto& t = tasks_.front();
+    auto values = std::vector<const char*>();
+    values.reserve(t.params.size());
+    for(auto& p : t.params) {
+        values.emplace_back(p.c_str());
+    }
 
-    auto r = PQsendQuery(conn_, t.stmt.c_str());
+    auto r = PQsendQueryPrepared(c.conn, t.plan, (int)values.size(), values.data(), NULL, NULL, 0);
+#ifdef LIBPQ_HAS_PIPELINING
+    if(r == 1 && c.pipeline) {
+        // sync after each query so a failed one doesn't abort the others in pipeline
+        r = PQpipelineSync(c.conn);
+    }
+#endif
     if(r == 1) {
-        sending_ = true;
+        c.sent.emplace_back(std::move(t));
         return PG_OK;
     }
 
     try {
         jmzk_THROW2(chain::postgres_send_exception,
-            "Send '{}' query command failed, try agian later, detail: {}", call_names[t.type], PQerrorMessage(conn_));
+            "Send '{}' query command failed, try agian later, detail: {}", call_names[t.type], PQerrorMessage(c.conn));
     }
     catch(...) {
         app().get_plugin<http_plugin>().handle_async_exception(t.id, "history", call_names[t.type], "");
     }
-
-    tasks_.pop();
-    if(!tasks_.empty()) {
-        // send next one
-        return send_once();
-    }
     return PG_FAIL;
 }
 
 int
-pg_query::poll_read() {
-    using namespace internal;
-
-    bool busy = false;
-    while(1) {
-        auto r = PQconsumeInput(conn_);
-        jmzk_ASSERT(r, chain::postgres_poll_exception, "Poll messages from postgres failed, detail: ${d}", ("d",PQerrorMessage(conn_)));
-
-        if(PQisBusy(conn_)) {
-            busy = true;
-            break;
+pg_query::poll_read(connection& c) {
+    auto r = PQconsumeInput(c.conn);
+    jmzk_ASSERT(r, chain::postgres_poll_exception, "Poll messages from postgres failed, detail: ${d}", ("d",PQerrorMessage(c.conn)));
+
+    while(!PQisBusy(c.conn)) {
+        auto re = PQgetResult(c.conn);
+        if(re != NULL) {
+#ifdef LIBPQ_HAS_PIPELINING
+            if(PQresultStatus(re) == PGRES_PIPELINE_SYNC) {
+                PQclear(re);
+                continue;
+            }
+#endif
+            // only the first result of one query is used
+            if(c.result == nullptr) {
+                c.result = re;
+            }
+            else {
+                PQclear(re);
+            }
+            continue;
         }
 
-        auto re = PQgetResult(conn_);
-        if(re == NULL) {
+        if(c.result == nullptr) {
+            // nothing left to read for now
             break;
         }
 
-        auto t = tasks_.front();
-        tasks_.pop();
+        // all the results of the front query are received
+        FC_ASSERT(!c.sent.empty(), "Tasks should not be empty");
+        auto t = std::move(c.sent.front());
+        c.sent.pop_front();
+
+        decode(std::move(t), std::exchange(c.result, nullptr));
+    }
+
+    c.socket.async_wait(boost::asio::ip::tcp::socket::wait_type::wait_read, std::bind(&pg_query::poll_read, this, std::ref(c)));
+
+    // connection may have room for queued tasks now
+    dispatch();
+    return PG_OK;
+}
+
+void
+pg_query::decode(task&& t, pg_result* r) {
+    using namespace internal;
 
+    auto f = [this, t = std::move(t), r] {
         try {
-            switch(t.type) {
-            case kGetTokens: {
-                get_tokens_resume(t.id, re);
-                break;
-            }
-            case kGetDomains: {
-                get_domains_resume(t.id, re);
-                break;
-            }
-            case kGetGroups: {
-                get_groups_resume(t.id, re);
-                break;
-            }
-            case kGetFungibles: {
-                get_fungibles_resume(t.id, re);
-                break;
-            }
-            case kGetActions: {
-                get_actions_resume(t.id, re);
-                break;
-            }
-            case kGetFungibleActions: {
-                get_fungible_actions_resume(t.id, re);
-                break;
-            }
-            case kGetFungiblesBalance: {
-                get_fungibles_balance_resume(t.id, re);
-                break;
-            }
-            case kGetTransaction: {
-                get_transaction_resume(t.id, re);
-                break;
-            }
-            case kGetTransactions: {
-                get_transactions_resume(t.id, re);
-                break;
-            }
-            case kGetFungibleIds: {
-                get_fungible_ids_resume(t.id, re);
-                break;
-            }
-            case kGetTransactionActions: {
-                get_transaction_actions_resume(t.id, re);
-                break;
-            }
-            };  // switch
+            resume(t, r);
         }
         catch(...) {
             app().get_plugin<http_plugin>().handle_async_exception(t.id, "history", call_names[t.type], "");
         }
-
-        PQclear(re);
+        PQclear(r);
+    };
+
+    switch(t.type) {
+    case kGetFungiblesBalance:
+    case kGetTransaction:
+    case kGetTransactions: {
+        // these read token database and blocks from chain, which is only safe on main thread
+        app().post(priority::low, std::move(f));
+        break;
     }
+    default: {
+        if(thread_pool_) {
+            boost::asio::post(*thread_pool_, std::move(f));
+        }
+        else {
+            boost::asio::post(io_serv_, std::move(f));
+        }
+        break;
+    }
+    };  // switch
+}
 
-    socket_.async_wait(boost::asio::ip::tcp::socket::wait_type::wait_read, std::bind(&pg_query::poll_read, this));
-    if(busy) {
-        // still needs wait next data part
-        return PG_OK;
+void
+pg_query::resume(const task& t, pg_result const* re) {
+    using namespace internal;
+
+    switch(t.type) {
+    case kGetTokens: {
+        get_tokens_resume(t.id, re);
+        break;
     }
-    if(!tasks_.empty()) {
-        // send next one
-        if(send_once() == PG_FAIL) {
-            // no send
-            FC_ASSERT(tasks_.empty(), "Tasks should be empty");
-            sending_ = false;
-        }
-        // keep sending state
+    case kGetDomains: {
+        get_domains_resume(t.id, re);
+        break;
     }
-    else {  // tasks is empty
-        sending_ = false;
+    case kGetGroups: {
+        get_groups_resume(t.id, re);
+        break;
     }
-    return PG_OK;
+    case kGetFungibles: {
+        get_fungibles_resume(t.id, re);
+        break;
+    }
+    case kGetActions: {
+        get_actions_resume(t.id, re);
+        break;
+    }
+    case kGetFungibleActions: {
+        get_fungible_actions_resume(t.id, re);
+        break;
+    }
+    case kGetFungiblesBalance: {
+        get_fungibles_balance_resume(t.id, re);
+        break;
+    }
+    case kGetTransaction: {
+        get_transaction_resume(t.id, re);
+        break;
+    }
+    case kGetTransactions: {
+        get_transactions_resume(t.id, re);
+        break;
+    }
+    case kGetFungibleIds: {
+        get_fungible_ids_resume(t.id, re);
+        break;
+    }
+    case kGetTransactionActions: {
+        get_transaction_actions_resume(t.id, re);
+        break;
+    }
+    };  // switch
 }
 
 PREPARE_SQL_ONCE(gt_plan,  "SELECT domain, name FROM tokens WHERE $1 @> owner AND domain = $2");
@@ -295,22 +395,19 @@ pg_query::get_tokens_async(int id, const read_only::get_tokens_params& params) {
     auto pkeys_buf = fmt::memory_buffer();
     format_array_to(pkeys_buf, std::begin(params.keys), std::end(params.keys));
 
-    auto stmt = std::string();
     if(params.domain.has_value()) {
-        stmt = fmt::format(fmt("EXECUTE gt_plan ('{}','{}');"), fmt::to_string(pkeys_buf), (std::string)*params.domain);
+        return queue(id, kGetTokens, "gt_plan", { fmt::to_string(pkeys_buf), (std::string)*params.domain });
     }
     else {
-        stmt = fmt::format(fmt("EXECUTE gt_plan2 ('{}');"), fmt::to_string(pkeys_buf));
+        return queue(id, kGetTokens, "gt_plan2", { fmt::to_string(pkeys_buf) });
     }
-
-    return queue(id, kGetTokens, std::move(stmt));
 }
 
 int
 pg_query::get_tokens_resume(int id, pg_result const* r) {
     using namespace internal;
 
-    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get tokens failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get tokens failed, detail: ${s}", ("s",PQresultErrorMessage(r)));
 
     auto n = PQntuples(r);
     if(n == 0) {
@@ -340,15 +437,14 @@ pg_query::get_domains_async(int id, const read_only::get_params& params) {
     auto pkeys_buf = fmt::memory_buffer();
     format_array_to(pkeys_buf, std::begin(params.keys), std::end(params.keys));
 
-    auto stmt = fmt::format(fmt("EXECUTE gd_plan ('{}')"), fmt::to_string(pkeys_buf));
-    return queue(id, kGetDomains, std::move(stmt));
+    return queue(id, kGetDomains, "gd_plan", { fmt::to_string(pkeys_buf) });
 }
 
 int
 pg_query::get_domains_resume(int id, pg_result const* r) {
     using namespace internal;
 
-    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get domains failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get domains failed, detail: ${s}", ("s",PQresultErrorMessage(r)));
 
     auto n = PQntuples(r);
     if(n == 0) {
@@ -373,15 +469,14 @@ pg_query::get_groups_async(int id, const read_only::get_params& params) {
     auto pkeys_buf = fmt::memory_buffer();
     format_array_to(pkeys_buf, std::begin(params.keys), std::end(params.keys));
 
-    auto stmt = fmt::format(fmt("EXECUTE gg_plan ('{}')"), fmt::to_string(pkeys_buf));
-    return queue(id, kGetGroups, std::move(stmt));
+    return queue(id, kGetGroups, "gg_plan", { fmt::to_string(pkeys_buf) });
 }
 
 int
 pg_query::get_groups_resume(int id, pg_result const* r) {
     using namespace internal;
 
-    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get groups failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get groups failed, detail: ${s}", ("s",PQresultErrorMessage(r)));
 
     auto n = PQntuples(r);
     if(n == 0) {
@@ -406,15 +501,14 @@ pg_query::get_fungibles_async(int id, const read_only::get_params& params) {
     auto pkeys_buf = fmt::memory_buffer();
     format_array_to(pkeys_buf, std::begin(params.keys), std::end(params.keys));
 
-    auto stmt = fmt::format(fmt("EXECUTE gf_plan ('{}')"), fmt::to_string(pkeys_buf));
-    return queue(id, kGetFungibles, std::move(stmt));
+    return queue(id, kGetFungibles, "gf_plan", { fmt::to_string(pkeys_buf) });
 }
 
 int
 pg_query::get_fungibles_resume(int id, pg_result const* r) {
     using namespace internal;
 
-    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get fungibles failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get fungibles failed, detail: ${s}", ("s",PQresultErrorMessage(r)));
 
     auto n = PQntuples(r);
     if(n == 0) {
@@ -487,7 +581,10 @@ pg_query::get_actions_async(int id, const read_only::get_actions_params& params)
         jmzk_ASSERT(t <= 20, chain::exceed_query_limit_exception, "Exceed limit of max actions return allowed for each query, limit: 20 per query");
     }
 
-    auto stmt = std::string();
+    auto names_buf = fmt::memory_buffer();
+    if(!params.names.empty()) {
+        format_array_to(names_buf, std::begin(params.names), std::end(params.names));
+    }
 
     int j = 0;
     if(params.dire.has_value() && *params.dire == direction::asc) {
@@ -500,61 +597,36 @@ pg_query::get_actions_async(int id, const read_only::get_actions_params& params)
         j += 4;
     }
 
-    switch(j) {
-    case 0: { // only domain, desc
-        stmt = fmt::format(fmt("EXECUTE ga_plan01 ('{}',{},{});"), (std::string)params.domain, t, s);
-        break;
-    }
-    case 1: { // only domain, asc
-        stmt = fmt::format(fmt("EXECUTE ga_plan02 ('{}',{},{});"), (std::string)params.domain, t, s);
-        break;
-    }
-    case 2: { // domain + key, desc
-        stmt = fmt::format(fmt("EXECUTE ga_plan11 ('{}','{}',{},{});"), (std::string)params.domain, (std::string)*params.key, t, s);
-        break;
-    }
-    case 3: { // domain + key, asc
-        stmt = fmt::format(fmt("EXECUTE ga_plan12 ('{}','{}',{},{});"), (std::string)params.domain, (std::string)*params.key, t, s);
-        break;
-    }
-    case 4: { // domain + name, desc
-        auto names_buf = fmt::memory_buffer();
-        format_array_to(names_buf, std::begin(params.names), std::end(params.names));
-
-        stmt = fmt::format(fmt("EXECUTE ga_plan21 ('{}','{}',{},{});"), (std::string)params.domain, fmt::to_string(names_buf), t, s);
-        break;
-    }
-    case 5: { // domain + name, asc
-        auto names_buf = fmt::memory_buffer();
-        format_array_to(names_buf, std::begin(params.names), std::end(params.names));
-
-        stmt = fmt::format(fmt("EXECUTE ga_plan22 ('{}','{}',{},{});"), (std::string)params.domain, fmt::to_string(names_buf), t, s);
-        break;
-    }
-    case 6: { // domain + key + name, desc
-        auto names_buf = fmt::memory_buffer();
-        format_array_to(names_buf, std::begin(params.names), std::end(params.names));
+    const char* plans[] = {
+        "ga_plan01",  // only domain, desc
+        "ga_plan02",  // only domain, asc
+        "ga_plan11",  // domain + key, desc
+        "ga_plan12",  // domain + key, asc
+        "ga_plan21",  // domain + name, desc
+        "ga_plan22",  // domain + name, asc
+        "ga_plan31",  // domain + key + name, desc
+        "ga_plan32"   // domain + key + name, asc
+    };
 
-        stmt = fmt::format(fmt("EXECUTE ga_plan31 ('{}','{}','{}',{},{});"), (std::string)params.domain, (std::string)*params.key, fmt::to_string(names_buf), t, s);
-        break;
+    auto values = std::vector<std::string>();
+    values.emplace_back((std::string)params.domain);
+    if(params.key.has_value()) {
+        values.emplace_back((std::string)*params.key);
     }
-    case 7: { // domain + key + name, asc
-        auto names_buf = fmt::memory_buffer();
-        format_array_to(names_buf, std::begin(params.names), std::end(params.names));
-
-        stmt = fmt::format(fmt("EXECUTE ga_plan32 ('{}','{}','{}',{},{});"), (std::string)params.domain, (std::string)*params.key, fmt::to_string(names_buf), t, s);
-        break;
+    if(!params.names.empty()) {
+        values.emplace_back(fmt::to_string(names_buf));
     }
-    };  // switch
+    values.emplace_back(std::to_string(t));
+    values.emplace_back(std::to_string(s));
 
-    return queue(id, kGetActions, std::move(stmt));
+    return queue(id, kGetActions, plans[j], std::move(values));
 }
 
 int
 pg_query::get_actions_resume(int id, pg_result const* r) {
     using namespace internal;
 
-    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get actions failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get actions failed, detail: ${s}", ("s",PQresultErrorMessage(r)));
     auto n = PQntuples(r);
     if(n == 0) {
         return response_ok(id, std::string("[]")); // return empty
@@ -631,8 +703,6 @@ pg_query::get_fungible_actions_async(int id, const read_only::get_fungible_actio
         jmzk_ASSERT(t <= 20, chain::exceed_query_limit_exception, "Exceed limit of max actions return allowed for each query, limit: 20 per query");
     }
 
-    auto stmt = std::string();
-
     int j = 0;
     if(params.dire.has_value() && *params.dire == direction::asc) {
         j += 1;
@@ -641,33 +711,31 @@ pg_query::get_fungible_actions_async(int id, const read_only::get_fungible_actio
         j += 2;
     }
 
-    switch(j) {
-    case 0: { // only sym id, desc
-        stmt = fmt::format(fmt("EXECUTE gfa_plan01 ('{}',{},{});"), params.sym_id, t, s);
-        break;
-    }
-    case 1: { // only sym id, asc
-        stmt = fmt::format(fmt("EXECUTE gfa_plan02 ('{}',{},{});"), params.sym_id, t, s);
-        break;
-    }
-    case 2: { // sym id + address, desc
-        stmt = fmt::format(fmt("EXECUTE gfa_plan11 ('{0}','{1}','\"{1}\"',{2},{3});"), params.sym_id, (std::string)*params.addr, t, s);
-        break;
-    }
-    case 3: { // sym id + address, asc
-        stmt = fmt::format(fmt("EXECUTE gfa_plan12 ('{0}','{1}','\"{1}\"',{2},{3});"), params.sym_id, (std::string)*params.addr, t, s);
-        break;
+    const char* plans[] = {
+        "gfa_plan01",  // only sym id, desc
+        "gfa_plan02",  // only sym id, asc
+        "gfa_plan11",  // sym id + address, desc
+        "gfa_plan12"   // sym id + address, asc
+    };
+
+    auto values = std::vector<std::string>();
+    values.emplace_back(fmt::format("{}", params.sym_id));
+    if(params.addr.has_value()) {
+        auto addr = (std::string)*params.addr;
+        values.emplace_back(addr);
+        values.emplace_back(fmt::format("\"{}\"", addr));  // jsonb string for link keys
     }
-    };  // switch
+    values.emplace_back(std::to_string(t));
+    values.emplace_back(std::to_string(s));
 
-    return queue(id, kGetFungibleActions, std::move(stmt));
+    return queue(id, kGetFungibleActions, plans[j], std::move(values));
 }
 
 int
 pg_query::get_fungible_actions_resume(int id, pg_result const* r) {
     using namespace internal;
 
-    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get fungible actions failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get fungible actions failed, detail: ${s}", ("s",PQresultErrorMessage(r)));
 
     auto n = PQntuples(r);
     if(n == 0) {
@@ -702,8 +770,7 @@ int
 pg_query::get_fungibles_balance_async(int id, const read_only::get_fungibles_balance_params& params) {
     using namespace internal;
 
-    auto stmt = fmt::format(fmt("EXECUTE gfb_plan('{}');"), (std::string)params.addr);
-    return queue(id, kGetFungiblesBalance, std::move(stmt));
+    return queue(id, kGetFungiblesBalance, "gfb_plan", { (std::string)params.addr });
 }
 
 #define READ_DB_ASSET(ADDR, SYM_ID, VALUEREF)                                                         \
@@ -723,7 +790,7 @@ pg_query::get_fungibles_balance_resume(int id, pg_result const* r) {
     using namespace boost::algorithm;
     using namespace chain;
 
-    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get transaction failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get transaction failed, detail: ${s}", ("s",PQresultErrorMessage(r)));
 
     auto n = PQntuples(r);
     if(n == 0) {
@@ -759,15 +826,14 @@ int
 pg_query::get_transaction_async(int id, const read_only::get_transaction_params& params) {
     using namespace internal;
 
-    auto stmt = fmt::format(fmt("EXECUTE gtrx_plan('{}');"), (std::string)params.id);
-    return queue(id, kGetTransaction, std::move(stmt));
+    return queue(id, kGetTransaction, "gtrx_plan", { (std::string)params.id });
 }
 
 int
 pg_query::get_transaction_resume(int id, pg_result const* r) {
     using namespace internal;
 
-    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get transaction failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get transaction failed, detail: ${s}", ("s",PQresultErrorMessage(r)));
 
     auto n = PQntuples(r);
     if(n == 0) {
@@ -819,22 +885,19 @@ pg_query::get_transactions_async(int id, const read_only::get_transactions_param
     auto keys_buf = fmt::memory_buffer();
     format_array_to(keys_buf, std::begin(params.keys), std::end(params.keys));
 
-    auto stmt = std::string();
+    auto plan = "gtrxs_plan1";
     if(params.dire.has_value() && *params.dire == direction::asc) {
-        stmt = fmt::format(fmt("EXECUTE gtrxs_plan0('{}',{},{});"), fmt::to_string(keys_buf), t, s);
-    }
-    else {
-        stmt = fmt::format(fmt("EXECUTE gtrxs_plan1('{}',{},{});"), fmt::to_string(keys_buf), t, s);
+        plan = "gtrxs_plan0";
     }
 
-    return queue(id, kGetTransactions, std::move(stmt));
+    return queue(id, kGetTransactions, plan, { fmt::to_string(keys_buf), std::to_string(t), std::to_string(s) });
 }
 
 int
 pg_query::get_transactions_resume(int id, pg_result const* r) {
     using namespace internal;
 
-    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get transaction failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get transaction failed, detail: ${s}", ("s",PQresultErrorMessage(r)));
 
     auto n = PQntuples(r);
     if(n == 0) {
@@ -885,15 +948,14 @@ pg_query::get_fungible_ids_async(int id, const read_only::get_fungible_ids_param
         jmzk_ASSERT(t <= 100, chain::exceed_query_limit_exception, "Exceed limit of max actions return allowed for each query, limit: 100 per query");
     }
 
-    auto stmt = fmt::format(fmt("EXECUTE gfi_plan({},{});"), t, s);
-    return queue(id, kGetFungibleIds, std::move(stmt));
+    return queue(id, kGetFungibleIds, "gfi_plan", { std::to_string(t), std::to_string(s) });
 }
 
 int
 pg_query::get_fungible_ids_resume(int id, pg_result const* r) {
     using namespace internal;
 
-    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get fungible ids failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get fungible ids failed, detail: ${s}", ("s",PQresultErrorMessage(r)));
 
     auto n = PQntuples(r);
     if(n == 0) {
@@ -924,15 +986,14 @@ int
 pg_query::get_transaction_actions_async(int id, const read_only::get_transaction_actions_params& params) {
     using namespace internal;
 
-    auto stmt = fmt::format(fmt("EXECUTE gta_plan('{}');"), (std::string)params.id);
-    return queue(id, kGetTransactionActions, std::move(stmt));
+    return queue(id, kGetTransactionActions, "gta_plan", { (std::string)params.id });
 }
 
 int
 pg_query::get_transaction_actions_resume(int id, pg_result const* r) {
     using namespace internal;
 
-    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get transaction actions failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_query_exception, "Get transaction actions failed, detail: ${s}", ("s",PQresultErrorMessage(r)));
 
     auto n = PQntuples(r);
     if(n == 0) {
@@ -13,19 +13,29 @@ static appbase::abstract_plugin& _history_plugin = app().register_plugin<history
 
 class history_plugin_impl {
 public:
-    history_plugin_impl()
-        : pg_query_(app().get_io_service(), app().get_plugin<chain_plugin>().chain()) {
-        pg_query_.connect(app().get_plugin<postgres_plugin>().connstr());
-        pg_query_.prepare_stmts();
-        pg_query_.begin_poll_read();
-    }
+    history_plugin_impl(size_t connections, size_t threads)
+        : connections_(connections), threads_(threads) {}
 
     ~history_plugin_impl() {
-        pg_query_.close();
+        if(pg_query_) {
+            pg_query_->close();
+        }
+    }
+
+public:
+    void
+    start() {
+        pg_query_.emplace(app().get_io_service(), app().get_plugin<chain_plugin>().chain(), connections_, threads_);
+        pg_query_->connect(app().get_plugin<postgres_plugin>().connstr());
+        pg_query_->prepare_stmts();
+        pg_query_->begin_poll_read();
     }
 
 public:
-    pg_query pg_query_;
+    size_t connections_;
+    size_t threads_;
+
+    std::optional<pg_query> pg_query_;  // only present when postgres is enabled
 };
 
 history_plugin::history_plugin() {}
@@ -33,16 +43,25 @@ history_plugin::~history_plugin() {}
 
 void
 history_plugin::set_program_options(options_description& cli, options_description& cfg) {
+    cfg.add_options()
+        ("history-pg-connections", bpo::value<uint16_t>()->default_value(4), "Number of postgres connections used to serve history queries")
+        ("history-threads", bpo::value<uint16_t>()->default_value(2), "Number of worker threads used to decode query results, 0 for main thread")
+        ;
 }
 
 void
 history_plugin::plugin_initialize(const variables_map& options) {
+    auto connections = options.at("history-pg-connections").as<uint16_t>();
+    auto threads     = options.at("history-threads").as<uint16_t>();
+
+    jmzk_ASSERT(connections > 0, chain::plugin_config_exception, "history-pg-connections should be greater than 0");
+    my_.reset(new history_plugin_impl(connections, threads));
 }
 
 void
 history_plugin::plugin_startup() {
     if(app().get_plugin<postgres_plugin>().enabled()) {
-        my_.reset(new history_plugin_impl());
+        my_->start();
     }
     else {
         wlog("jmzk::postgres_plugin configured, but no --postgres-uri specified.");
@@ -58,79 +77,79 @@ namespace history_apis {
 
 void
 read_only::get_tokens_async(int id, const get_tokens_params& params) {
-    jmzk_ASSERT(plugin_.my_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
+    jmzk_ASSERT(plugin_.my_->pg_query_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
 
-    plugin_.my_->pg_query_.get_tokens_async(id, params);
+    plugin_.my_->pg_query_->get_tokens_async(id, params);
 }
 
 void
 read_only::get_domains_async(int id, const get_params& params) {
-    jmzk_ASSERT(plugin_.my_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
+    jmzk_ASSERT(plugin_.my_->pg_query_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
 
-    plugin_.my_->pg_query_.get_domains_async(id, params);
+    plugin_.my_->pg_query_->get_domains_async(id, params);
 }
 
 void
 read_only::get_groups_async(int id, const get_params& params) {
-    jmzk_ASSERT(plugin_.my_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
+    jmzk_ASSERT(plugin_.my_->pg_query_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
 
-    plugin_.my_->pg_query_.get_groups_async(id, params);
+    plugin_.my_->pg_query_->get_groups_async(id, params);
 }
 
 void
 read_only::get_fungibles_async(int id, const get_params& params) {
-    jmzk_ASSERT(plugin_.my_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
+    jmzk_ASSERT(plugin_.my_->pg_query_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
 
-    plugin_.my_->pg_query_.get_fungibles_async(id, params);
+    plugin_.my_->pg_query_->get_fungibles_async(id, params);
 }
 
 void
 read_only::get_actions_async(int id, const get_actions_params& params) {
-    jmzk_ASSERT(plugin_.my_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
+    jmzk_ASSERT(plugin_.my_->pg_query_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
 
-    plugin_.my_->pg_query_.get_actions_async(id, params);
+    plugin_.my_->pg_query_->get_actions_async(id, params);
 }
 
 void
 read_only::get_fungible_actions_async(int id, const get_fungible_actions_params& params) {
-    jmzk_ASSERT(plugin_.my_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
+    jmzk_ASSERT(plugin_.my_->pg_query_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
 
-    plugin_.my_->pg_query_.get_fungible_actions_async(id, params);
+    plugin_.my_->pg_query_->get_fungible_actions_async(id, params);
 }
 
 void
 read_only::get_fungibles_balance_async(int id, const get_fungibles_balance_params& params) {
-    jmzk_ASSERT(plugin_.my_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
+    jmzk_ASSERT(plugin_.my_->pg_query_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
 
-    plugin_.my_->pg_query_.get_fungibles_balance_async(id, params);
+    plugin_.my_->pg_query_->get_fungibles_balance_async(id, params);
 }
 
 void
 read_only::get_transaction_async(int id, const get_transaction_params& params) {
-    jmzk_ASSERT(plugin_.my_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
+    jmzk_ASSERT(plugin_.my_->pg_query_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
 
-    plugin_.my_->pg_query_.get_transaction_async(id, params);
+    plugin_.my_->pg_query_->get_transaction_async(id, params);
 }
 
 void
 read_only::get_transactions_async(int id, const get_transactions_params& params) {
-    jmzk_ASSERT(plugin_.my_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
+    jmzk_ASSERT(plugin_.my_->pg_query_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
 
-    plugin_.my_->pg_query_.get_transactions_async(id, params);
+    plugin_.my_->pg_query_->get_transactions_async(id, params);
 }
 
 void
 read_only::get_fungible_ids_async(int id, const get_fungible_ids_params& params) {
-    jmzk_ASSERT(plugin_.my_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
+    jmzk_ASSERT(plugin_.my_->pg_query_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
 
-    plugin_.my_->pg_query_.get_fungible_ids_async(id, params);
+    plugin_.my_->pg_query_->get_fungible_ids_async(id, params);
 }
 
 void
 read_only::get_transaction_actions_async(int id, const get_transaction_actions_params& params) {
-    jmzk_ASSERT(plugin_.my_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
+    jmzk_ASSERT(plugin_.my_->pg_query_, chain::postgres_not_enabled_exception, "Postgres plugin is not enabled.");
 
-    plugin_.my_->pg_query_.get_transaction_actions_async(id, params);
+    plugin_.my_->pg_query_->get_transaction_actions_async(id, params);
 }
 
 }}  // namespace jmzk::history_apis
@@ -3,11 +3,16 @@
  *  @copyright defined in jmzk/LICENSE.txt
  */
 #pragma once
+#include <deque>
+#include <memory>
+#include <optional>
 #include <queue>
 #include <string>
+#include <vector>
 #include <boost/noncopyable.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/thread_pool.hpp>
 #include <jmzk/chain/block_state.hpp>
 #include <jmzk/chain/transaction.hpp>
 #include <jmzk/chain/contracts/types.hpp>
@@ -32,22 +37,43 @@ using namespace jmzk::history_apis;
 #define PG_FAIL 0
 
 
+/**
+ *  Queries are spread over a pool of connections with prepared statements.
+ *  Each connection runs in pipeline mode when libpq supports it, so several queries can be in flight on it.
+ *  Results are decoded on a thread pool, the ones need to read chain state are decoded on main thread.
+ */
 class pg_query : boost::noncopyable {
 private:
     struct task {
     public:
-        task(int id, int type, std::string&& stmt)
-            : id(id), type(type), stmt(std::move(stmt)) {}
+        task(int id, int type, const char* plan, std::vector<std::string>&& params)
+            : id(id), type(type), plan(plan), params(std::move(params)) {}
+
+    public:
+        int                      id;
+        int                      type;
+        const char*              plan;
+        std::vector<std::string> params;
+    };
+
+    struct connection {
+    public:
+        connection(boost::asio::io_context& io_serv)
+            : conn(nullptr), pipeline(false), result(nullptr), socket(io_serv) {}
 
     public:
-        int         id;
-        int         type;
-        std::string stmt;
+        pg_conn*                     conn;
+        bool                         pipeline;
+        std::deque<task>             sent;    // sent and waiting for results, in order
+        pg_result*                   result;  // result of the front task in sent
+        boost::asio::ip::tcp::socket socket;
     };
 
+    static constexpr size_t kMaxPipelineDepth = 16;
+
 public:
-    pg_query(boost::asio::io_context& io_serv, controller& chain)
-        : conn_(nullptr), sending_(false), io_serv_(io_serv), chain_(chain), socket_(io_serv) {}
+    pg_query(boost::asio::io_context& io_serv, controller& chain, size_t connections, size_t threads);
+    ~pg_query();
 
 public:
     int connect(const std::string& conn);
@@ -90,18 +116,20 @@ public:
     int get_transaction_actions_resume(int id, pg_result const*);
 
 private:
-    int queue(int id, int task, std::string&& stmt);
-    int poll_read();
-    int send_once();
+    int  queue(int id, int type, const char* plan, std::vector<std::string>&& params);
+    void dispatch();
+    int  poll_read(connection& c);
+    int  send_once(connection& c, task&& t);
+    void decode(task&& t, pg_result* r);
+    void resume(const task& t, pg_result const* r);
 
 private:
-    pg_conn* conn_;
+    std::vector<std::unique_ptr<connection>> conns_;
+    std::queue<task>                         tasks_;  // waiting for a connection to have room
+    boost::asio::io_context&                 io_serv_;
+    chain::controller&                       chain_;
 
-    bool                         sending_;
-    std::queue<task>             tasks_;
-    boost::asio::io_context&     io_serv_;
-    chain::controller&           chain_;
-    boost::asio::ip::tcp::socket socket_;
+    std::optional<boost::asio::thread_pool> thread_pool_;
 };
 
 }  // namespace jmzk
\ No newline at end of file
@@ -113,6 +113,7 @@ public:
     map<string, url_handler>          url_handlers;
     map<string, url_handler>          url_local_handlers;
     map<string, url_deferred_handler> url_deferred_handlers;
+    set<string>                       url_read_only;
     optional<tcp::endpoint>           listen_endpoint;
     string                            access_control_allow_origin;
     string                            access_control_allow_headers;
@@ -137,6 +138,9 @@ public:
     std::atomic<int64_t>                     bytes_in_flight{0};
     int64_t                                  max_bytes_in_flight = 0;
 
+    uint16_t                                 read_only_threads = 0;
+    optional<boost::asio::thread_pool>       read_only_pool;
+
     optional<tcp::endpoint> https_listen_endpoint;
     string                  https_cert_chain;
     string                  https_key;
@@ -349,29 +353,37 @@ public:
                 if(handler_itr != url_handlers.cend()) {
                     con->defer_http_response();
                     bytes_in_flight += body.size();
-                    app().post(appbase::priority::low,
-                        [this, ioc = this->server_ioc, handler_itr, resource{std::move(resource)}, body{std::move(body)}, con] {
-                            this->bytes_in_flight -= body.size();
-                            try {
-                                handler_itr->second(resource, body,
-                                    [this, ioc{std::move(ioc)}, con](auto code, auto response_body) {
-                                        this->bytes_in_flight += response_body.size();
-                                        boost::asio::post(*ioc, [this, response_body{std::move(response_body)}, con, code]() {
-                                            size_t body_size = response_body.size();
-                                            if(!this->http_no_response) {
-                                                con->set_body(std::move(response_body));
-                                            }
-                                            con->set_status(websocketpp::http::status_code::value(code));
-                                            con->send_http_response();
-                                            this->bytes_in_flight -= body_size;
-                                        });
+
+                    // read-only handlers are served by worker pool instead of main thread
+                    auto read_only = read_only_pool.has_value() && url_read_only.count(resource);
+                    auto task = [this, ioc = this->server_ioc, handler_itr, resource{std::move(resource)}, body{std::move(body)}, con] {
+                        this->bytes_in_flight -= body.size();
+                        try {
+                            handler_itr->second(resource, body,
+                                [this, ioc{std::move(ioc)}, con](auto code, auto response_body) {
+                                    this->bytes_in_flight += response_body.size();
+                                    boost::asio::post(*ioc, [this, response_body{std::move(response_body)}, con, code]() {
+                                        size_t body_size = response_body.size();
+                                        if(!this->http_no_response) {
+                                            con->set_body(std::move(response_body));
+                                        }
+                                        con->set_status(websocketpp::http::status_code::value(code));
+                                        con->send_http_response();
+                                        this->bytes_in_flight -= body_size;
                                     });
-                            }
-                            catch(...) {
-                                handle_exception<T>(con);
-                                con->send_http_response();
-                            }
-                        });
+                                });
+                        }
+                        catch(...) {
+                            handle_exception<T>(con);
+                            con->send_http_response();
+                        }
+                    };
+                    if(read_only) {
+                        boost::asio::post(*read_only_pool, std::move(task));
+                    }
+                    else {
+                        app().post(appbase::priority::low, std::move(task));
+                    }
                     return;
                 }
             }
@@ -563,6 +575,8 @@ http_plugin::set_program_options(options_description&, options_description& cfg)
         ("http-alias", bpo::value<std::vector<string>>()->composing(),
             "Additionaly acceptable values for the \"Host\" header of incoming HTTP requests, can be specified multiple times.  Includes http/s_server_address by default.")
         ("http-no-response", bpo::bool_switch()->default_value(false), "special for load-testing, response all the requests with empty body")
+        ("http-read-only-threads", bpo::value<uint16_t>()->default_value(0),
+            "Number of worker threads serving read-only APIs, these APIs are served by main thread if it's 0")
         ;
 }
 
@@ -650,6 +664,11 @@ http_plugin::plugin_initialize(const variables_map& options) {
         my->max_deferred_connection_size = options.at("max-deferred-connection-size").as<uint32_t>();
         my->http_no_response             = options.at("http-no-response").as<bool>();
         verbose_http_errors              = options.at("verbose-http-errors").as<bool>();
+        my->read_only_threads            = options.at("http-read-only-threads").as<uint16_t>();
+
+        if(my->read_only_threads > 0) {
+            my->read_only_pool.emplace(my->read_only_threads);
+        }
 
         FC_ASSERT(my->max_deferred_connection_size < (uint32_t)std::numeric_limits<int32_t>::max());
 
@@ -772,6 +791,10 @@ http_plugin::plugin_shutdown() {
     if(my->https_server.is_listening()) {
         my->https_server.stop_listening();
     }
+    if(my->read_only_pool.has_value()) {
+        my->read_only_pool->join();
+        my->read_only_pool->stop();
+    }
     if(my->server_ioc_work.has_value()) {
         my->server_ioc_work->reset();
     }
@@ -803,6 +826,18 @@ http_plugin::add_handler(const string& url, const url_handler& handler, bool loc
     }
 }
 
+void
+http_plugin::add_read_only_handler(const string& url, const url_handler& handler) {
+    ilog("add read-only api url: ${c}", ("c", url));
+    my->url_handlers.insert(std::make_pair(url, handler));
+    my->url_read_only.insert(url);
+}
+
+uint16_t
+http_plugin::read_only_threads() const {
+    return my->read_only_threads;
+}
+
 void
 http_plugin::add_deferred_handler(const string& url, const url_deferred_handler& handler) {
     ilog("add deferred api url: ${c}", ("c", url));
@@ -104,6 +104,10 @@ public:
     void add_handler(const string& url, const url_handler&, bool local_only = false);
     void add_deferred_handler(const string& url, const url_deferred_handler&);
 
+    // read-only handlers are called from worker threads when `http-read-only-threads` is set,
+    // they should not touch any state owned by main thread
+    void add_read_only_handler(const string& url, const url_handler&);
+
     void
     add_api(const api_description& api, bool local_only = false) {
         for(const auto& call : api) {
@@ -111,6 +115,13 @@ public:
         }
     }
 
+    void
+    add_read_only_api(const api_description& api) {
+        for(const auto& call : api) {
+            add_read_only_handler(call.first, call.second);
+        }
+    }
+
     void
     add_async_api(const async_api_description& api) {
         for(const auto& call : api) {
@@ -129,6 +140,8 @@ public:
 
     bool verbose_errors() const;
 
+    uint16_t read_only_threads() const;
+
     struct get_supported_apis_result {
         vector<string> apis;
     };
@@ -10,6 +10,9 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/host_name.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/thread_pool.hpp>
 
 #include <fc/network/message_buffer.hpp>
 #include <fc/network/ip.hpp>
@@ -25,6 +28,7 @@
 #include <jmzk/chain/exceptions.hpp>
 #include <jmzk/chain/block.hpp>
 #include <jmzk/chain/plugin_interface.hpp>
+#include <jmzk/chain/transaction_metadata_cache.hpp>
 #include <jmzk/chain/multi_index_includes.hpp>
 #include <jmzk/producer_plugin/producer_plugin.hpp>
 
@@ -159,6 +163,11 @@ public:
     std::shared_ptr<boost::asio::io_context> server_ioc;
     optional<io_work_t>                      server_ioc_work;
 
+    // worker threads used to unpack incoming messages off the main thread
+    uint16_t                                 thread_pool_size = 0;
+    optional<boost::asio::thread_pool>       thread_pool;
+    bool                                     recover_keys = false;
+
     void connect(const connection_ptr& c);
     void connect(const connection_ptr& c, tcp::resolver::iterator endpoint_itr);
     bool start_session(const connection_ptr& c);
@@ -175,6 +184,16 @@ public:
      */
     bool process_next_message(const connection_ptr& conn, uint32_t message_length);
 
+    /** \brief Unpack the next message on net thread pool
+     *
+     * Copies the message out of pending_message_buffer and unpacks it
+     * on the net thread pool, blocks and transactions are fully formed
+     * there. Messages of one connection are unpacked in order and the
+     * results are handed to main thread in the same order.
+     */
+    void decode_next_message(const connection_ptr& conn, uint32_t message_length);
+    void post_known_block(const connection_ptr& conn, const block_id_type& blk_id, uint32_t blk_num);
+
     void   close(const connection_ptr& c);
     size_t count_open_sockets() const;
 
@@ -209,8 +228,10 @@ public:
     void handle_message(const connection_ptr& c, const sync_request_message& msg);
     void handle_message(const connection_ptr& c, const signed_block& msg) = delete;  // signed_block_ptr overload used instead
     void handle_message(const connection_ptr& c, const signed_block_ptr& msg);
+    void accept_block(const connection_ptr& c, const signed_block_ptr& msg);
     void handle_message(const connection_ptr& c, const packed_transaction& msg) = delete;  // packed_transaction_ptr overload used instead
     void handle_message(const connection_ptr& c, const packed_transaction_ptr& msg);
+    void handle_message(const connection_ptr& c, const transaction_metadata_ptr& msg);
 
     void start_conn_timer(boost::asio::steady_timer::duration du, std::weak_ptr<connection> from_connection);
     void start_txn_timer();
@@ -306,6 +327,8 @@ constexpr auto                              def_conn_retry_wait          = 30;
 constexpr auto                              def_txn_expire_wait          = std::chrono::seconds(3);
 constexpr auto                              def_resp_expected_wait       = std::chrono::seconds(5);
 constexpr auto                              def_sync_fetch_span          = 100;
+constexpr auto                              def_sync_max_inflight        = 4;
+constexpr auto                              def_net_threads              = 2;
 
 constexpr auto     message_header_size = 4;
 constexpr uint32_t signed_block_which = 7;        // see protocol net_message
@@ -497,6 +520,9 @@ public:
     boost::asio::io_context::strand          strand;
     socket_ptr                               socket;
 
+    // keeps messages of this connection in order while unpacked on net thread pool
+    optional<boost::asio::strand<boost::asio::thread_pool::executor_type>> decode_strand;
+
     fc::message_buffer<1024 * 1024> pending_message_buffer;
     std::optional<std::size_t>      outstanding_read_bytes;
 
@@ -663,30 +689,52 @@ private:
         in_sync
     };
 
+    // range of blocks requested from one peer, conn is empty when the span waits for a new peer
+    struct sync_span {
+        uint32_t       start;
+        uint32_t       end;
+        uint32_t       last;  // last block received in this span
+        connection_ptr conn;
+    };
+
+    using buffered_block = std::pair<connection_ptr, signed_block_ptr>;
+
     uint32_t       sync_known_lib_num;
     uint32_t       sync_last_requested_num;
     uint32_t       sync_next_expected_num;
     uint32_t       sync_req_span;
-    connection_ptr source;
+    uint32_t       sync_max_inflight;
     stages         state;
 
+    std::map<uint32_t, sync_span>      spans;        // spans not received yet, keyed by start block
+    std::map<uint32_t, buffered_block> sync_buffer;  // blocks received ahead of sync_next_expected_num
+
     chain_plugin* chain_plug = nullptr;
 
     constexpr auto stage_str(stages s);
 
+    std::map<uint32_t, sync_span>::iterator find_span(const connection_ptr& c);
+    uint32_t sync_window_end() const;
+    bool can_request_span() const;
+    bool assign_span(const connection_ptr& c);
+    void recv_span_block(const connection_ptr& c, uint32_t blk_num);
+    void reset_spans(const connection_ptr& skip = connection_ptr());
+
 public:
-    explicit sync_manager(uint32_t span);
+    sync_manager(uint32_t span, uint32_t max_inflight);
     void set_state(stages s);
     bool sync_required();
     void send_handshakes();
     bool is_active(const connection_ptr& conn);
     void reset_lib_num(const connection_ptr& conn);
-    void request_next_chunk(const connection_ptr& conn = connection_ptr());
+    void request_next_chunk(const connection_ptr& conn = connection_ptr(), const connection_ptr& skip = connection_ptr());
     void start_sync(const connection_ptr& c, uint32_t target);
     void reassign_fetch(const connection_ptr& c, go_away_reason reason);
     void verify_catchup(const connection_ptr& c, uint32_t num, const block_id_type& id);
     void rejected_block(const connection_ptr& c, uint32_t blk_num);
     void recv_block(const connection_ptr& c, const block_id_type& blk_id, uint32_t blk_num);
+    bool recv_sync_block(const connection_ptr& c, const signed_block_ptr& blk);
+    bool next_sync_block(connection_ptr& c, signed_block_ptr& blk);
     void recv_handshake(const connection_ptr& c, const handshake_message& msg);
     void recv_notice(const connection_ptr& c, const notice_message& msg);
 };
@@ -769,6 +817,9 @@ connection::initialize() {
     rnd[0]    = 0;
     response_expected.reset(new boost::asio::steady_timer(*my_impl->server_ioc));
     read_delay_timer.reset(new boost::asio::steady_timer(*my_impl->server_ioc));
+    if(my_impl->thread_pool.has_value()) {
+        decode_strand.emplace(my_impl->thread_pool->get_executor());
+    }
 }
 
 bool
@@ -1231,12 +1282,12 @@ connection::peer_has_block(const block_id_type& blkid) {
 
 //-----------------------------------------------------------
 
-sync_manager::sync_manager(uint32_t req_span)
+sync_manager::sync_manager(uint32_t req_span, uint32_t max_inflight)
     : sync_known_lib_num(0)
     , sync_last_requested_num(0)
     , sync_next_expected_num(1)
     , sync_req_span(req_span)
-    , source()
+    , sync_max_inflight(max_inflight)
     , state(in_sync) {
     chain_plug = app().find_plugin<chain_plugin>();
     jmzk_ASSERT(chain_plug, chain::missing_chain_plugin_exception, "");
@@ -1279,16 +1330,17 @@ sync_manager::is_active(const connection_ptr& c) {
 void
 sync_manager::reset_lib_num(const connection_ptr& c) {
     if(state == in_sync) {
-        source.reset();
+        reset_spans();
     }
     if(c->current()) {
         if(c->last_handshake_recv.last_irreversible_block_num > sync_known_lib_num) {
             sync_known_lib_num = c->last_handshake_recv.last_irreversible_block_num;
         }
     }
-    else if(c == source) {
-        sync_last_requested_num = 0;
-        request_next_chunk();
+    else if(auto it = find_span(c); it != spans.end()) {
+        // peer is gone, hand its span over to another one
+        it->second.conn.reset();
+        request_next_chunk(connection_ptr(), c);
     }
 }
 
@@ -1300,88 +1352,94 @@ sync_manager::sync_required() {
     return (sync_last_requested_num < sync_known_lib_num || chain_plug->chain().fork_db_head_block_num() < sync_last_requested_num);
 }
 
-void
-sync_manager::request_next_chunk(const connection_ptr& conn) {
-    uint32_t head_block = chain_plug->chain().fork_db_head_block_num();
+std::map<uint32_t, sync_manager::sync_span>::iterator
+sync_manager::find_span(const connection_ptr& c) {
+    return std::find_if(spans.begin(), spans.end(), [&c](auto& s) { return s.second.conn == c; });
+}
 
-    if(head_block < sync_last_requested_num && source && source->current()) {
-        fc_ilog(logger, "ignoring request, head is ${h} last req = ${r} source is ${p}",
-                ("h", head_block)("r", sync_last_requested_num)("p", source->peer_name()));
-        return;
-    }
+// last block the reorder buffer accepts, spans never end after it
+uint32_t
+sync_manager::sync_window_end() const {
+    return sync_next_expected_num + sync_req_span * sync_max_inflight - 1;
+}
 
-    /* ----------
-     * next chunk provider selection criteria
-     * a provider is supplied and able to be used, use it.
-     * otherwise select the next available from the list, round-robin style.
-     */
+bool
+sync_manager::can_request_span() const {
+    // new spans are limited to a window after next expected block, which also bounds the reorder buffer
+    return spans.size() < sync_max_inflight
+        && sync_last_requested_num < sync_known_lib_num
+        && sync_last_requested_num < sync_window_end();
+}
 
-    if(conn && conn->current()) {
-        source = conn;
+bool
+sync_manager::assign_span(const connection_ptr& c) {
+    if(!c->current() || find_span(c) != spans.end()) {
+        return false;
     }
-    else {
-        if(my_impl->connections.size() == 1) {
-            if(!source) {
-                source = *my_impl->connections.begin();
-            }
+
+    // spans given up by other peers come first, they block the next expected block
+    auto it = std::find_if(spans.begin(), spans.end(), [](auto& s) { return !s.second.conn; });
+    if(it == spans.end()) {
+        if(!can_request_span()) {
+            return false;
         }
-        else {
-            // init to a linear array search
-            auto cptr = my_impl->connections.begin();
-            auto cend = my_impl->connections.end();
-            // do we remember the previous source?
-            if(source) {
-                //try to find it in the list
-                cptr = my_impl->connections.find(source);
-                cend = cptr;
-                if(cptr == my_impl->connections.end()) {
-                    //not there - must have been closed! cend is now connections.end, so just flatten the ring.
-                    source.reset();
-                    cptr = my_impl->connections.begin();
-                }
-                else {
-                    //was found - advance the start to the next. cend is the old source.
-                    if(++cptr == my_impl->connections.end() && cend != my_impl->connections.end()) {
-                        cptr = my_impl->connections.begin();
-                    }
-                }
-            }
+        uint32_t start = std::max(sync_last_requested_num + 1, sync_next_expected_num);
+        uint32_t end   = std::min({start + sync_req_span - 1, sync_known_lib_num, sync_window_end()});
+        if(end == 0 || end < start) {
+            return false;
+        }
+        it = spans.emplace(start, sync_span{start, end, start - 1, connection_ptr()}).first;
+        sync_last_requested_num = end;
+    }
 
-            //scan the list of peers looking for another able to provide sync blocks.
-            auto cstart_it = cptr;
-            do {
-                //select the first one which is current and break out.
-                if((*cptr)->current()) {
-                    source = *cptr;
-                    break;
-                }
-                if(++cptr == my_impl->connections.end())
-                    cptr = my_impl->connections.begin();
-            } while(cptr != cstart_it);
-            // no need to check the result, either source advanced or the whole list was checked and the old source is reused.
+    auto& span = it->second;
+    span.conn  = c;
+    fc_ilog(logger, "requesting range ${s} to ${e}, from ${n}",
+            ("n", c->peer_name())("s", span.last + 1)("e", span.end));
+    c->request_sync_blocks(span.last + 1, span.end);
+    return true;
+}
+
+void
+sync_manager::reset_spans(const connection_ptr& skip) {
+    for(auto& it : spans) {
+        auto& conn = it.second.conn;
+        if(conn && conn != skip) {
+            conn->cancel_sync(benign_other);
         }
     }
+    spans.clear();
+    sync_buffer.clear();
+}
+
+void
+sync_manager::request_next_chunk(const connection_ptr& conn, const connection_ptr& skip) {
+    /* ----------
+     * chunk provider selection criteria
+     * a provider is supplied and able to be used, use it first.
+     * then every other current peer without a span gets one, until sync_max_inflight spans are requested.
+     * the skipped peer (which just failed a span) is only used when no other peer takes it.
+     */
+    if(conn && conn != skip) {
+        assign_span(conn);
+    }
+    for(auto& c : my_impl->connections) {
+        if(c != skip) {
+            assign_span(c);
+        }
+    }
+    if(skip) {
+        assign_span(skip);
+    }
 
     // verify there is an available source
-    if(!source || !source->current()) {
+    auto assigned = std::any_of(spans.begin(), spans.end(), [](auto& s) { return (bool)s.second.conn; });
+    if(!assigned && (!spans.empty() || sync_last_requested_num < sync_known_lib_num)) {
         fc_elog(logger, "Unable to continue syncing at this time");
         sync_known_lib_num      = chain_plug->chain().last_irreversible_block_num();
         sync_last_requested_num = 0;
+        reset_spans();
         set_state(in_sync);  // probably not, but we can't do anything else
-        return;
-    }
-
-    if(sync_last_requested_num != sync_known_lib_num) {
-        uint32_t start = sync_next_expected_num;
-        uint32_t end   = start + sync_req_span - 1;
-        if(end > sync_known_lib_num)
-            end = sync_known_lib_num;
-        if(end > 0 && end >= start) {
-            fc_ilog(logger, "requesting range ${s} to ${e}, from ${n}",
-                    ("n", source->peer_name())("s", start)("e", end));
-            source->request_sync_blocks(start, end);
-            sync_last_requested_num = end;
-        }
     }
 }
 
@@ -1410,7 +1468,9 @@ sync_manager::start_sync(const connection_ptr& c, uint32_t target) {
 
     if(state == in_sync) {
         set_state(lib_catchup);
-        sync_next_expected_num = chain_plug->chain().last_irreversible_block_num() + 1;
+        sync_next_expected_num  = chain_plug->chain().last_irreversible_block_num() + 1;
+        sync_last_requested_num = sync_next_expected_num - 1;
+        reset_spans();
     }
 
     fc_ilog(logger, "Catching up with chain, our last req is ${cc}, theirs is ${t} peer ${p}",
@@ -1424,10 +1484,10 @@ sync_manager::reassign_fetch(const connection_ptr& c, go_away_reason reason) {
     fc_ilog(logger, "reassign_fetch, our last req is ${cc}, next expected is ${ne} peer ${p}",
             ("cc", sync_last_requested_num)("ne", sync_next_expected_num)("p", c->peer_name()));
 
-    if(c == source) {
+    if(auto it = find_span(c); it != spans.end()) {
         c->cancel_sync(reason);
-        sync_last_requested_num = 0;
-        request_next_chunk();
+        it->second.conn.reset();
+        request_next_chunk(connection_ptr(), c);
     }
 }
 
@@ -1561,7 +1621,7 @@ sync_manager::rejected_block(const connection_ptr& c, uint32_t blk_num) {
     if(state != in_sync) {
         fc_ilog(logger, "block ${bn} not accepted from ${p}", ("bn", blk_num)("p", c->peer_name()));
         sync_last_requested_num = 0;
-        source.reset();
+        reset_spans(c);
         my_impl->close(c);
         set_state(in_sync);
         send_handshakes();
@@ -1571,6 +1631,11 @@ void
 sync_manager::recv_block(const connection_ptr& c, const block_id_type& blk_id, uint32_t blk_num) {
     fc_dlog(logger, "got block ${bn} from ${p}", ("bn", blk_num)("p", c->peer_name()));
     if(state == lib_catchup) {
+        if(blk_num < sync_next_expected_num) {
+            // already applied, duplicate of a span which was reassigned
+            recv_span_block(c, blk_num);
+            return;
+        }
         if(blk_num != sync_next_expected_num) {
             fc_ilog(logger, "expected block ${ne} but got ${bn}", ("ne", sync_next_expected_num)("bn", blk_num));
             my_impl->close(c);
@@ -1581,7 +1646,6 @@ sync_manager::recv_block(const connection_ptr& c, const block_id_type& blk_id, u
     if(state == head_catchup) {
         fc_dlog(logger, "sync_manager in head_catchup state");
         set_state(in_sync);
-        source.reset();
 
         block_id_type null_id;
         for(const auto& cp : my_impl->connections) {
@@ -1604,19 +1668,90 @@ sync_manager::recv_block(const connection_ptr& c, const block_id_type& blk_id, u
     else if(state == lib_catchup) {
         if(blk_num == sync_known_lib_num) {
             fc_dlog(logger, "All caught up with last known last irreversible block resending handshake");
+            reset_spans();
             set_state(in_sync);
             send_handshakes();
         }
-        else if(blk_num == sync_last_requested_num) {
+        else if(can_request_span()) {
+            // window moved forward, idle peers can take new spans
             request_next_chunk();
         }
-        else {
-            fc_dlog(logger, "calling sync_wait on connection ${p}", ("p", c->peer_name()));
-            c->sync_wait();
-        }
     }
 }
 
+void
+sync_manager::recv_span_block(const connection_ptr& c, uint32_t blk_num) {
+    auto it = find_span(c);
+    if(it == spans.end()) {
+        return;
+    }
+    auto& span = it->second;
+    if(blk_num < span.start || blk_num > span.end) {
+        return;
+    }
+    span.last = std::max(span.last, blk_num);
+    if(span.last < span.end) {
+        fc_dlog(logger, "calling sync_wait on connection ${p}", ("p", c->peer_name()));
+        c->sync_wait();
+        return;
+    }
+
+    // whole span is received, this peer is free for next one
+    spans.erase(it);
+    request_next_chunk(c);
+}
+
+bool
+sync_manager::recv_sync_block(const connection_ptr& c, const signed_block_ptr& blk) {
+    if(state != lib_catchup) {
+        return false;
+    }
+
+    auto blk_num = blk->block_num();
+
+    // checked before the span is released when its last block arrives
+    auto it      = find_span(c);
+    auto in_span = (it != spans.end() && blk_num >= it->second.start && blk_num <= it->second.end);
+
+    recv_span_block(c, blk_num);
+    if(state != lib_catchup || blk_num <= sync_next_expected_num) {
+        return false;
+    }
+    if(blk_num > sync_window_end()) {
+        fc_ilog(logger, "expected block in range ${ne} to ${e} but got ${bn}",
+                ("ne", sync_next_expected_num)("e", sync_window_end())("bn", blk_num));
+        my_impl->close(c);
+        return true;
+    }
+    if(!in_span) {
+        // only the peer a span is assigned to fills its slots in the buffer
+        fc_ilog(logger, "block ${bn} is not in the span requested from ${p}", ("bn", blk_num)("p", c->peer_name()));
+        my_impl->close(c);
+        return true;
+    }
+
+    // keep it until all the blocks before it arrive
+    sync_buffer.emplace(blk_num, buffered_block(c, blk));
+    return true;
+}
+
+bool
+sync_manager::next_sync_block(connection_ptr& c, signed_block_ptr& blk) {
+    if(state != lib_catchup) {
+        sync_buffer.clear();
+        return false;
+    }
+
+    auto it = sync_buffer.begin();
+    if(it == sync_buffer.end() || it->first != sync_next_expected_num) {
+        return false;
+    }
+    c   = std::move(it->second.first);
+    blk = std::move(it->second.second);
+    sync_buffer.erase(it);
+    return true;
+}
+
 //------------------------------------------------------------------------
 
 void
@@ -2181,12 +2316,23 @@ net_plugin_impl::process_next_message(const connection_ptr& conn, uint32_t messa
             block_id_type blk_id  = bh.id();
             uint32_t      blk_num = bh.block_num();
             if(cc.fetch_block_by_id(blk_id)) {
-                sync_master->recv_block(conn, blk_id, blk_num);
                 conn->pending_message_buffer.advance_read_ptr(message_length);
+                if(thread_pool.has_value()) {
+                    post_known_block(conn, blk_id, blk_num);
+                }
+                else {
+                    sync_master->recv_block(conn, blk_id, blk_num);
+                }
                 return true;
             }
         }
 
+        // messages are decoded in order on the strand of connection
+        if(thread_pool.has_value()) {
+            decode_next_message(conn, message_length);
+            return true;
+        }
+
         auto ds = conn->pending_message_buffer.create_datastream();
         net_message msg;
         fc::raw::unpack(ds, msg);
@@ -2209,6 +2355,127 @@ net_plugin_impl::process_next_message(const connection_ptr& conn, uint32_t messa
     return true;
 }
 
+// earlier messages of the connection may still be decoding, known block is passed through the same strand to keep the order
+void
+net_plugin_impl::post_known_block(const connection_ptr& conn, const block_id_type& blk_id, uint32_t blk_num) {
+    ++conn->reads_in_flight;
+
+    connection_wptr weak_conn = conn;
+    boost::asio::post(*conn->decode_strand, [this, weak_conn, blk_id, blk_num]() {
+        app().post(priority::medium, [this, weak_conn, blk_id, blk_num]() {
+            auto conn = weak_conn.lock();
+            if(!conn) {
+                return;
+            }
+            --conn->reads_in_flight;
+            if(!conn->socket || !conn->socket->is_open()) {
+                return;
+            }
+            sync_master->recv_block(conn, blk_id, blk_num);
+        });
+    });
+}
+
+void
+net_plugin_impl::decode_next_message(const connection_ptr& conn, uint32_t message_length) {
+    auto buf   = std::make_shared<std::vector<char>>(message_length);
+    auto index = conn->pending_message_buffer.read_index();
+    conn->pending_message_buffer.peek(buf->data(), message_length, index);
+    conn->pending_message_buffer.advance_read_ptr(message_length);
+
+    // counted as read in flight until handled, so reading is delayed when net threads fall behind
+    ++conn->reads_in_flight;
+
+    connection_wptr weak_conn = conn;
+    boost::asio::post(*conn->decode_strand, [this, weak_conn, buf]() {
+        auto msg   = std::make_shared<net_message>();
+        auto block = signed_block_ptr();
+        auto trx   = transaction_metadata_ptr();
+        try {
+            auto ds = fc::datastream<const char*>(buf->data(), buf->size());
+            fc::raw::unpack(ds, *msg);
+
+            if(msg->contains<signed_block>()) {
+                block = std::make_shared<signed_block>(std::move(msg->get<signed_block>()));
+            }
+            else if(msg->contains<packed_transaction>()) {
+                trx = std::make_shared<transaction_metadata>(std::make_shared<packed_transaction>(std::move(msg->get<packed_transaction>())));
+                if(recover_keys) {
+                    if(auto cached = chain_plug->chain().get_trx_metas_cache().find(trx->signed_id); cached) {
+                        trx->signing_keys = cached->signing_keys;
+                    }
+                    try {
+                        trx->recover_keys(chain_id);
+                    }
+                    catch(const fc::exception& e) {
+                        // invalid signatures only fail this transaction, keys are recovered again and
+                        // the transaction is rejected when it's pushed to chain
+                        fc_dlog(logger, "failed to recover keys of transaction ${id}: ${e}", ("id", trx->id)("e", e.to_string()));
+                        trx->signing_keys.reset();
+                    }
+                }
+            }
+        }
+        catch(const fc::exception& e) {
+            auto err = e.to_detail_string();
+            app().post(priority::medium, [this, weak_conn, err]() {
+                auto conn = weak_conn.lock();
+                if(!conn) {
+                    return;
+                }
+                --conn->reads_in_flight;
+                edump((err));
+                close(conn);
+            });
+            return;
+        }
+        catch(...) {
+            app().post(priority::medium, [this, weak_conn]() {
+                auto conn = weak_conn.lock();
+                if(!conn) {
+                    return;
+                }
+                --conn->reads_in_flight;
+                fc_elog(logger, "Undefined exception unpacking message from ${p}", ("p", conn->peer_name()));
+                close(conn);
+            });
+            return;
+        }
+
+        app().post(priority::medium, [this, weak_conn, msg, block, trx]() {
+            auto conn = weak_conn.lock();
+            if(!conn) {
+                return;
+            }
+            --conn->reads_in_flight;
+            if(!conn->socket || !conn->socket->is_open()) {
+                return;
+            }
+
+            try {
+                if(block) {
+                    handle_message(conn, block);
+                }
+                else if(trx) {
+                    handle_message(conn, trx);
+                }
+                else {
+                    msg_handler m(*this, conn);
+                    msg->visit(m);
+                }
+            }
+            catch(const fc::exception& e) {
+                edump((e.to_detail_string()));
+                close(conn);
+            }
+            catch(const std::exception& e) {
+                fc_elog(logger, "Exception in handling message from ${p} ${s}", ("p", conn->peer_name())("s", e.what()));
+                close(conn);
+            }
+        });
+    });
+}
+
 size_t
 net_plugin_impl::count_open_sockets() const {
     size_t count = 0;
@@ -2531,6 +2798,11 @@ calc_trx_size(const packed_transaction_ptr& trx) {
 
 void
 net_plugin_impl::handle_message(const connection_ptr& c, const packed_transaction_ptr& trx) {
+    handle_message(c, std::make_shared<transaction_metadata>(trx));
+}
+
+void
+net_plugin_impl::handle_message(const connection_ptr& c, const transaction_metadata_ptr& ptrx) {
     fc_dlog(logger, "got a packed transaction, cancel wait");
     peer_ilog(c, "received packed_transaction");
     controller& cc = my_impl->chain_plug->chain();
@@ -2543,8 +2815,7 @@ net_plugin_impl::handle_message(const connection_ptr& c, const packed_transactio
         return;
     }
 
-    auto        ptrx = std::make_shared<transaction_metadata>(trx);
-    const auto& tid  = ptrx->id;
+    const auto& tid = ptrx->id;
 
     if(local_txns.get<by_id>().find(tid) != local_txns.end()) {
         fc_dlog(logger, "got a duplicate transaction - dropping");
@@ -2574,11 +2845,26 @@ net_plugin_impl::handle_message(const connection_ptr& c, const packed_transactio
 
 void
 net_plugin_impl::handle_message(const connection_ptr& c, const signed_block_ptr& msg) {
+    fc_dlog(logger, "canceling wait on ${p}", ("p", c->peer_name()));
+    c->cancel_wait();
+
+    if(sync_master->recv_sync_block(c, msg)) {
+        // received ahead of the next expected block during sync
+        return;
+    }
+
+    auto conn = c;
+    auto blk  = msg;
+    do {
+        accept_block(conn, blk);
+    } while(sync_master->next_sync_block(conn, blk));
+}
+
+void
+net_plugin_impl::accept_block(const connection_ptr& c, const signed_block_ptr& msg) {
     controller&   cc      = chain_plug->chain();
     block_id_type blk_id  = msg->id();
     uint32_t      blk_num = msg->block_num();
-    fc_dlog(logger, "canceling wait on ${p}", ("p", c->peer_name()));
-    c->cancel_wait();
 
     try {
         if(cc.fetch_block_by_id(blk_id)) {
@@ -2949,6 +3235,11 @@ net_plugin::set_program_options(options_description& /*cli*/, options_descriptio
         ("max-cleanup-time-msec", bpo::value<int>()->default_value(10), "max connection cleanup time per cleanup call in millisec")
         ("network-version-match", bpo::value<bool>()->default_value(false), "True to require exact match of peer network version.")
         ("sync-fetch-span", bpo::value<uint32_t>()->default_value(def_sync_fetch_span), "number of blocks to retrieve in a chunk from any individual peer during synchronization")
+        ("net-threads", bpo::value<uint16_t>()->default_value(def_net_threads),
+            "Number of worker threads used to unpack incoming blocks and transactions, they are unpacked by main thread if it's 0")
+        ("net-recover-keys", bpo::value<bool>()->default_value(false),
+            "Recover signing keys of incoming transactions on net worker threads, requires net-threads greater than 0")
+        ("sync-max-inflight-spans", bpo::value<uint32_t>()->default_value(def_sync_max_inflight), "maximum number of chunks requested from different peers at the same time during synchronization")
         ("use-socket-read-watermark", bpo::value<bool>()->default_value(false), "Enable expirimental socket read watermark optimization")
         ("peer-log-format", bpo::value<string>()->default_value("[\"${_name}\" ${_ip}:${_port}]"),
             "The string used to format peers when logging messages about them.  Variables are escaped with ${<variable name>}.\n"
@@ -2977,7 +3268,14 @@ net_plugin::plugin_initialize(const variables_map& options) {
 
         my->network_version_match = options.at("network-version-match").as<bool>();
 
-        my->sync_master.reset(new sync_manager(options.at("sync-fetch-span").as<uint32_t>()));
+        my->thread_pool_size = options.at("net-threads").as<uint16_t>();
+        my->recover_keys     = options.at("net-recover-keys").as<bool>();
+        if(my->thread_pool_size > 0) {
+            my->thread_pool.emplace(my->thread_pool_size);
+        }
+
+        my->sync_master.reset(new sync_manager(options.at("sync-fetch-span").as<uint32_t>(),
+                                               std::max(options.at("sync-max-inflight-spans").as<uint32_t>(), 1u)));
         my->dispatcher.reset(new dispatch_manager);
 
         my->connector_period     = std::chrono::seconds(options.at("connection-cleanup-period").as<int>());
@@ -3161,6 +3459,10 @@ net_plugin::plugin_shutdown() {
             my->connections.clear();
         }
 
+        if(my->thread_pool.has_value()) {
+            my->thread_pool->join();
+            my->thread_pool->stop();
+        }
         if(my->server_ioc) {
             my->server_ioc->stop();
         }
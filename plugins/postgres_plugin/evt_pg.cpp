@@ -6,8 +6,14 @@
 
 #pragma GCC diagnostic ignored "-Wunused-local-typedefs"
 
+#include <array>
+#include <cinttypes>
+#include <future>
+#include <map>
+#include <set>
 #include <fmt/format.h>
 #include <libpq-fe.h>
+#include <boost/endian/conversion.hpp>
 #include <boost/lexical_cast.hpp>
 #include <fc/io/json.hpp>
 #include <jmzk/chain/block_header.hpp>
@@ -403,6 +409,134 @@ escape_string(const std::string& str) {
     return estr;
 }
 
+/*
+ * Writers of PostgreSQL binary COPY format, see: https://www.postgresql.org/docs/11/sql-copy.html
+ * each field is written as 4 bytes length followed by value in network byte order
+ */
+namespace binary {
+
+enum oid : int32_t {
+    int4_oid   = 23,
+    bpchar_oid = 1042
+};
+
+auto pg_epoch_us = 946684800ll * 1000000;  // 2000-01-01 00:00:00 UTC
+
+template<typename T>
+void
+write_raw(fmt::memory_buffer& buf, T v) {
+    v = boost::endian::native_to_big(v);
+    buf.append((const char*)&v, (const char*)&v + sizeof(v));
+}
+
+void
+write_header(fmt::memory_buffer& buf) {
+    const char sig[] = "PGCOPY\n\377\r\n";
+    buf.append(sig, sig + sizeof(sig));  // includes the tailing '\0'
+    write_raw<int32_t>(buf, 0);  // flags
+    write_raw<int32_t>(buf, 0);  // header extension length
+}
+
+void
+write_trailer(fmt::memory_buffer& buf) {
+    write_raw<int16_t>(buf, -1);
+}
+
+void
+write_tuple(fmt::memory_buffer& buf, int16_t fields) {
+    if(buf.size() == 0) {
+        write_header(buf);
+    }
+    write_raw<int16_t>(buf, fields);
+}
+
+void
+write_null(fmt::memory_buffer& buf) {
+    write_raw<int32_t>(buf, -1);
+}
+
+void
+write_int32(fmt::memory_buffer& buf, int32_t v) {
+    write_raw<int32_t>(buf, sizeof(v));
+    write_raw<int32_t>(buf, v);
+}
+
+void
+write_int64(fmt::memory_buffer& buf, int64_t v) {
+    write_raw<int32_t>(buf, sizeof(v));
+    write_raw<int64_t>(buf, v);
+}
+
+void
+write_text(fmt::memory_buffer& buf, const std::string_view& v) {
+    write_raw<int32_t>(buf, (int32_t)v.size());
+    buf.append(v.data(), v.data() + v.size());
+}
+
+void
+write_timestamp(fmt::memory_buffer& buf, const fc::time_point& v) {
+    write_int64(buf, v.time_since_epoch().count() - pg_epoch_us);
+}
+
+void
+write_jsonb(fmt::memory_buffer& buf, const std::string& v) {
+    write_raw<int32_t>(buf, (int32_t)v.size() + 1);
+    buf.push_back(1);  // jsonb version
+    buf.append(v.data(), v.data() + v.size());
+}
+
+// one dimension array of text-like elements without nulls
+template<typename Iterator>
+void
+write_text_array(fmt::memory_buffer& buf, Iterator begin, Iterator end, int32_t elem_oid) {
+    auto strs = std::vector<std::string>();
+    auto len  = 0;
+    for(auto it = begin; it != end; it++) {
+        strs.emplace_back((std::string)*it);
+        len += 4 + strs.back().size();
+    }
+
+    if(strs.empty()) {
+        write_raw<int32_t>(buf, 12);
+        write_raw<int32_t>(buf, 0);  // ndim
+        write_raw<int32_t>(buf, 0);  // has nulls
+        write_raw<int32_t>(buf, elem_oid);
+        return;
+    }
+
+    write_raw<int32_t>(buf, 20 + len);
+    write_raw<int32_t>(buf, 1);  // ndim
+    write_raw<int32_t>(buf, 0);  // has nulls
+    write_raw<int32_t>(buf, elem_oid);
+    write_raw<int32_t>(buf, (int32_t)strs.size());  // dimension size
+    write_raw<int32_t>(buf, 1);  // lower bound
+    for(auto& str : strs) {
+        write_text(buf, str);
+    }
+}
+
+void
+write_empty_array(fmt::memory_buffer& buf, int32_t elem_oid) {
+    auto empty = std::array<std::string, 0>();
+    write_text_array(buf, empty.begin(), empty.end(), elem_oid);
+}
+
+}  // namespace binary
+
+auto copy_stmts = std::array<const char*, 3> {
+    "COPY blocks (block_id, block_num, prev_block_id, timestamp, trx_merkle_root, trx_count, producer) FROM STDIN WITH BINARY;",
+    "COPY transactions (trx_id, trx_num, seq_num, block_num, action_count, timestamp, expiration, max_charge, payer, type, status, signatures, keys, elapsed, charge, suspend_name) FROM STDIN WITH BINARY;",
+    "COPY actions (trx_num, seq_num, global_seq, name, domain, key, data, related_ft_holders) FROM STDIN WITH BINARY;"
+};
+
+// global ids of prepared COPY transactions: `<prefix><copy id>-<index>-<total>`
+const auto copy_gid_prefix = std::string("jmzkcopy-");
+
+std::string
+copy_gid(int64_t id, size_t index, size_t total) {
+    return fmt::format("{}{}-{}-{}", copy_gid_prefix, id, index, total);
+}
+
 }  // namespace internal
 
 int
@@ -415,12 +549,41 @@ pg::connect(const std::string& conn) {
     return PG_OK;
 }
 
+int
+pg::connect_copy(const std::string& conn) {
+    // COPY connections are committed by two-phase commit, fallback to COPY over main connection if it's disabled
+    auto r = PQexec(conn_, "SHOW max_prepared_transactions;");
+    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_exec_exception, "Get max_prepared_transactions failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    auto max_prepared = boost::lexical_cast<uint32_t>(PQgetvalue(r, 0, 0));
+    PQclear(r);
+
+    if(max_prepared < internal::copy_stmts.size()) {
+        wlog("max_prepared_transactions of postgres is ${n}, parallel COPY needs at least ${m}, disable it",
+            ("n",max_prepared)("m",internal::copy_stmts.size()));
+        return PG_OK;
+    }
+
+    for(auto i = 0u; i < internal::copy_stmts.size(); i++) {
+        auto c = PQconnectdb(conn.c_str());
+        copy_conns_.emplace_back(c);
+
+        jmzk_ASSERT(PQstatus(c) == CONNECTION_OK, chain::postgres_connection_exception, "Connect failed");
+    }
+
+    return PG_OK;
+}
+
 int
 pg::close() {
     FC_ASSERT(conn_);
     PQfinish(conn_);
     conn_ = nullptr;
 
+    for(auto c : copy_conns_) {
+        PQfinish(c);
+    }
+    copy_conns_.clear();
+
     return PG_OK;
 }
 
@@ -680,21 +843,19 @@ pg::new_copy_context() {
 }
 
 int
-pg::block_copy_to(const std::string& table, const std::string& data) {
-    auto stmt = fmt::format("COPY {} FROM STDIN;", table);
-
-    auto r = PQexec(conn_, stmt.c_str());
-    jmzk_ASSERT(PQresultStatus(r) == PGRES_COPY_IN, chain::postgres_exec_exception, "Not expected COPY response, detail: ${s}", ("s",PQerrorMessage(conn_)));
+pg::block_copy_to(pg_conn* conn, const std::string& stmt, const fmt::memory_buffer& data) {
+    auto r = PQexec(conn, stmt.c_str());
+    jmzk_ASSERT(PQresultStatus(r) == PGRES_COPY_IN, chain::postgres_exec_exception, "Not expected COPY response, detail: ${s}", ("s",PQerrorMessage(conn)));
     PQclear(r);
 
-    auto nr = PQputCopyData(conn_, data.data(), (int)data.size());
-    jmzk_ASSERT(nr == 1, chain::postgres_exec_exception, "Put data into COPY stream failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    auto nr = PQputCopyData(conn, data.data(), (int)data.size());
+    jmzk_ASSERT(nr == 1, chain::postgres_exec_exception, "Put data into COPY stream failed, detail: ${s}", ("s",PQerrorMessage(conn)));
 
-    auto nr2 = PQputCopyEnd(conn_, NULL);
-    jmzk_ASSERT(nr2 == 1, chain::postgres_exec_exception, "Close data into COPY stream failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    auto nr2 = PQputCopyEnd(conn, NULL);
+    jmzk_ASSERT(nr2 == 1, chain::postgres_exec_exception, "Close data into COPY stream failed, detail: ${s}", ("s",PQerrorMessage(conn)));
 
-    auto r2 = PQgetResult(conn_);
-    jmzk_ASSERT(PQresultStatus(r2) == PGRES_COMMAND_OK, chain::postgres_exec_exception, "Execute COPY command failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+    auto r2 = PQgetResult(conn);
+    jmzk_ASSERT(PQresultStatus(r2) == PGRES_COMMAND_OK, chain::postgres_exec_exception, "Execute COPY command failed, detail: ${s}", ("s",PQerrorMessage(conn)));
     PQclear(r2);
 
     return PG_OK;
@@ -702,15 +863,148 @@ pg::block_copy_to(const std::string& table, const std::string& data) {
 
 void
 pg::commit_copy_context(copy_context& cctx) {
-    if(cctx.blocks_copy_.size() > 0) {
-        block_copy_to("blocks", fmt::to_string(cctx.blocks_copy_));
+    using namespace internal;
+
+    auto bufs = std::array<fmt::memory_buffer*, 3> { &cctx.blocks_copy_, &cctx.trxs_copy_, &cctx.actions_copy_ };
+    for(auto buf : bufs) {
+        if(buf->size() > 0) {
+            binary::write_trailer(*buf);
+        }
+    }
+
+    if(copy_conns_.empty()) {
+        for(auto i = 0u; i < bufs.size(); i++) {
+            if(bufs[i]->size() > 0) {
+                block_copy_to(conn_, copy_stmts[i], *bufs[i]);
+            }
+        }
+        return;
     }
-    if(cctx.trxs_copy_.size() > 0) {
-        block_copy_to("transactions", fmt::to_string(cctx.trxs_copy_));
+
+    // stream tables over their own connections in parallel and commit them together after all succeed
+    auto tasks = std::array<std::future<void>, 3>();
+    for(auto i = 0u; i < bufs.size(); i++) {
+        if(bufs[i]->size() == 0) {
+            continue;
+        }
+        tasks[i] = std::async(std::launch::async, [this, i, &bufs] {
+            auto conn = copy_conns_[i];
+            auto r    = PQexec(conn, "BEGIN;");
+            auto s    = PQresultStatus(r);
+            PQclear(r);
+            jmzk_ASSERT(s == PGRES_COMMAND_OK, chain::postgres_exec_exception, "Begin transaction failed, detail: ${s}", ("s",PQerrorMessage(conn)));
+
+            block_copy_to(conn, copy_stmts[i], *bufs[i]);
+        });
     }
-    if(cctx.actions_copy_.size() > 0) {
-        block_copy_to("actions", fmt::to_string(cctx.actions_copy_));
+
+    auto except = std::exception_ptr();
+    auto parts  = std::vector<pg_conn*>();
+    for(auto i = 0u; i < tasks.size(); i++) {
+        if(!tasks[i].valid()) {
+            continue;
+        }
+        try {
+            tasks[i].get();
+        }
+        catch(...) {
+            except = std::current_exception();
+        }
+        parts.emplace_back(copy_conns_[i]);
+    }
+
+    if(except) {
+        for(auto conn : parts) {
+            PQclear(PQexec(conn, "ROLLBACK;"));
+        }
+        std::rethrow_exception(except);
+    }
+
+    // two-phase commit, tables are committed all or none even if the process crashes in the middle.
+    // connections are prepared in order and then committed in the same order, so the prepared ones left by
+    // a crash are the leading ones when preparing and the trailing ones when committing,
+    // see `recover_prepared_copies` for how they're resolved
+    auto id       = fc::time_point::now().time_since_epoch().count();
+    auto prepared = 0u;
+    for(; prepared < parts.size(); prepared++) {
+        auto stmt = fmt::format("PREPARE TRANSACTION '{}';", copy_gid(id, prepared, parts.size()));
+        auto r    = PQexec(parts[prepared], stmt.c_str());
+        auto s    = PQresultStatus(r);
+        PQclear(r);
+        if(s != PGRES_COMMAND_OK) {
+            break;
+        }
+    }
+
+    if(prepared < parts.size()) {
+        // failed one is rolled back by PREPARE itself
+        auto err = std::string(PQerrorMessage(parts[prepared]));
+        for(auto i = prepared + 1; i < parts.size(); i++) {
+            PQclear(PQexec(parts[i], "ROLLBACK;"));
+        }
+        for(auto i = 0u; i < prepared; i++) {
+            auto stmt = fmt::format("ROLLBACK PREPARED '{}';", copy_gid(id, i, parts.size()));
+            PQclear(PQexec(parts[i], stmt.c_str()));
+        }
+        jmzk_THROW(chain::postgres_exec_exception, "Prepare COPY failed, `max_prepared_transactions` of postgres should be at least ${n}, detail: ${s}",
+            ("n",parts.size())("s",err));
     }
+
+    for(auto i = 0u; i < parts.size(); i++) {
+        auto stmt = fmt::format("COMMIT PREPARED '{}';", copy_gid(id, i, parts.size()));
+        auto r    = PQexec(parts[i], stmt.c_str());
+        auto s    = PQresultStatus(r);
+        PQclear(r);
+        jmzk_ASSERT(s == PGRES_COMMAND_OK, chain::postgres_exec_exception, "Commit prepared COPY failed, detail: ${s}", ("s",PQerrorMessage(parts[i])));
+    }
+}
+
+// resolves the COPY transactions left prepared by a crash in `commit_copy_context`.
+// the last one of a group is only prepared after all the others, so if it's still there, the group is committed,
+// otherwise the group is crashed while preparing and the prepared ones are rolled back
+int
+pg::recover_prepared_copies() {
+    using namespace internal;
+
+    auto stmt = fmt::format("SELECT gid FROM pg_prepared_xacts WHERE database = current_database() AND left(gid, {}) = '{}';", copy_gid_prefix.size(), copy_gid_prefix);
+
+    auto r = PQexec(conn_, stmt.c_str());
+    jmzk_ASSERT(PQresultStatus(r) == PGRES_TUPLES_OK, chain::postgres_exec_exception, "Get prepared COPY transactions failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+
+    auto groups   = std::map<int64_t, std::vector<std::string>>();
+    auto complete = std::set<int64_t>();
+
+    auto n = PQntuples(r);
+    for(auto i = 0; i < n; i++) {
+        auto gid   = std::string(PQgetvalue(r, i, 0));
+        auto id    = int64_t(0);
+        auto index = 0u;
+        auto total = 0u;
+        if(sscanf(gid.c_str() + copy_gid_prefix.size(), "%" SCNd64 "-%u-%u", &id, &index, &total) != 3) {
+            continue;
+        }
+
+        groups[id].emplace_back(gid);
+        if(index + 1 == total) {
+            complete.emplace(id);
+        }
+    }
+    PQclear(r);
+
+    for(auto& g : groups) {
+        auto commit = complete.find(g.first) != complete.end();
+        wlog("${a} COPY transactions left prepared: ${g}", ("a",commit ? "Commit" : "Rollback")("g",g.second));
+
+        for(auto& gid : g.second) {
+            auto stmt = fmt::format("{} PREPARED '{}';", commit ? "COMMIT" : "ROLLBACK", gid);
+            auto r    = PQexec(conn_, stmt.c_str());
+            auto s    = PQresultStatus(r);
+            PQclear(r);
+            jmzk_ASSERT(s == PGRES_COMMAND_OK, chain::postgres_exec_exception, "Resolve prepared COPY failed, detail: ${s}", ("s",PQerrorMessage(conn_)));
+        }
+    }
+
+    return PG_OK;
 }
 
 trx_context
@@ -735,48 +1029,46 @@ pg::commit_trx_context(trx_context& tctx) {
 
 int
 pg::add_block(add_context& actx, const block_ptr block) {
-    fmt::format_to(actx.cctx.blocks_copy_,
-        fmt("{}\t{:d}\t{}\t{}\t{}\t{:d}\t{}\tnow\n"),
-        actx.block_id,
-        actx.block_num,
-        block->header.previous.str(),
-        actx.ts,
-        block->header.transaction_mroot.str(),
-        block->block->transactions.size(),
-        (std::string)block->header.producer
-        );
+    using namespace internal;
+
+    auto& buf = actx.cctx.blocks_copy_;
+    binary::write_tuple(buf, 7);
+    binary::write_text(buf, actx.block_id);
+    binary::write_int32(buf, (int32_t)actx.block_num);
+    binary::write_text(buf, block->header.previous.str());
+    binary::write_timestamp(buf, actx.block_time);
+    binary::write_text(buf, block->header.transaction_mroot.str());
+    binary::write_int32(buf, (int32_t)block->block->transactions.size());
+    binary::write_text(buf, (std::string)block->header.producer);
+
     return PG_OK;
 }
 
 int
-pg::add_trx(add_context& actx, const trx_recept_t& trx, const trx_t& strx, int seq_num, int trx_num, int elapsed, int charge) {
+pg::add_trx(add_context& actx, const trx_recept_t& trx, const trx_t& strx, const keys_t& keys, int seq_num, int64_t trx_num, int elapsed, int charge) {
     using namespace internal;
 
-    auto& cctx = actx.cctx;
-    fmt::format_to(cctx.trxs_copy_,
-        fmt("{}\t{:d}\t{:d}\t{}\t{:d}\t{}\t{}\t{:d}\t{}\t{}\t{}\t"),
-        strx.id().str(),
-        trx_num,
-        seq_num,
-        actx.block_num,
-        (int32_t)strx.actions.size(),
-        actx.ts,
-        (std::string)strx.expiration,
-        (int32_t)strx.max_charge,
-        (std::string)strx.payer,
-        (std::string)trx.type,
-        (std::string)trx.status
-        );
-
-    // signatures
-    format_array_to(cctx.trxs_copy_, std::begin(strx.signatures), std::end(strx.signatures));
-
-    // keys
-    auto keys = strx.get_signature_keys(actx.chain_id);
-    format_array_to(cctx.trxs_copy_, std::begin(keys), std::end(keys));
+    auto& buf = actx.cctx.trxs_copy_;
+    binary::write_tuple(buf, 16);
+    binary::write_text(buf, strx.id().str());
+    binary::write_int64(buf, trx_num);
+    binary::write_int32(buf, seq_num);
+    binary::write_int32(buf, (int32_t)actx.block_num);
+    binary::write_int32(buf, (int32_t)strx.actions.size());
+    binary::write_timestamp(buf, actx.block_time);
+    binary::write_timestamp(buf, strx.expiration);
+    binary::write_int32(buf, (int32_t)strx.max_charge);
+    binary::write_text(buf, (std::string)strx.payer);
+    binary::write_text(buf, (std::string)trx.type);
+    binary::write_text(buf, (std::string)trx.status);
+
+    // signatures and keys
+    binary::write_text_array(buf, std::begin(strx.signatures), std::end(strx.signatures), binary::bpchar_oid);
+    binary::write_text_array(buf, std::begin(keys), std::end(keys), binary::bpchar_oid);
 
     // traces
-    fmt::format_to(cctx.trxs_copy_, fmt("{}\t{}\t"), elapsed, charge);
+    binary::write_int32(buf, elapsed);
+    binary::write_int32(buf, charge);
 
     // extenscions
     auto has_ext = 0;
@@ -785,17 +1077,14 @@ pg::add_trx(add_context& actx, const trx_recept_t& trx, const trx_t& strx, int s
             auto& v    = std::get<1>(ext);
             auto  name = std::string(v.cbegin(), v.cend());
 
-            fmt::format_to(cctx.trxs_copy_, fmt("{}\t"), name);
+            binary::write_text(buf, name);
             has_ext = 1;
             break;
         }
     }
 
-    if(has_ext) {
-        fmt::format_to(cctx.trxs_copy_, fmt("now\n"));
-    }
-    else {
-        fmt::format_to(cctx.trxs_copy_, fmt("\\N\tnow\n"));
+    if(!has_ext) {
+        binary::write_null(buf);
     }
 
     return PG_OK;
@@ -809,16 +1098,16 @@ pg::add_action(add_context& actx, const act_trace_t& act_trace, int seq_num, int
     auto  acttype = actx.exec_ctx.get_acttype_name(act.name);
     auto  data    = actx.abi.binary_to_variant(acttype, act.data, actx.exec_ctx);
 
-    fmt::format_to(actx.cctx.actions_copy_,
-        fmt("{:d}\t{:d}\t{:d}\t{}\t{}\t{}\t{}\t{{}}\tnow\n"),
-        trx_num,
-        seq_num,
-        act_trace.receipt.global_sequence,
-        act.name.to_string(),
-        act.domain.to_string(),
-        act.key.to_string(),
-        escape_string<true>(fc::json::to_string(data))
-        );
+    auto& buf = actx.cctx.actions_copy_;
+    binary::write_tuple(buf, 8);
+    binary::write_int32(buf, (int32_t)trx_num);
+    binary::write_int32(buf, seq_num);
+    binary::write_int64(buf, (int64_t)act_trace.receipt.global_sequence);
+    binary::write_text(buf, act.name.to_string());
+    binary::write_text(buf, act.domain.to_string());
+    binary::write_text(buf, act.key.to_string());
+    binary::write_jsonb(buf, fc::json::to_string(data));
+    binary::write_empty_array(buf, binary::int4_oid);
 
     return PG_OK;
 }
@@ -8,7 +8,9 @@
 #include <ostream>
 #include <string>
 #include <string_view>
+#include <vector>
 #include <boost/noncopyable.hpp>
+#include <fmt/format.h>
 #include <jmzk/chain/block_state.hpp>
 #include <jmzk/chain/execution_context.hpp>
 #include <jmzk/chain/transaction.hpp>
@@ -44,6 +46,7 @@ using trx_recept_t = chain::transaction_receipt;
 using trx_t        = chain::signed_transaction;
 using ft_holders_t = chain::small_vector_base<chain::ft_holder>;
 using validator_t  = chain::contracts::validator_def;
+using keys_t       = chain::public_keys_set;
 
 struct copy_context;
 struct trx_context;
@@ -58,6 +61,7 @@ public:
     std::string_view  block_id;
     uint32_t          block_num;
     std::string       ts;
+    fc::time_point    block_time;
     const chain_id_t& chain_id;
     const abi_t&      abi;
     const exec_ctx_t& exec_ctx;
@@ -69,6 +73,7 @@ public:
 
 public:
     int connect(const std::string& conn);
+    int connect_copy(const std::string& conn);
     int close();
 
 public:
@@ -104,13 +109,14 @@ public:
 public:
     copy_context new_copy_context();
     void commit_copy_context(copy_context&);
+    int recover_prepared_copies();
 
     trx_context new_trx_context();
     void commit_trx_context(trx_context&);
 
 public:
     static int add_block(add_context&, const block_ptr);
-    static int add_trx(add_context&, const trx_recept_t&, const trx_t&, int seq_num, int trx_num, int elapsed, int charge);
+    static int add_trx(add_context&, const trx_recept_t&, const trx_t&, const keys_t& keys, int seq_num, int64_t trx_num, int elapsed, int charge);
     static int add_action(add_context&, const act_trace_t&, int seq_num, int64_t trx_num);
     
     int get_latest_block_id(std::string& block_id) const;
@@ -143,10 +149,12 @@ public:
     int add_ft_holders(trx_context&, const ft_holders_t&);
 
 private:
-    int block_copy_to(const std::string& table, const std::string& data);
+    int block_copy_to(pg_conn* conn, const std::string& stmt, const fmt::memory_buffer& data);
 
 private:
     pg_conn*    conn_;
+    // extra connections streaming `blocks`, `transactions` and `actions` in parallel, empty if not enabled
+    std::vector<pg_conn*> copy_conns_;
     std::string last_sync_block_id_;
     int         prepared_stmts_;
 
@@ -0,0 +1,97 @@
+/**
+ *  @file
+ *  @copyright defined in jmzk/LICENSE.txt
+ */
+#pragma once
+#include <atomic>
+#include <memory>
+#include <boost/noncopyable.hpp>
+
+namespace jmzk {
+
+/**
+ *  Bounded lock-free ring buffer for multiple producers and single consumer.
+ *  Every cell carries a sequence number telling whether it's ready to be written or read,
+ *  so producers only contend on the tail with CAS and never wait for each other or consumer.
+ *  `try_push` fails instead of blocking when buffer is full.
+ */
+template<typename T>
+class mpsc_ring_buffer : boost::noncopyable {
+public:
+    explicit mpsc_ring_buffer(size_t capacity) {
+        auto sz = size_t(2);
+        while(sz < capacity) {
+            sz <<= 1;
+        }
+
+        cells_.reset(new cell[sz]);
+        mask_ = sz - 1;
+        for(auto i = 0u; i < sz; i++) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+public:
+    bool
+    try_push(T&& v) {
+        auto  pos = tail_.load(std::memory_order_relaxed);
+        cell* c   = nullptr;
+        while(true) {
+            c = &cells_[pos & mask_];
+
+            auto seq  = c->seq.load(std::memory_order_acquire);
+            auto diff = (intptr_t)seq - (intptr_t)pos;
+            if(diff == 0) {
+                if(tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if(diff < 0) {
+                return false;  // full
+            }
+            else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+
+        c->data = std::move(v);
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // should only be called by the consumer
+    bool
+    try_pop(T& v) {
+        auto  pos = head_.load(std::memory_order_relaxed);
+        auto& c   = cells_[pos & mask_];
+
+        auto seq = c.seq.load(std::memory_order_acquire);
+        if((intptr_t)seq - (intptr_t)(pos + 1) < 0) {
+            return false;  // empty
+        }
+
+        v      = std::move(c.data);
+        c.data = T();
+        c.seq.store(pos + mask_ + 1, std::memory_order_release);
+        head_.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct cell {
+        std::atomic<size_t> seq;
+        T                   data;
+    };
+
+    std::unique_ptr<cell[]> cells_;
+    size_t                  mask_;
+
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+};
+
+}  // namespace jmzk
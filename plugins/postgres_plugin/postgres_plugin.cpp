@@ -4,20 +4,15 @@
  */
 #include <jmzk/postgres_plugin/postgres_plugin.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <queue>
 #include <optional>
-#include <tuple>
 #include <thread>
 #include <mutex>
-
-#if __has_include(<condition>)
-#include <condition>
-using std::condition_variable_any;
-#else
-#include <boost/thread/condition.hpp>
-using boost::condition_variable_any;
-#endif
+#include <unordered_map>
 
 #include <fc/io/json.hpp>
 #include <fc/variant.hpp>
@@ -44,6 +39,7 @@ using boost::condition_variable_any;
 #include <jmzk/postgres_plugin/jmzk_pg.hpp>
 #include <jmzk/postgres_plugin/copy_context.hpp>
 #include <jmzk/postgres_plugin/trx_context.hpp>
+#include <jmzk/postgres_plugin/ring_buffer.hpp>
 
 namespace jmzk {
 
@@ -58,7 +54,12 @@ static appbase::abstract_plugin& _postgres_plugin = app().register_plugin<postgr
 
 class postgres_plugin_impl {
 private:
-    using inblock_ptr = std::tuple<block_state_ptr, bool>; // true for irreversible block
+    // blocks and traces share one queue so consumer sees them in the order chain emitted
+    struct queue_item {
+        block_state_ptr       block;
+        transaction_trace_ptr trace;
+        bool                  irreversible = false;
+    };
 
 public:
     postgres_plugin_impl(const controller& control)
@@ -67,8 +68,15 @@ public:
     ~postgres_plugin_impl();
 
 public:
+    void enqueue(queue_item&& item);
+    void notify_consumer();
+    void wait_for_items();
+    void pop_items(std::deque<queue_item>& bqueue, size_t limit);
+    void adjust_batch_size(fc::microseconds latency);
     void consume_queues();
 
+    std::string stats() const;
+
     void applied_block(const block_state_ptr&);
     void applied_irreversible_block(const block_state_ptr&);
     void applied_transaction(const transaction_trace_ptr&);
@@ -97,70 +105,83 @@ public:
     uint32_t last_sync_block_num_ = 0;
     uint32_t part_limit_ = 0, part_num_ = 0;
 
-    size_t processed_  = 0;
-    size_t queue_size_ = 0;
+    size_t processed_      = 0;
+    size_t queue_size_     = 0;
+    size_t max_batch_size_ = 0;
+    size_t batch_size_     = 1;  // adaptive, only touched by consumer
+
+    // chain thread never blocks on the queue: items go to overflow list when ring is full
+    std::unique_ptr<mpsc_ring_buffer<queue_item>> queue_;
+    std::deque<queue_item>                        overflow_;
+    spinlock                                      overflow_lock_;
+    std::atomic_bool                              overflowed_ = false;
+    std::atomic<int64_t>                          depth_      = 0;
 
-    std::deque<inblock_ptr>           block_state_queue_;
-    std::deque<transaction_trace_ptr> transaction_trace_queue_;
+    std::deque<transaction_trace_ptr> traces_;  // traces waiting for their block, consumer only
 
-    spinlock               lock_;
-    condition_variable_any cond_;
+    std::mutex              wait_lock_;
+    std::condition_variable cond_;
+    std::atomic_bool        waiting_ = false;
 
-    bool                   consuming_ = false;
-    condition_variable_any ss_cond_;
+    bool                    consuming_ = false;  // guarded by wait_lock_
+    std::condition_variable ss_cond_;
 
     std::thread      consume_thread_;
     std::atomic_bool done_ = false;
 
+    // metrics
+    std::atomic<size_t>   last_batch_size_ = 0;
+    std::atomic<int64_t>  last_latency_    = 0;  // in microseconds
+    std::atomic<uint64_t> total_blocks_    = 0;
+    std::atomic<uint64_t> total_commits_   = 0;
+    std::atomic<uint64_t> total_overflows_ = 0;
+
     llvm::StringSet<llvm::MallocAllocator> changed_validators_;
 
     std::optional<boost::signals2::scoped_connection> accepted_block_connection_;
     std::optional<boost::signals2::scoped_connection> irreversible_block_connection_;
     std::optional<boost::signals2::scoped_connection> applied_transaction_connection_;
+    std::optional<boost::signals2::scoped_connection> collect_stats_connection_;
 };
 
-namespace internal {
-
-template <typename Q, typename V>
-inline void
-queueb(Q& bqueue, V&& v, spinlock& lock, condition_variable_any& cv, size_t queue_size) {
-    lock.lock();
-
-    auto sleep_time = 0ul;
-
-    while(bqueue.size() > queue_size) {
-        lock.unlock();
-        cv.notify_one();
-
-        sleep_time += 100;
-        std::this_thread::sleep_for(std::chrono::milliseconds(sleep_time));
-
-        lock.lock();
+void
+postgres_plugin_impl::notify_consumer() {
+    if(waiting_) {
+        std::lock_guard<std::mutex> lock(wait_lock_);
+        cond_.notify_one();
     }
-    bqueue.emplace_back(std::forward<V>(v));
-    lock.unlock();
-    cv.notify_one();
 }
 
-template <typename Q, typename V>
-inline void
-queuet(Q& tqueue, V&& v, spinlock& lock, condition_variable_any& cv) {
-    lock.lock();
-    tqueue.emplace_back(std::forward<V>(v));
-    lock.unlock();
-    cv.notify_one();
-}
+void
+postgres_plugin_impl::enqueue(queue_item&& item) {
+    if(!overflowed_ && queue_->try_push(std::move(item))) {
+        depth_++;
+        notify_consumer();
+        return;
+    }
 
-}  // namespace internal
+    {
+        // ring is full: keep the item in overflow list, consumer takes it after draining the ring
+        spinlock_guard lock(overflow_lock_);
+        if(overflow_.empty()) {
+            wlog("postgres queue is full, capacity: ${c}, buffering into overflow list", ("c", queue_->capacity()));
+        }
+        overflow_.emplace_back(std::move(item));
+        overflowed_ = true;
+        depth_++;
+        total_overflows_++;
+    }
+    notify_consumer();
+}
 
 void
 postgres_plugin_impl::applied_irreversible_block(const block_state_ptr& bsp) {
-    jmzk::internal::queueb(block_state_queue_, std::make_tuple(bsp, true), lock_, cond_, queue_size_);
+    enqueue(queue_item { bsp, nullptr, true });
 }
 
 void
 postgres_plugin_impl::applied_block(const block_state_ptr& bsp) {
-    jmzk::internal::queueb(block_state_queue_, std::make_tuple(bsp, false), lock_, cond_, queue_size_);
+    enqueue(queue_item { bsp, nullptr, false });
 }
 
 void
@@ -169,43 +190,101 @@ postgres_plugin_impl::applied_transaction(const transaction_trace_ptr& ttp) {
         ttp->receipt->status != transaction_receipt_header::soft_fail)) {
         return;
     }
-    jmzk::internal::queuet(transaction_trace_queue_, ttp, lock_, cond_);
+    enqueue(queue_item { nullptr, ttp, false });
 }
 
 void
-postgres_plugin_impl::consume_queues() {
-    using namespace jmzk::internal;
+postgres_plugin_impl::wait_for_items() {
+    std::unique_lock<std::mutex> lock(wait_lock_);
+    if(depth_ > 0 || done_) {
+        return;
+    }
+
+    consuming_ = false;
+    ss_cond_.notify_all();
+
+    waiting_ = true;
+    cond_.wait(lock, [this] { return depth_ > 0 || done_; });
+    waiting_ = false;
+
+    consuming_ = true;
+}
+
+void
+postgres_plugin_impl::pop_items(std::deque<queue_item>& bqueue, size_t limit) {
+    auto take = [&](queue_item&& item) {
+        depth_--;
+        if(item.trace) {
+            traces_.emplace_back(std::move(item.trace));
+        }
+        else {
+            bqueue.emplace_back(std::move(item));
+        }
+    };
 
+    auto item = queue_item();
+    while(bqueue.size() < limit && queue_->try_pop(item)) {
+        take(std::move(item));
+    }
+    if(bqueue.size() >= limit || !overflowed_) {
+        return;
+    }
+
+    // ring is drained, items in overflow list are all newer than the ones in ring
+    spinlock_guard lock(overflow_lock_);
+    while(bqueue.size() < limit && !overflow_.empty()) {
+        take(std::move(overflow_.front()));
+        overflow_.pop_front();
+    }
+    if(overflow_.empty()) {
+        overflowed_ = false;
+    }
+}
+
+void
+postgres_plugin_impl::adjust_batch_size(fc::microseconds latency) {
+    // grow batch while there're blocks left behind and commit is fast enough (replay or catching up),
+    // shrink it when commit gets slow. Live sync only has one block each time anyway.
+    const auto target = fc::milliseconds(500);
+
+    if(latency > target) {
+        batch_size_ = std::max<size_t>(batch_size_ / 2, 1);
+    }
+    else if(depth_ > 0) {
+        batch_size_ = std::min(batch_size_ * 2, max_batch_size_);
+    }
+}
+
+void
+postgres_plugin_impl::consume_queues() {
     try {
         while(true) {
-            lock_.lock();
-            while(block_state_queue_.empty() && !done_) {
-                consuming_ = false;
-                ss_cond_.notify_all();
-                cond_.wait(lock_);
-            }
-
-            auto bqueue = std::move(block_state_queue_);
-            auto traces = std::move(transaction_trace_queue_);
+            wait_for_items();
 
-            consuming_ = true;
-            lock_.unlock();
+            auto bqueue = std::deque<queue_item>();
+            pop_items(bqueue, batch_size_);
 
-            const int BlockPtr       = 0;
-            const int IsIrreversible = 1;
+            if(bqueue.empty()) {
+                if(done_) {
+                    break;
+                }
+                continue;
+            }
 
             // warn if queue size greater than 75%
-            if(bqueue.size() > (queue_size_ * 0.75)) {
-                wlog("queue size: ${q}, head block num: ${b}", ("q", fmt::format("{:n}",bqueue.size()))("b",fmt::format("{:n}",std::get<BlockPtr>(bqueue.front())->block_num)));
+            if(depth_ > (queue_size_ * 0.75)) {
+                wlog("queue size: ${q}, head block num: ${b}", ("q", fmt::format("{:n}",depth_.load()))("b",fmt::format("{:n}",bqueue.front().block->block_num)));
             }
             else if(done_) {
-                ilog("draining queue, size: ${q}", ("q", fmt::format("{:n}",bqueue.size())));
+                ilog("draining queue, size: ${q}", ("q", fmt::format("{:n}",depth_.load())));
                 break;
             }
 
-            auto cctx = db_.new_copy_context();
-            auto tctx = db_.new_trx_context();
-            auto back = std::get<BlockPtr>(bqueue.back());
+            auto start = fc::time_point::now();
+            auto cctx  = db_.new_copy_context();
+            auto tctx  = db_.new_trx_context();
+            auto back  = bqueue.back().block;
+            auto num   = bqueue.size();
 
             // get latest trx num
             int64_t trx_num = 0;
@@ -213,31 +292,29 @@ postgres_plugin_impl::consume_queues() {
             tctx.set_trx_num(trx_num);
 
             // process block states
-            while(true) {
-                if(bqueue.empty()) {
-                    break;
-                }
-
-                auto& b = bqueue.front();
-                if(std::get<IsIrreversible>(b)) {
-                    process_irreversible_block(std::get<BlockPtr>(b), traces, cctx, tctx);
+            for(auto& b : bqueue) {
+                if(b.irreversible) {
+                    process_irreversible_block(b.block, traces_, cctx, tctx);
                 }
                 else {
-                    process_block(std::get<BlockPtr>(b), traces, cctx, tctx);
+                    process_block(b.block, traces_, cctx, tctx);
                 }
-
-                bqueue.pop_front();
             }
+            bqueue.clear();
+
             // update last sync block in postgres
             db_.upd_stat(tctx, "last_sync_block_id", back->id.str());
 
             cctx.commit();
             tctx.commit();
 
-            if(!traces.empty()) {
-                spinlock_guard lock(lock_);
-                transaction_trace_queue_.insert(transaction_trace_queue_.begin(), traces.begin(), traces.end());
-            }
+            auto latency = fc::time_point::now() - start;
+            last_batch_size_ = num;
+            last_latency_    = latency.count();
+            total_blocks_   += num;
+            total_commits_++;
+
+            adjust_batch_size(latency);
         }
         ilog("postgres_plugin consume thread shutdown gracefully");
     }
@@ -250,6 +327,17 @@ postgres_plugin_impl::consume_queues() {
     catch(...) {
         elog("Unknown exception while consuming block");
     }
+
+    std::lock_guard<std::mutex> lock(wait_lock_);
+    consuming_ = false;
+    ss_cond_.notify_all();
+}
+
+std::string
+postgres_plugin_impl::stats() const {
+    return fmt::format("\n** Postgres Plugin **\nqueue depth: {}, capacity: {}, overflows: {}\nbatch size: {} (max: {}), commit latency: {}us\nblocks: {}, commits: {}\n",
+        depth_.load(), queue_->capacity(), total_overflows_.load(), last_batch_size_.load(), max_batch_size_,
+        last_latency_.load(), total_blocks_.load(), total_commits_.load());
 }
 
 void
@@ -421,8 +509,6 @@ postgres_plugin_impl::update_validators(trx_context& tctx) {
 
 void
 postgres_plugin_impl::_process_block(const block_state_ptr block, std::deque<transaction_trace_ptr>& traces, copy_context& cctx, trx_context& tctx) {
-    using namespace jmzk::internal;
-
     auto id = block->id.str();
     if(block->block_num <= last_sync_block_num_) {
         jmzk_ASSERT(db_.exists_block(id), postgres_sync_exception,
@@ -445,11 +531,27 @@ postgres_plugin_impl::_process_block(const block_state_ptr block, std::deque<tra
     auto  actx     = add_context(cctx, control_.get_chain_id(), control_.get_abi_serializer(), control_.get_execution_context());
     actx.block_id  = id;
     actx.block_num = (int)block->block_num;
-    actx.ts        = (std::string)block->header.timestamp.to_time_point();
+    actx.block_time = block->header.timestamp.to_time_point();
+    actx.ts         = (std::string)actx.block_time;
 
     db_.add_block(actx, block);
     tctx.set_timestamp(actx.ts);
 
+    // signing keys are recovered already when chain applied the transactions, reuse them
+    auto metas = std::unordered_map<transaction_id_type, transaction_metadata_ptr>();
+    for(auto& m : block->trxs) {
+        metas.emplace(m->id, m);
+    }
+    auto get_keys = [&](const auto& trx_id, const auto& strx) {
+        if(auto it = metas.find(trx_id); it != metas.end()) {
+            auto& sk = it->second->signing_keys;
+            if(sk.has_value() && sk->first == actx.chain_id) {
+                return sk->second;
+            }
+        }
+        return strx.get_signature_keys(actx.chain_id);
+    };
+
     // transactions
     auto trx_seq_num = 0;
     for(const auto& trx : block->block->transactions) {
@@ -469,7 +571,7 @@ postgres_plugin_impl::_process_block(const block_state_ptr block, std::deque<tra
                     charge  = (int)trace->charge;
 
                     tctx.set_trx_num(tctx.trx_num() + 1);
-                    db_.add_trx(actx, trx, strx, trx_seq_num, tctx.trx_num(), elapsed, charge);
+                    db_.add_trx(actx, trx, strx, get_keys(trx_id, strx), trx_seq_num, tctx.trx_num(), elapsed, charge);
                     ++trx_seq_num;
 
                     if(trace->action_traces.empty()) {
@@ -524,6 +626,8 @@ postgres_plugin_impl::init(bool init_db) {
     auto& chain_plug = app().get_plugin<chain_plugin>();
     auto& chain      = chain_plug.chain();
 
+    queue_ = std::make_unique<mpsc_ring_buffer<queue_item>>(queue_size_);
+
     accepted_block_connection_.emplace(chain.accepted_block.connect([&](const chain::block_state_ptr& bs) {
         applied_block(bs);
     }));
@@ -536,6 +640,10 @@ postgres_plugin_impl::init(bool init_db) {
         applied_transaction(t);
     }));
 
+    collect_stats_connection_.emplace(chain.token_db().collect_stats.connect([&](std::string& str) {
+        str.append(stats());
+    }));
+
     if(init_db) {
         db_.init_pathman();
 
@@ -571,8 +679,11 @@ postgres_plugin_impl::~postgres_plugin_impl() {
         return;
     }
     try {
-        done_ = true;
-        cond_.notify_one();
+        {
+            std::lock_guard<std::mutex> lock(wait_lock_);
+            done_ = true;
+            cond_.notify_one();
+        }
 
         consume_thread_.join();
         db_.close();
@@ -603,11 +714,10 @@ postgres_plugin::read_from_snapshot(const std::shared_ptr<chain::snapshot_reader
 
 void
 postgres_plugin::write_snapshot(const std::shared_ptr<chain::snapshot_writer>& snapshot) const {
-    my_->lock_.lock();
-    while(my_->consuming_ || !my_->block_state_queue_.empty()) {
-        my_->ss_cond_.wait(my_->lock_);
+    {
+        std::unique_lock<std::mutex> lock(my_->wait_lock_);
+        my_->ss_cond_.wait(lock, [this] { return !my_->consuming_ && my_->depth_ == 0; });
     }
-    my_->lock_.unlock();
 
     my_->db_.backup(snapshot);
 }
@@ -616,11 +726,13 @@ void
 postgres_plugin::set_program_options(options_description& cli, options_description& cfg) {
     cfg.add_options()
         ("postgres-queue-size,q", bpo::value<uint>()->default_value(5120), "The queue size between jmzkd and postgres plugin thread.")
+        ("postgres-max-batch-size", bpo::value<uint>()->default_value(5000), "The maximum number of blocks written to postgres in one commit, actual batch size adapts to the backlog and commit latency")
         ("postgres-uri,p", bpo::value<std::string>(), 
             "PostgreSQL connection string, see: https://www.postgresql.org/docs/11/libpq-connect.html#LIBPQ-CONNSTRING for more detail.")
         ("clear-postgres", bpo::bool_switch()->default_value(false), "clear postgres database, use --delete-all-blocks option will force set this option")
         ("postgres-partition-limit", bpo::value<uint>()->default_value(30000000), "The partition limit")
         ("postgres-partition-num", bpo::value<uint>()->default_value(10), "The number of partitions")
+        ("postgres-parallel-copy", bpo::value<bool>()->default_value(true), "Stream blocks, transactions and actions tables over separate connections in parallel, committed by two-phase commit, only enabled when max_prepared_transactions of postgres is at least 3")
         ;
 }
 
@@ -660,6 +772,7 @@ postgres_plugin::plugin_initialize(const variables_map& options) {
         if(options.count("postgres-queue-size")) {
             my_->queue_size_ = options.at("postgres-queue-size").as<uint>();
         }
+        my_->max_batch_size_ = std::max<size_t>(options.at("postgres-max-batch-size").as<uint>(), 1);
 
         auto uri = options.at("postgres-uri").as<std::string>();
         ilog("connecting to ${u}", ("u", uri));
@@ -667,6 +780,12 @@ postgres_plugin::plugin_initialize(const variables_map& options) {
         my_->db_.connect(uri);
         my_->connstr_ = uri;
 
+        if(options.at("postgres-parallel-copy").as<bool>()) {
+            my_->db_.connect_copy(uri);
+        }
+        // parallel COPY may be enabled last time, COPY transactions left prepared hold locks on tables
+        my_->db_.recover_prepared_copies();
+
         if(!my_->db_.exists_table("blocks") || delete_state) {
             my_->wipe_database();
         }
@@ -711,6 +830,7 @@ postgres_plugin::plugin_shutdown() {
     my_->accepted_block_connection_.reset();
     my_->irreversible_block_connection_.reset();
     my_->applied_transaction_connection_.reset();
+    my_->collect_stats_connection_.reset();
     my_.reset();
 }
 
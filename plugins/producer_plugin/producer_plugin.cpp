@@ -6,8 +6,10 @@
 
 #include <algorithm>
 #include <iostream>
+#include <map>
 
 #include <boost/asio.hpp>
+#include <boost/asio/thread_pool.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/function_output_iterator.hpp>
 #include <boost/multi_index/hashed_index.hpp>
@@ -24,6 +26,7 @@
 #include <jmzk/chain/global_property_object.hpp>
 #include <jmzk/chain/plugin_interface.hpp>
 #include <jmzk/chain/snapshot.hpp>
+#include <jmzk/chain/transaction_metadata_cache.hpp>
 
 #ifdef POSTGRES_SUPPORT
 #include <jmzk/postgres_plugin/postgres_plugin.hpp>
@@ -140,6 +143,9 @@ public:
     fc::time_point   _irreversible_block_time;
     fc::microseconds _jmzkwd_provider_timeout_us;
 
+    // worker threads used to recover signing keys of incoming transactions off the main thread
+    optional<boost::asio::thread_pool> _thread_pool;
+
     time_point _last_signed_block_time;
     time_point _start_time            = fc::time_point::now();
     uint32_t   _last_signed_block_num = 0;
@@ -355,16 +361,79 @@ public:
     
     std::deque<std::tuple<transaction_metadata_ptr, bool, next_function<transaction_trace_ptr>>> _pending_incoming_transactions;
 
+    struct recovered_incoming_transaction {
+        transaction_metadata_ptr              trx;
+        bool                                  persist_until_expired;
+        next_function<transaction_trace_ptr>  next;
+        fc::exception_ptr                     except;
+    };
+
+    // sequence numbers of incoming transactions, used to keep arrival order after recovering keys on the pool
+    uint64_t                                           _incoming_trx_seq           = 0;
+    uint64_t                                           _processed_incoming_trx_seq = 0;
+    std::map<uint64_t, recovered_incoming_transaction> _recovered_incoming_transactions;
+
     void
     on_incoming_transaction_async(const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
         chain::controller& chain = chain_plug->chain();
-        const auto&        cfg   = chain.get_global_properties().configuration;
 
-        app().get_io_service().post([self = this, trx, persist_until_expired, next]() {
-            self->process_incoming_transaction_async(trx, persist_until_expired, next);
+        if(!trx->signing_keys.has_value()) {
+            // same transaction may be pushed again, reuse the keys recovered last time
+            if(auto cached = chain.get_trx_metas_cache().find(trx->signed_id); cached) {
+                trx->signing_keys = cached->signing_keys;
+            }
+        }
+        // transactions are processed in the order they arrive regardless of when key recovery finishes
+        auto seq = _incoming_trx_seq++;
+        if(trx->signing_keys.has_value() && trx->signing_keys->first == chain.get_chain_id()) {
+            // keys are recovered by caller already (e.g. batch pushing), only wait for earlier transactions
+            _recovered_incoming_transactions.emplace(seq, recovered_incoming_transaction{trx, persist_until_expired, std::move(next), nullptr});
+            process_recovered_transactions();
+            return;
+        }
+
+        boost::asio::post(*_thread_pool, [self = this, seq, trx, persist_until_expired, next = std::move(next), chain_id = chain.get_chain_id()]() mutable {
+            // recover signing keys here so that main thread only needs to check the cached ones
+            auto except = fc::exception_ptr();
+            try {
+                trx->recover_keys(chain_id);
+            }
+            catch(const fc::exception& e) {
+                except = e.dynamic_copy_exception();
+            }
+            catch(const std::exception& e) {
+                except = std::make_shared<fc::exception>(FC_LOG_MESSAGE(warn, "${what}: ", ("what", e.what())), fc::std_exception_code, BOOST_CORE_TYPEID(e).name(), e.what());
+            }
+            catch(...) {
+                except = std::make_shared<fc::unhandled_exception>(FC_LOG_MESSAGE(warn, "unknown: "), std::current_exception());
+            }
+
+            app().post(priority::low, [self, seq, trx, persist_until_expired, next = std::move(next), except]() mutable {
+                self->_recovered_incoming_transactions.emplace(seq, recovered_incoming_transaction{trx, persist_until_expired, std::move(next), except});
+                self->process_recovered_transactions();
+            });
         });
     }
 
+    void
+    process_recovered_transactions() {
+        auto it = _recovered_incoming_transactions.begin();
+        while(it != _recovered_incoming_transactions.end() && it->first == _processed_incoming_trx_seq) {
+            auto rt = std::move(it->second);
+            it = _recovered_incoming_transactions.erase(it);
+            _processed_incoming_trx_seq++;
+
+            if(rt.except) {
+                fc_dlog(_trx_trace_log, "[TRX_TRACE] Failed to recover keys of tx: ${txid} : ${why} ",
+                        ("txid", rt.trx->id)("why", rt.except->what()));
+                rt.next(rt.except);
+                _transaction_ack_channel.publish(priority::low, std::pair<fc::exception_ptr, transaction_metadata_ptr>(rt.except, rt.trx));
+                continue;
+            }
+            process_incoming_transaction_async(rt.trx, rt.persist_until_expired, std::move(rt.next));
+        }
+    }
+
     void
     process_incoming_transaction_async(const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
         chain::controller& chain = chain_plug->chain();
@@ -550,6 +619,8 @@ producer_plugin::set_program_options(
             "offset of last block producing time in microseconds. Negative number results in blocks to go out sooner, and positive number results in blocks to go out later")
          ("snapshots-dir", bpo::value<bfs::path>()->default_value("snapshots"),
             "the location of the snapshots directory (absolute path or relative to application data dir)")
+         ("producer-threads", bpo::value<uint16_t>()->default_value(config::default_producer_threads),
+            "Number of worker threads in producer thread pool, used for recovering signing keys of incoming transactions")
          ;
     config_file_options.add(producer_options); 
 }
@@ -679,6 +750,11 @@ producer_plugin::plugin_initialize(const boost::program_options::variables_map&
 
         my->_max_irreversible_block_age_us = fc::seconds(options.at("max-irreversible-block-age").as<int32_t>());
 
+        auto thread_pool_size = options.at("producer-threads").as<uint16_t>();
+        jmzk_ASSERT(thread_pool_size > 0, plugin_config_exception,
+            "producer-threads ${num} must be greater than 0", ("num", thread_pool_size));
+        my->_thread_pool.emplace(thread_pool_size);
+
         if(options.count("snapshots-dir")) {
             auto sd = options.at("snapshots-dir").as<bfs::path>();
             if(sd.is_relative()) {
@@ -772,6 +848,11 @@ producer_plugin::plugin_shutdown() {
         edump((e.to_detail_string()));
     }
 
+    if(my->_thread_pool) {
+        my->_thread_pool->join();
+        my->_thread_pool->stop();
+    }
+
     my->_accepted_block_connection.reset();
     my->_irreversible_block_connection.reset();
 }
@@ -2,11 +2,13 @@
 
 #include <lua.hpp>
 #include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
 #include <jmzk/testing/tester.hpp>
 #include <jmzk/chain/token_database_cache.hpp>
 #include <jmzk/chain/contracts/lua_engine.hpp>
 #include <jmzk/chain/contracts/lua_db.hpp>
 #include <jmzk/chain/contracts/lua_json.hpp>
+#include <jmzk/chain/contracts/lua_variant.hpp>
 
 extern "C" {
 
@@ -87,6 +89,37 @@ TEST_CASE("test_lua_debug", "[luajit]") {
 
 extern std::string jmzk_unittests_dir;
 
+TEST_CASE("test_lua_variant_blob", "[luajit]") {
+    using namespace jmzk::chain::contracts;
+
+    auto L = luaL_newstate();
+    REQUIRE(L != nullptr);
+
+    luaL_openlibs(L);
+
+    // raw bytes of blob are pushed as they're in json, not base64
+    auto b = fc::blob();
+    b.data = { 'a', '\0', '\xff', 'z' };
+
+    auto obj = fc::mutable_variant_object();
+    obj["data"] = fc::variant(b);
+
+    auto script = R"===(
+        local v = ...
+        return v.data == "a\0\255z"
+    )===";
+
+    auto r = luaL_loadstring(L, script);
+    REQUIRE(r == LUA_OK);
+
+    lua_pushvariant(L, fc::variant(obj));
+    auto r2 = lua_pcall(L, 1, 1, 0);
+    REQUIRE(r2 == LUA_OK);
+    CHECK(lua_toboolean(L, -1));
+
+    lua_close(L);
+}
+
 TEST_CASE("test_lua_db", "[luajit]") {
     using namespace jmzk::testing;
     using namespace jmzk::chain::contracts;
@@ -274,6 +307,31 @@ TEST_CASE("test_lua_engine", "[luajit]") {
         return false
     )===";
 
+    const char* script7 = R"===(
+        haha_global = 1
+        return true
+    )===";
+
+    const char* script8 = R"===(
+        return haha_global == nil
+    )===";
+
+    const char* script9 = R"===(
+        string.upper = function(s) return "hacked" end
+        string.haha = true
+        getmetatable("").__index = {}
+        table.insert = nil
+        math.randomseed(42)
+        package.loaded.haha = true
+        _G.haha_global = 1
+        return true
+    )===";
+
+    const char* script10 = R"===(
+        return string.upper("a") == "A" and ("a"):upper() == "A" and string.haha == nil
+            and table.insert ~= nil and package.loaded.haha == nil and haha_global == nil
+    )===";
+
     auto vt = fc::json::from_string(test_data);
     auto tt = token_def();
     fc::from_variant(vt, tt);
@@ -292,6 +350,21 @@ TEST_CASE("test_lua_engine", "[luajit]") {
     add_script("script4", script4);
     add_script("script5", script5);
     add_script("script6", script6);
+    add_script("script7", script7);
+    add_script("script8", script8);
+    add_script("script9", script9);
+    add_script("script10", script10);
+
+    // first random number of a new state, scripts should always see it no matter what the ones before did
+    auto first_random = [] {
+        auto L = luaL_newstate();
+        luaL_openlibs(L);
+        luaL_dostring(L, "return math.random(1, 1000000)");
+        auto n = lua_tointeger(L, -1);
+        lua_close(L);
+        return n;
+    }();
+    add_script("script11", "return math.random(1, 1000000) == " + std::to_string(first_random));
 
     auto engine = lua_engine();
 
@@ -317,4 +390,24 @@ TEST_CASE("test_lua_engine", "[luajit]") {
 
     CHECK_THROWS_AS(engine.invoke_filter(*mytester->control, act, "script6"), script_execution_exceptoin);
     CHECK_NOTHROW(engine.invoke_filter(*mytester->control, act, "script5"));
+
+    // globals are not leaked between invocations on pooled states
+    CHECK(engine.invoke_filter(*mytester->control, act, "script7"));
+    CHECK(engine.invoke_filter(*mytester->control, act, "script8"));
+
+    // neither is the shared state changed through libraries, metatables or the seed of random
+    CHECK(engine.invoke_filter(*mytester->control, act, "script11"));
+    CHECK(engine.invoke_filter(*mytester->control, act, "script9"));
+    CHECK(engine.invoke_filter(*mytester->control, act, "script10"));
+    CHECK(engine.invoke_filter(*mytester->control, act, "script11"));
+    CHECK(engine.invoke_filter(*mytester->control, act, "script9"));
+    CHECK(engine.invoke_filter(*mytester->control, act, "script11"));
+
+    // compiled scripts are invalidated once updated
+    CHECK(engine.invoke_filter(*mytester->control, act, "script5"));
+    add_script("script5", "return false");
+    CHECK(!engine.invoke_filter(*mytester->control, act, "script5"));
+
+    add_script("script4", script3);
+    CHECK(engine.invoke_filter(*mytester->control, act, "script6"));
 }
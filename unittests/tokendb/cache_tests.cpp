@@ -87,4 +87,32 @@ TEST_CASE_METHOD(tokendb_test, "cache_test", "[tokendb]") {
         CHECK(cache.lookup_token<domain_def>(token_type::domain, std::nullopt, "dm-tkdb-cache-2") == nullptr);
         CHECK_THROWS_AS(cache.read_token<domain_def>(token_type::domain, std::nullopt, "dm-tkdb-cache-2") == nullptr, unknown_token_database_key);
     }
+
+    SECTION("eviction_test") {
+        // capacity is too small to hold any entry, only pinned ones can stay
+        auto cache2 = token_database_cache(tokendb, 1);
+
+        {
+            auto dom = cache2.read_token<domain_def>(token_type::domain, std::nullopt, "dm-tkdb-test");
+            CHECK(dom != nullptr);
+            CHECK(cache2.lookup_token<domain_def>(token_type::domain, std::nullopt, "dm-tkdb-test") != nullptr);
+
+            auto tk = cache2.read_token<token_def>(token_type::token, "dm-tkdb-test", "t1");
+            CHECK(tk != nullptr);
+            CHECK(cache2.lookup_token<domain_def>(token_type::domain, std::nullopt, "dm-tkdb-test") != nullptr);
+        }
+
+        // released entries are evicted by later insertions into the same shard
+        auto s = tokendb.new_savepoint_session();
+        for(auto i = 0; i < 128; i++) {
+            auto dom = fc::json::from_string(domain_data).as<domain_def>();
+            cache2.put_token(token_type::domain, action_op::put, std::nullopt, name128::from_number(i), std::move(dom));
+        }
+        CHECK(cache2.lookup_token<domain_def>(token_type::domain, std::nullopt, "dm-tkdb-test") == nullptr);
+        s.undo();
+
+        auto stats = cache2.stats();
+        CHECK(stats.find("evictions: 0") == std::string::npos);
+        CHECK(tokendb.stats().find("Object Cache") != std::string::npos);
+    }
 }
@@ -1,5 +1,14 @@
 #include "tokendb_tests.hpp"
 
+#include <chrono>
+#include <cinttypes>
+#include <thread>
+
+#include <rocksdb/db.h>
+#include <rocksdb/memtablerep.h>
+#include <rocksdb/slice_transform.h>
+#include <rocksdb/table.h>
+
 /*
  * Persist Tests: add token
  */
@@ -296,3 +305,272 @@ TEST_CASE_METHOD(tokendb_test, "squash_prst_rlbk", "[tokendb]") {
     CHECK(!EXISTS_TOKEN(domain, "domain-prst-sq"));
 }
 
+/*
+ * Persist Tests: migrate tokens of old layout into column families
+ */
+namespace {
+
+struct old_row {
+    name128     prefix;
+    name128     key;
+    std::string value;
+};
+
+std::string
+old_key(const name128& prefix, const name128& key) {
+    auto k = std::string(sizeof(name128) * 2, '\0');
+    memcpy(&k[0], &prefix, sizeof(prefix));
+    memcpy(&k[sizeof(name128)], &key, sizeof(key));
+    return k;
+}
+
+// writes rows the way old versions did: all tokens in default column family with the table format of the profile.
+// `moved` rows are put into `Domains` column family together with the migration marker, as an interrupted migration leaves
+void
+write_old_layout(const std::string& path, storage_profile profile, const std::vector<old_row>& rows, const std::vector<old_row>& moved) {
+    using namespace rocksdb;
+
+    auto options = Options();
+    options.create_if_missing               = true;
+    options.create_missing_column_families  = true;
+    options.allow_concurrent_memtable_write = false;
+    options.prefix_extractor.reset(NewFixedPrefixTransform(sizeof(name128)));
+    options.memtable_factory.reset(NewHashSkipListRepFactory());
+
+    if(profile == storage_profile::memory) {
+        auto table_opts = PlainTableOptions();
+        table_opts.user_key_len = sizeof(name128) * 2;
+        options.table_factory.reset(NewPlainTableFactory(table_opts));
+    }
+    else {
+        auto table_opts = BlockBasedTableOptions();
+        table_opts.index_type = BlockBasedTableOptions::kHashSearch;
+        options.table_factory.reset(NewBlockBasedTableFactory(table_opts));
+    }
+
+    auto assets_options = ColumnFamilyOptions(options);
+    assets_options.prefix_extractor.reset(NewFixedPrefixTransform(sizeof(symbol_id_type)));
+    if(profile == storage_profile::memory) {
+        assets_options.table_factory.reset(NewPlainTableFactory());
+    }
+
+    auto columns = std::vector<ColumnFamilyDescriptor>();
+    columns.emplace_back(kDefaultColumnFamilyName, options);
+    columns.emplace_back("Assets", assets_options);
+    if(!moved.empty()) {
+        columns.emplace_back("Domains", options);
+    }
+
+    auto db      = (DB*)nullptr;
+    auto handles = std::vector<ColumnFamilyHandle*>();
+    REQUIRE(DB::Open(options, path, columns, &handles, &db).ok());
+
+    for(auto& r : rows) {
+        REQUIRE(db->Put(WriteOptions(), handles[0], old_key(r.prefix, r.key), r.value).ok());
+    }
+    if(!moved.empty()) {
+        REQUIRE(db->Put(WriteOptions(), handles[0], old_key(N128(.tokendb), N128(.migrating)), Slice()).ok());
+        for(auto& r : moved) {
+            REQUIRE(db->Put(WriteOptions(), handles[2], old_key(r.prefix, r.key), r.value).ok());
+        }
+    }
+    // tokens of old layout are read from the tables written by old versions
+    REQUIRE(db->Flush(FlushOptions(), handles[0]).ok());
+
+    for(auto h : handles) {
+        delete h;
+    }
+    delete db;
+}
+
+uint64_t
+column_keys(const std::string& stats, const std::string& column) {
+    auto pos = stats.find("\n" + column + ": ");
+    REQUIRE(pos != std::string::npos);
+    pos = stats.find("keys: ~", pos);
+    REQUIRE(pos != std::string::npos);
+    return std::stoull(stats.substr(pos + strlen("keys: ~")));
+}
+
+void
+migrate_test(storage_profile profile, bool interrupted) {
+    auto cfg    = token_database::config();
+    cfg.profile = profile;
+    cfg.db_path = jmzk_unittests_dir + "/tokendb_migrate_tests";
+    if(fc::exists(cfg.db_path)) {
+        fc::remove_all(cfg.db_path);
+    }
+    fc::create_directories(cfg.db_path);
+
+    auto dom = fc::json::from_string(domain_data).as<domain_def>();
+    auto tk  = fc::json::from_string(token_data).as<token_def>();
+    auto fg  = fc::json::from_string(fungible_data).as<fungible_def>();
+
+    auto rows  = std::vector<old_row>();
+    auto moved = std::vector<old_row>();
+    for(auto i = 0; i < 3; i++) {
+        dom.name = "dm-migrate-" + std::to_string(i);
+        auto row = old_row{ N128(.domain), dom.name, std::string(make_db_value(dom).as_string_view()) };
+
+        // first domain is moved already if migration is interrupted
+        (interrupted && i == 0 ? moved : rows).emplace_back(std::move(row));
+
+        for(auto j = 0; j < 3; j++) {
+            tk.domain = dom.name;
+            tk.name   = "tk-" + std::to_string(j);
+            rows.emplace_back(old_row{ dom.name, tk.name, std::string(make_db_value(tk).as_string_view()) });
+        }
+    }
+    rows.emplace_back(old_row{ N128(.fungible), name128(3), std::string(make_db_value(fg).as_string_view()) });
+
+    write_old_layout(cfg.db_path.to_native_ansi_path(), profile, rows, moved);
+
+    auto tokendb = token_database(cfg);
+    for(auto n = 0; n < 2; n++) {
+        // migrated in the first opening, nothing to do in the second one
+        tokendb.open();
+
+        for(auto i = 0; i < 3; i++) {
+            auto name = "dm-migrate-" + std::to_string(i);
+            auto _dom = domain_def();
+            READ_TOKEN(domain, name, _dom);
+            CHECK(_dom.name == name128(name));
+
+            for(auto j = 0; j < 3; j++) {
+                auto _tk = token_def();
+                READ_TOKEN2(token, name128(name), "tk-" + std::to_string(j), _tk);
+                CHECK(_tk.domain == name128(name));
+            }
+        }
+        CHECK(EXISTS_TOKEN(fungible, 3));
+
+        // each type is in its own column family
+        auto stats = tokendb.stats();
+        CHECK(column_keys(stats, "Domains") == 3);
+        CHECK(column_keys(stats, "Tokens") == 9);
+        CHECK(column_keys(stats, "Fungibles") == 1);
+        CHECK(column_keys(stats, "Groups") == 0);
+
+        tokendb.close();
+    }
+}
+
+}  // namespace
+
+TEST_CASE("migrate_columns_test", "[tokendb]") {
+    migrate_test(storage_profile::disk, false);
+    migrate_test(storage_profile::memory, false);
+}
+
+TEST_CASE("migrate_columns_resume_test", "[tokendb]") {
+    migrate_test(storage_profile::disk, true);
+    migrate_test(storage_profile::memory, true);
+}
+
+/*
+ * Persist Tests: durability modes
+ */
+namespace {
+
+struct durability_stats {
+    uint64_t writes, syncs, unsynced;
+};
+
+durability_stats
+read_durability_stats(const token_database& tokendb) {
+    auto stats = tokendb.stats();
+    auto pos   = stats.find("irreversible writes: ");
+    REQUIRE(pos != std::string::npos);
+
+    auto ds = durability_stats();
+    REQUIRE(sscanf(stats.c_str() + pos, "irreversible writes: %" SCNu64 ", wal syncs: %" SCNu64 ", unsynced writes: %" SCNu64,
+        &ds.writes, &ds.syncs, &ds.unsynced) == 3);
+    return ds;
+}
+
+token_database::config
+durability_config(durability_mode mode, uint32_t group_commit_ms) {
+    auto cfg            = token_database::config();
+    cfg.db_path         = jmzk_unittests_dir + "/tokendb_durability_tests";
+    cfg.durability      = mode;
+    cfg.group_commit_ms = group_commit_ms;
+    if(fc::exists(cfg.db_path)) {
+        fc::remove_all(cfg.db_path);
+    }
+    return cfg;
+}
+
+// puts one domain in a new savepoint and makes it irreversible
+void
+write_irreversible_domain(token_database& tokendb, int64_t seq) {
+    auto dom = fc::json::from_string(domain_data).as<domain_def>();
+    dom.name = "dm-durable-" + std::to_string(seq);
+
+    tokendb.add_savepoint(seq);
+    PUT_TOKEN(domain, dom.name, dom);
+    tokendb.pop_savepoints(seq + 1);
+}
+
+}  // namespace
+
+TEST_CASE("group_commit_durability_test", "[tokendb]") {
+    auto cfg     = durability_config(durability_mode::group_commit, 20);
+    auto tokendb = token_database(cfg);
+    tokendb.open();
+
+    auto ds0 = read_durability_stats(tokendb);
+    write_irreversible_domain(tokendb, 1);
+    write_irreversible_domain(tokendb, 2);
+
+    auto ds1 = read_durability_stats(tokendb);
+    CHECK(ds1.writes == ds0.writes + 2);
+
+    // flusher syncs the writes within a few intervals
+    auto ds2      = ds1;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(cfg.group_commit_ms * 50);
+    while(std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(cfg.group_commit_ms));
+        ds2 = read_durability_stats(tokendb);
+        if(ds2.syncs > ds0.syncs && ds2.unsynced == 0) {
+            break;
+        }
+    }
+    CHECK(ds2.syncs > ds0.syncs);
+    CHECK(ds2.unsynced == 0);
+
+    // nothing to sync, flusher keeps idle
+    std::this_thread::sleep_for(std::chrono::milliseconds(cfg.group_commit_ms * 3));
+    auto ds3 = read_durability_stats(tokendb);
+    CHECK(ds3.syncs == ds2.syncs);
+
+    tokendb.close();
+}
+
+TEST_CASE("wal_only_durability_test", "[tokendb]") {
+    auto cfg     = durability_config(durability_mode::wal_only, 20);
+    auto tokendb = token_database(cfg);
+    tokendb.open();
+
+    auto ds0 = read_durability_stats(tokendb);
+    write_irreversible_domain(tokendb, 1);
+    write_irreversible_domain(tokendb, 2);
+
+    // no flusher in this mode, writes are left unsynced
+    std::this_thread::sleep_for(std::chrono::milliseconds(cfg.group_commit_ms * 3));
+    auto ds1 = read_durability_stats(tokendb);
+    CHECK(ds1.writes == ds0.writes + 2);
+    CHECK(ds1.syncs == ds0.syncs);
+    CHECK(ds1.unsynced == ds0.unsynced + 2);
+
+    // pending writes are synced when closing
+    tokendb.close();
+    tokendb.open();
+
+    auto ds2 = read_durability_stats(tokendb);
+    CHECK(ds2.syncs == ds1.syncs + 1);
+    CHECK(ds2.unsynced == 0);
+    CHECK(EXISTS_TOKEN(domain, "dm-durable-1"));
+    CHECK(EXISTS_TOKEN(domain, "dm-durable-2"));
+
+    tokendb.close();
+}
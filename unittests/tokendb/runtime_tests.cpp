@@ -1,4 +1,5 @@
 #include "tokendb_tests.hpp"
+#include <cinttypes>
 
 TEST_CASE_METHOD(tokendb_test, "add_token_svpt_test", "[tokendb]") {
     auto& tokendb = my_tester->control->token_db();
@@ -236,3 +237,312 @@ TEST_CASE_METHOD(tokendb_test, "squansh_test", "[tokendb]") {
 
     my_tester->produce_block();
 }
+
+TEST_CASE_METHOD(tokendb_test, "read_assets_range_svpt_test", "[tokendb]") {
+    auto& tokendb = my_tester->control->token_db();
+    my_tester->produce_block();
+
+    auto read_all = [&](auto sym_id, auto skip) {
+        auto values = std::vector<asset>();
+        tokendb.read_assets_range(sym_id, skip, [&](auto& key, auto&& value) {
+            auto as = asset();
+            extract_db_value(value, as);
+            values.emplace_back(as);
+            return true;
+        });
+        return values;
+    };
+
+    ADD_SAVEPOINT();
+
+    auto addr1 = tester::get_public_key(N(range1));
+    auto addr2 = tester::get_public_key(N(range2));
+    PUT_ASSET(addr1, 7, asset::from_string("1.00000 S#7"));
+    PUT_ASSET(addr2, 7, asset::from_string("2.00000 S#7"));
+    PUT_ASSET(addr1, 8, asset::from_string("3.00000 S#8"));
+
+    ADD_SAVEPOINT();
+    PUT_ASSET(addr2, 7, asset::from_string("4.00000 S#7"));
+
+    auto v1 = read_all(7, 0);
+    REQUIRE(v1.size() == 2);
+    CHECK(std::count(v1.cbegin(), v1.cend(), asset::from_string("1.00000 S#7")) == 1);
+    CHECK(std::count(v1.cbegin(), v1.cend(), asset::from_string("4.00000 S#7")) == 1);
+    CHECK(read_all(7, 1).size() == 1);
+    CHECK(read_all(8, 0).size() == 1);
+
+    ROLLBACK();
+    auto v2 = read_all(7, 0);
+    REQUIRE(v2.size() == 2);
+    CHECK(std::count(v2.cbegin(), v2.cend(), asset::from_string("2.00000 S#7")) == 1);
+
+    ROLLBACK();
+    CHECK(read_all(7, 0).empty());
+    CHECK(read_all(8, 0).empty());
+
+    my_tester->produce_block();
+}
+
+TEST_CASE_METHOD(tokendb_test, "read_tokens_range_svpt_test", "[tokendb]") {
+    auto& tokendb = my_tester->control->token_db();
+    my_tester->produce_block();
+
+    auto read_all = [&](auto skip) {
+        auto values = std::vector<std::string>();
+        tokendb.read_tokens_range(token_type::token, name128("dm-tkdb-range"), skip, [&](auto& key, auto&& value) {
+            auto tk = token_def();
+            extract_db_value(value, tk);
+            values.emplace_back(tk.name.to_string());
+            return true;
+        });
+        return values;
+    };
+
+    ADD_SAVEPOINT();
+
+    auto var = fc::json::from_string(token_data);
+    auto tk  = var.as<token_def>();
+    tk.domain = "dm-tkdb-range";
+    tk.name   = "range-1";
+    PUT_TOKEN2(token, tk.domain, tk.name, tk);
+    tk.name   = "range-3";
+    PUT_TOKEN2(token, tk.domain, tk.name, tk);
+
+    ADD_SAVEPOINT();
+    tk.name   = "range-2";
+    PUT_TOKEN2(token, tk.domain, tk.name, tk);
+    tk.name   = "range-3";
+    PUT_TOKEN2(token, tk.domain, tk.name, tk);
+
+    // values from all the savepoints are merged and no key is returned twice
+    auto v1 = read_all(0);
+    REQUIRE(v1.size() == 3);
+    CHECK(std::count(v1.cbegin(), v1.cend(), "range-2") == 1);
+    CHECK(std::count(v1.cbegin(), v1.cend(), "range-3") == 1);
+    CHECK(read_all(2).size() == 1);
+
+    ROLLBACK();
+    auto v2 = read_all(0);
+    REQUIRE(v2.size() == 2);
+    CHECK(std::count(v2.cbegin(), v2.cend(), "range-2") == 0);
+    CHECK(EXISTS_TOKEN2(token, "dm-tkdb-range", "range-3"));
+
+    ROLLBACK();
+    CHECK(read_all(0).empty());
+    CHECK(!EXISTS_TOKEN2(token, "dm-tkdb-range", "range-1"));
+
+    my_tester->produce_block();
+}
+
+TEST_CASE_METHOD(tokendb_test, "view_svpt_test", "[tokendb]") {
+    auto& tokendb = my_tester->control->token_db();
+    my_tester->produce_block();
+
+    ADD_SAVEPOINT();
+
+    auto addr = tester::get_public_key(N(view1));
+    PUT_ASSET(addr, 9, asset::from_string("1.00000 S#9"));
+
+    auto view = tokendb.new_view();
+
+    ADD_SAVEPOINT();
+
+    auto var = fc::json::from_string(domain_data);
+    auto dom = var.as<domain_def>();
+    dom.name = "dm-tkdb-view";
+    PUT_TOKEN(domain, dom.name, dom);
+    PUT_ASSET(addr, 9, asset::from_string("2.00000 S#9"));
+
+    // writes after view is created are invisible to view
+    CHECK(EXISTS_TOKEN(domain, "dm-tkdb-view"));
+    CHECK(!view->exists_token(token_type::domain, std::nullopt, "dm-tkdb-view"));
+
+    auto str = std::string();
+    auto as  = asset();
+    REQUIRE(view->read_asset(addr, 9, str));
+    extract_db_value(str, as);
+    CHECK(as == asset::from_string("1.00000 S#9"));
+
+    // tokens existed before are visible
+    CHECK(view->exists_token(token_type::domain, std::nullopt, "dm-tkdb-test"));
+    CHECK(view->read_token(token_type::domain, std::nullopt, "dm-tkdb-test", str, true));
+
+    ROLLBACK();
+    ROLLBACK();
+
+    // view is not affected by rollback either
+    REQUIRE(view->read_asset(addr, 9, str, true));
+    CHECK(!view->exists_token(token_type::domain, std::nullopt, "dm-tkdb-view"));
+
+    view.reset();
+    my_tester->produce_block();
+}
+
+TEST_CASE_METHOD(tokendb_test, "view_seq_svpt_test", "[tokendb]") {
+    auto& tokendb = my_tester->control->token_db();
+    my_tester->produce_block();
+
+    auto read_view_asset = [](auto& view, auto& addr) {
+        auto str = std::string();
+        auto as  = asset();
+        REQUIRE(view->read_asset(addr, 9, str));
+        extract_db_value(str, as);
+        return as;
+    };
+
+    ADD_SAVEPOINT();
+    auto seq = tokendb.latest_savepoint_seq();
+
+    auto addr = tester::get_public_key(N(view2));
+    PUT_ASSET(addr, 9, asset::from_string("1.00000 S#9"));
+    auto view0 = tokendb.new_view(seq);
+
+    // writes after the view are built into another delta of the same savepoint
+    PUT_ASSET(addr, 9, asset::from_string("2.00000 S#9"));
+
+    ADD_SAVEPOINT();
+    auto var = fc::json::from_string(domain_data);
+    auto dom = var.as<domain_def>();
+    dom.name = "dm-tkdb-view2";
+    PUT_TOKEN(domain, dom.name, dom);
+    PUT_ASSET(addr, 9, asset::from_string("3.00000 S#9"));
+
+    // savepoints newer than seq are excluded
+    auto view1 = tokendb.new_view(seq);
+    CHECK(read_view_asset(view1, addr) == asset::from_string("2.00000 S#9"));
+    CHECK(!view1->exists_token(token_type::domain, std::nullopt, "dm-tkdb-view2"));
+
+    auto view2 = tokendb.new_view();
+    CHECK(read_view_asset(view2, addr) == asset::from_string("3.00000 S#9"));
+    CHECK(view2->exists_token(token_type::domain, std::nullopt, "dm-tkdb-view2"));
+
+    CHECK(read_view_asset(view0, addr) == asset::from_string("1.00000 S#9"));
+
+    ROLLBACK();
+    ROLLBACK();
+
+    CHECK(read_view_asset(view1, addr) == asset::from_string("2.00000 S#9"));
+    CHECK(view2->exists_token(token_type::domain, std::nullopt, "dm-tkdb-view2"));
+
+    my_tester->produce_block();
+}
+
+TEST_CASE_METHOD(tokendb_test, "savepoint_arena_stats_test", "[tokendb]") {
+    auto& tokendb = my_tester->control->token_db();
+    my_tester->produce_block();
+
+    struct arena_stats {
+        uint64_t allocs, bytes, releases;
+    };
+    auto tokens_arena_stats = [&] {
+        auto stats = tokendb.stats();
+        auto pos   = stats.find("tokens arena allocs: ");
+        REQUIRE(pos != std::string::npos);
+
+        auto as = arena_stats();
+        REQUIRE(sscanf(stats.c_str() + pos, "tokens arena allocs: %" SCNu64 ", bytes: %" SCNu64 ", releases: %" SCNu64,
+            &as.allocs, &as.bytes, &as.releases) == 3);
+        return as;
+    };
+
+    ADD_SAVEPOINT();
+
+    auto var = fc::json::from_string(domain_data);
+    auto dom = var.as<domain_def>();
+    dom.name = "dm-tkdb-arena";
+    PUT_TOKEN(domain, dom.name, dom);
+
+    // new keys have no previous values
+    auto s0 = tokens_arena_stats();
+
+    ADD_SAVEPOINT();
+    // overwriting keeps the previous value in arena of savepoint
+    dom.metas.clear();
+    PUT_TOKEN(domain, dom.name, dom);
+
+    auto s1 = tokens_arena_stats();
+    CHECK(s1.allocs == s0.allocs + 1);
+    CHECK(s1.bytes > s0.bytes);
+    CHECK(s1.releases == s0.releases);
+
+    ADD_SAVEPOINT();
+    PUT_TOKEN(domain, dom.name, dom);
+
+    auto s2 = tokens_arena_stats();
+    CHECK(s2.allocs == s1.allocs + 1);
+    CHECK(s2.bytes > s1.bytes);
+    CHECK(s2.releases == s0.releases);
+
+    auto stats = tokendb.stats();
+    CHECK(stats.find("Savepoints") != std::string::npos);
+    CHECK(stats.find("mode: sync-every-write") != std::string::npos);
+    CHECK(stats.find("Column Families") != std::string::npos);
+    CHECK(stats.find("Domains: pattern: hot") != std::string::npos);
+
+    // squash moves arenas without releasing them
+    tokendb.squash();
+    auto s3 = tokens_arena_stats();
+    CHECK(s3.allocs == s2.allocs);
+    CHECK(s3.releases == s0.releases);
+
+    // both arenas of squashed savepoint are released together
+    ROLLBACK();
+    CHECK(EXISTS_TOKEN(domain, "dm-tkdb-arena"));
+    auto s4 = tokens_arena_stats();
+    CHECK(s4.allocs == s2.allocs);
+    CHECK(s4.releases == s0.releases + 2);
+
+    ROLLBACK();
+    CHECK(!EXISTS_TOKEN(domain, "dm-tkdb-arena"));
+    auto s5 = tokens_arena_stats();
+    CHECK(s5.releases == s0.releases + 3);
+
+    my_tester->produce_block();
+}
+
+TEST_CASE("pop_svpt_rollback_later_test", "[tokendb]") {
+    auto cfg    = token_database::config();
+    cfg.db_path = jmzk_unittests_dir + "/tokendb_pop_tests";
+    if(fc::exists(cfg.db_path)) {
+        fc::remove_all(cfg.db_path);
+    }
+
+    auto tokendb = token_database(cfg);
+    tokendb.open();
+
+    auto var = fc::json::from_string(domain_data);
+    auto dom = var.as<domain_def>();
+    dom.name = "dm-tkdb-pop";
+
+    tokendb.add_savepoint(1);
+    PUT_TOKEN(domain, dom.name, dom);
+
+    // later savepoint writes the same key
+    tokendb.add_savepoint(2);
+    auto dom2 = dom;
+    dom2.metas.clear();
+    PUT_TOKEN(domain, dom.name, dom2);
+
+    // first savepoint becomes irreversible, its value should be persisted
+    tokendb.pop_savepoints(2);
+    REQUIRE(tokendb.savepoints_size() == 1);
+
+    ROLLBACK();
+    REQUIRE(EXISTS_TOKEN(domain, "dm-tkdb-pop"));
+
+    auto _dom = domain_def();
+    READ_TOKEN(domain, "dm-tkdb-pop", _dom);
+    CHECK(_dom.metas.size() == dom.metas.size());
+
+    // still there after reopening
+    tokendb.close();
+    tokendb.open();
+    CHECK(tokendb.savepoints_size() == 0);
+
+    _dom = domain_def();
+    READ_TOKEN(domain, "dm-tkdb-pop", _dom);
+    CHECK(_dom.metas.size() == dom.metas.size());
+    CHECK(!dom.metas.empty());
+
+    tokendb.close();
+}